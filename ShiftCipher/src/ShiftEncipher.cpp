@@ -3,11 +3,50 @@
 #include <format>          // formatted strings with variables and specifiers, requires C++20
 #include <filesystem>      // file checking, etc. requires C++17 at mininum
 #include <stdexcept>       // standard exception std::invalid_argument
+#include <exception>       // std::exception_ptr to hand worker errors back
 #include <string>
 #include <valarray>        // for circular-shift functionality
 #include <vector>
 #include <map>             // act as a dictionary
 #include <set>
+#include <algorithm>       // std::copy, std::equal, std::min, std::sort
+#include <iterator>        // std::back_inserter
+#include <memory>          // std::unique_ptr
+#include <cstdint>         // fixed-width integers for on-disk index formats
+#include <cstring>         // memchr, memcmp
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <queue>           // std::priority_queue merging trigram index runs
+#include <array>
+#include <complex>         // FFT-based autocorrelation
+#include <cmath>
+#include <climits>         // INT_MAX
+#include <bit>             // std::popcount
+#include <random>          // sampling offsets
+#include <bitset>
+#include <chrono>          // --autokey-bench timings
+
+// POSIX file mapping (Linux environment expected)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fnmatch.h>       // --tar-glob member patterns
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>   // --follow wake-ups
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>     // --serve-shm slot waits
+
+// SIMD intrinsics, selected at runtime by CPU support
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 //#include <unordered_map>
 //#include <print>           // formatted file-stream or character-stream printing, requires C++23 
 
@@ -34,6 +73,33 @@ typedef std::valarray<char> varrchr;
 
 typedef std::map<char,char> chrdict;
 
+// overall program functionality selected on the command-line
+enum class CipherMode
+{
+	Encipher,    // encipher (or decipher) IFILE to OFILE
+	LineRange,   // decipher selected lines of an indexed IFILE
+	Grep,        // search enciphered files for a plaintext pattern
+	IndexQuery,  // search enciphered files through their trigram indexes
+	BloomSearch, // search enciphered files for whole words, skipping blocks by Bloom filter
+	Vigenere,    // estimate the period and key of Vigenere ciphertext
+	Crack,       // estimate the shift of shift-cipher ciphertext
+	Segments,    // detect where the shift changes in concatenated ciphertexts
+	Quadgrams,   // build a quadgram language model from an English corpus
+	Wordset,     // build a perfect-hash word set from a word list
+	CrackDir,    // estimate the shifts of every file of a directory
+	AllShifts,   // write all 26 shifted variants of IFILE
+	Classic,     // encipher IFILE to letters only, in 5-letter groups
+	Rekey,       // re-key enciphered files in place from shift A to shift B
+	Autokey,     // encipher IFILE with the autokey cipher
+	Tar,         // encipher the regular-file members of a tar stream
+	Csv,         // encipher selected columns of CSV/TSV text
+	Json,        // encipher the string values of JSON (Lines) text
+	Follow,      // encipher IFILE as it grows, across restarts and rotation
+	Watch,       // encipher the files written into a directory as they land
+	ServeShm,    // encipher, in place, the slots producers fill in a shared ring
+	ShmClient    // encipher IFILE through the ring of a --serve-shm service
+};
+
 
 // object to store user command-line entries and determine overall program
 //   functionality
@@ -44,8 +110,14 @@ struct CipherOptions
 	string program_name;
 	string prog_name_stripped;
 
+	// functionality requested on the command-line
+	CipherMode mode = CipherMode::Encipher;
+
 	// input & output filenames
+	//   infilenames holds every -i entry (in order) for modes that accept
+	//   several input files, infilename is the first of them
 	string infilename;
+	vecstr infilenames;
 	string outfilename;
 	bool use_default_oname = true;  // an extension (.ciph) will be appended to infilename
 	
@@ -64,6 +136,119 @@ struct CipherOptions
 	bool enc_numbers = false;  // encipher numbers from input file
 	bool enc_puncts  = false;  // encipher punctation from input file
 
+	// decipher instead of encipher (the dictionary is built with the
+	//   inverse shift amount)
+	bool decipher = false;
+
+	// --rekey A:B: current and new shift of the enciphered input files and
+	//   the journal recording the files already re-keyed (default:
+	//   REKEY_JOURNAL_NAME in the working directory)
+	int rekey_from = 0;
+	int rekey_to   = 0;
+	string journal_file;
+
+	// --utf8: input is validated UTF-8, multi-byte sequences pass through
+	bool utf8 = false;
+
+	// --csv: 1-based columns to encipher, field delimiter, and whether the
+	//   first record (a header) is left as it is
+	std::vector<size_t> csv_columns;
+	char csv_delimiter = ',';
+	bool csv_header = false;
+
+	// --json: member names whose string values are enciphered (all string
+	//   values if empty)
+	vecstr json_keys;
+
+	// --follow: file recording how far IFILE has been enciphered (default:
+	//   OFILE with FOLLOW_STATE_EXT) and the interval of the stat checks, the
+	//   only wake-ups when inotify is unavailable (0: FOLLOW_POLL_MS)
+	string follow_state;
+	int follow_poll_ms = 0;
+
+	// --watch: directory whose new files are enciphered, and the directory
+	//   the enciphered files are renamed into
+	string watch_dir;
+	string out_dir;
+
+	// --serve-shm / --shm-client: UNIX socket the ring's memfd is handed over
+	string shm_socket;
+
+	// --tar: glob selecting the members to encipher (all regular files if
+	//   empty)
+	string tar_glob;
+
+	// --autokey: primer keying the first letters, and --autokey-bench to time
+	//   both directions instead of writing OFILE
+	string autokey_primer;
+	bool autokey_bench = false;
+
+	// --alphabet-key: keyword mixing every shifted class before the shift
+	string alphabet_key;
+
+	// --utf16: input is UTF-16 (also assumed for input starting with a UTF-16
+	//   byte order mark); --to-utf8 writes it as UTF-8 instead of UTF-16
+	bool utf16 = false;
+	bool to_utf8 = false;
+
+	// --alphabet: extra alphabets (built-in names or alphabet files) whose
+	//   letters are shifted too; implies --utf8
+	vecstr alphabets;
+
+	// chain of --transform steps applied instead of the single shift
+	//   (see compileTransform)
+	vecstr transform_steps;
+
+	// write a line-offset index (OFILE.lidx) while enciphering
+	bool write_line_index = false;
+
+	// write an inverted trigram index (OFILE.tgi) while enciphering
+	bool write_trigram_index = false;
+
+	// write Bloom filters of the enciphered words (OFILE.bloom) while enciphering
+	bool write_bloom_filter = false;
+
+	// decipher only lines [first_line, last_line] (1-based, inclusive) of
+	//   an enciphered input file using its line-offset index
+	uint64_t first_line = 0;
+	uint64_t last_line  = 0;
+
+	// plaintext pattern to search for in enciphered files (--grep,
+	//   --index-query and --bloom-search) and whether
+	//   letters match regardless of case
+	string grep_pattern;
+	bool ignore_case = false;
+
+	// largest key length (period) tried when analysing Vigenere ciphertext
+	int max_period = 20;
+
+	// shift detection: number of sampled blocks (0: read the whole file),
+	//   bytes per block and the confidence at which sampling stops early
+	uint64_t sample_blocks = 0;
+	uint64_t sample_block_size = 64 * 1024;
+	double crack_confidence = 0.999999;
+
+	// letters in the look-ahead window used to estimate per-segment shifts
+	uint64_t segment_window = 200;
+
+	// quadgram language model (written by --build-quadgrams) used to score
+	//   shifts and keys instead of single-letter frequencies (empty: none)
+	string quadgram_model;
+
+	// word set (written by --build-wordset) used to confirm the top_k best
+	//   --crack shifts by the fraction of words they decipher to (empty: none)
+	string wordset;
+	int top_k = 5;
+
+	// --crack-dir: directory of ciphertexts, report format (CSV unless
+	//   report_json) and directory receiving the deciphered files (empty: none)
+	string crack_dir;
+	bool report_json = false;
+	string decipher_dir;
+
+	// worker threads for parallel modes (0: one per hardware thread)
+	unsigned num_threads = 0;
+
 	// dictionary (C++ map) to encipher alphabet, numbers and punctuation	
 	chrdict cipher_dict;
 
@@ -76,6 +261,453 @@ struct CipherOptions
 };
 
 
+// byte-to-byte transform compiled from the cipher dictionary or a chain of
+//   --transform steps (see compileTransform): table maps every byte, bytes
+//   with drop set are deleted; nibble_tables holds the table by high nibble
+//   for the pshufb lookup of applyTransform (see prepareNibbleTables)
+struct ByteTransform
+{
+	std::array<char,256> table{};
+	std::array<bool,256> drop{};
+	bool drops_any = false;
+	std::array<std::array<uint8_t,16>,16> nibble_tables{};
+};
+
+// one letter of the autokey state after a chunk of ciphertext, in terms of
+//   the state before it: constant plus (or, if negated, minus) the letter at
+//   position source, modulo 26 (see autokeySummary)
+struct AutokeyTerm
+{
+	uint8_t constant;
+	bool negated;
+	uint32_t source;
+};
+
+// --alphabet transform of ASCII and 2-byte UTF-8 characters (see
+//   compileCodepointTransform): units holds one entry per codepoint below
+//   CODEPOINT_TABLE_SIZE, the output byte of an ASCII character or the two
+//   output bytes (lead byte lowest) of a 2-byte character; ascii is the byte
+//   transform of the ASCII part, used on runs of ASCII
+struct CodepointTransform
+{
+	ByteTransform ascii;
+	std::vector<uint32_t> units;
+};
+
+// header at the start of the --serve-shm ring (a memfd shared with the
+//   producers)
+//   Layout of the whole memfd:
+//     header     : this struct
+//     slots      : slot_count ShmSlot structs
+//     data       : slot_count areas of slot_bytes, one per slot
+//   Producers take tickets from next_ticket; ticket t uses slot t % slot_count
+//   and moves its sequence from t (free) to t+1 (filled) to t+2 (enciphered
+//   by the service) to t+slot_count (free again for the next lap). The
+//   service sets closed when it stops, so producers do not wait for it.
+struct ShmRingHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t slot_bytes;
+	uint32_t reserved;
+	alignas(64) std::atomic<uint64_t> next_ticket;
+	alignas(64) std::atomic<uint32_t> closed;
+};
+
+// one slot of the ring: sequence (the futex word), number of processes
+//   sleeping on it (a change is only followed by a wake-up when non-zero)
+//   and the bytes used in the slot's data area
+struct ShmSlot
+{
+	alignas(64) std::atomic<uint32_t> seq;
+	std::atomic<uint32_t> waiters;
+	uint32_t length;
+};
+
+// size and modification time of an enciphered file, recorded in the header
+//   of its sidecar indexes so a sidecar left behind when the file is
+//   rewritten by another mode is rejected rather than used
+struct CipherFileStamp
+{
+	uint64_t size;
+	int64_t  mtime_ns;
+};
+
+// fixed-size header at the start of a line-offset index sidecar
+//   Layout of the whole file (native byte order):
+//     header     : this struct
+//     deltas     : per block, varint-encoded differences between consecutive
+//                  line start offsets (block_lines - 1 values per full block)
+//     skip table : per block, two uint64 values -> offset of the block's first
+//                  line in the enciphered file, position of the block's deltas
+//                  relative to the end of the header
+struct LineIndexHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint32_t block_lines;
+	uint32_t reserved;
+	uint64_t num_lines;
+	uint64_t num_blocks;
+	uint64_t skip_table_pos;
+	CipherFileStamp cipher_stamp;
+};
+
+// builds a line-offset index one line at a time while the enciphered file
+//   is being written, only the (small) skip table is held in memory
+class LineIndexWriter
+{
+public:
+	explicit LineIndexWriter(const fsys::path& idxpath);
+
+	// line_offset -> byte offset of the start of the next line in the
+	//   enciphered output file
+	void addLine(uint64_t line_offset);
+
+	// writes the skip table and completes the header
+	//   cipherpath -> the enciphered file, complete and closed
+	void finish(const fsys::path& cipherpath);
+
+private:
+	std::ofstream idxfile;
+	std::vector<uint64_t> skip_table;
+	uint64_t num_lines   = 0;
+	uint64_t prev_offset = 0;
+	uint64_t deltas_pos  = 0;
+};
+
+// read-only memory mapping of a whole file, unmapped when destroyed
+class MappedFile
+{
+public:
+	explicit MappedFile(const fsys::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const { return(static_cast<const char*>(addr)); }
+	size_t size() const { return(length); }
+
+private:
+	int    fd     = -1;
+	void*  addr   = nullptr;
+	size_t length = 0;
+};
+
+// random access to the line start offsets stored in a line-offset index
+class LineIndexReader
+{
+public:
+	LineIndexReader(const fsys::path& idxpath, const fsys::path& cipherpath);
+
+	uint64_t numLines() const { return(header.num_lines); }
+
+	// byte offset of a 0-based line (which must be < numLines())
+	uint64_t lineOffset(uint64_t line_number) const;
+
+private:
+	MappedFile idxfile;
+	LineIndexHeader header{};
+};
+
+// fixed-size header at the start of an inverted trigram index sidecar
+//   Layout of the whole file (native byte order):
+//     header     : this struct
+//     postings   : per trigram, varint-encoded deltas of the sorted numbers
+//                  of the lines containing it (first value is absolute)
+//     term table : TrigramTerm entries sorted by trigram
+//   Trigrams are taken from the enciphered text with letters lowercased, so
+//   one index serves both case-sensitive and case-insensitive queries.
+struct TrigramIndexHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint64_t num_lines;
+	uint64_t num_terms;
+	uint64_t term_table_pos;
+	CipherFileStamp cipher_stamp;
+};
+
+struct TrigramTerm
+{
+	uint32_t trigram;        // three bytes packed as b0<<16 | b1<<8 | b2
+	uint32_t num_postings;
+	uint64_t postings_pos;   // relative to the end of the header
+};
+
+// builds an inverted trigram index from the enciphered lines as they are
+//   written. Batches of lines are handed to worker threads which extract
+//   (trigram, line) keys, so indexing runs as a pipeline stage beside the
+//   enciphering loop. Each worker sorts its keys and spills them to a run
+//   file every TRIGRAM_RUN_KEYS keys, so memory use does not grow with the
+//   input; finish() merges the runs and writes the file.
+class TrigramIndexBuilder
+{
+public:
+	TrigramIndexBuilder(const fsys::path& tgipath, unsigned nworkers);
+	~TrigramIndexBuilder();
+
+	TrigramIndexBuilder(const TrigramIndexBuilder&) = delete;
+	TrigramIndexBuilder& operator=(const TrigramIndexBuilder&) = delete;
+
+	// line -> next enciphered line (without its newline)
+	void addLine(const string& line);
+
+	// cipherpath -> the enciphered file, complete and closed
+	void finish(const fsys::path& cipherpath);
+
+private:
+	void submitBatch();
+	void stopWorkers();
+	void workerLoop(size_t worker_number);
+	void spillRun(std::vector<uint64_t>* keys, std::vector<uint64_t>* scratch);
+	void removeRuns() noexcept;
+
+	fsys::path idxpath;
+	uint64_t num_lines = 0;
+
+	// lines waiting to be handed to the workers and the first line number
+	std::vector<string> batch;
+	uint64_t batch_first_line = 0;
+
+	// bounded queue of batches shared with the workers
+	std::mutex queue_mutex;
+	std::condition_variable queue_cv;
+	std::deque<std::pair<uint64_t,std::vector<string>>> queue;
+	bool closing = false;
+
+	// (trigram << 40 | line) keys collected by each worker
+	std::vector<std::vector<uint64_t>> worker_keys;
+	std::vector<std::thread> workers;
+
+	// sorted runs of keys spilled by the workers, removed once merged
+	std::mutex runs_mutex;
+	std::vector<fsys::path> run_paths;
+	std::atomic<bool> spill_failed{false};
+};
+
+// fixed-size header at the start of a Bloom filter sidecar
+//   Layout of the whole file (native byte order):
+//     header      : this struct
+//     filters     : one filter per block of the enciphered file, then the
+//                   filter of the whole file (bit arrays, sizes a power of 2)
+//     block table : per block, four uint64 values -> first byte and one past
+//                   the last byte of the block in the enciphered file, position
+//                   of its filter relative to the end of the header, filter bits
+//   Filters hold the hashes of the case-folded enciphered words (runs of
+//   letters and digits, see hashCipherWord).
+struct BloomIndexHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint32_t num_hashes;
+	uint32_t reserved;
+	uint64_t num_blocks;
+	uint64_t file_filter_pos;
+	uint64_t file_filter_bits;
+	uint64_t block_table_pos;
+	CipherFileStamp cipher_stamp;
+};
+
+// builds the Bloom filter sidecar from the enciphered lines as they are
+//   written, closing a block (at a line boundary) every BLOOM_BLOCK_BYTES.
+//   addLine only buffers the lines of a block. Closed blocks are handed to
+//   worker threads (or filtered in place without workers) which find, hash
+//   and de-duplicate their words in bulk, so filtering runs as a pipeline
+//   stage beside the enciphering loop. The filters are then committed to
+//   the file in block order.
+class BloomIndexWriter
+{
+public:
+	BloomIndexWriter(const fsys::path& bloompath, unsigned nworkers);
+	~BloomIndexWriter();
+
+	BloomIndexWriter(const BloomIndexWriter&) = delete;
+	BloomIndexWriter& operator=(const BloomIndexWriter&) = delete;
+
+	// line        -> next enciphered line (without its newline)
+	// line_offset -> byte offset of the line in the enciphered file
+	void addLine(const string& line, uint64_t line_offset);
+
+	// writes the last block, the file filter and the block table
+	//   cipherpath -> the enciphered file, complete and closed
+	void finish(const fsys::path& cipherpath);
+
+private:
+	// a closed block: its text, number and extent in the enciphered file
+	struct ClosedBlock
+	{
+		string   text;
+		uint64_t number;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	// per-worker space for filtering a block: its words, their hashes and the
+	//   open-addressing set of the distinct hashes
+	struct BlockScratch
+	{
+		std::vector<std::pair<uint32_t,uint32_t>> words;
+		std::vector<uint64_t> hashes;
+		std::vector<uint64_t> table = std::vector<uint64_t>(1024, 0);
+		std::vector<uint64_t> distinct;
+	};
+
+	void submitBlock();
+	void stopWorkers();
+	void workerLoop(size_t worker_number);
+	void closeBlock(ClosedBlock* block, BlockScratch* scratch);
+
+	// open-addressing sets of distinct word hashes (0 marks a free slot),
+	//   each with the list of its members in insertion order
+	static void insertDistinct(std::vector<uint64_t>* table, std::vector<uint64_t>* distinct,
+	                           const std::vector<uint64_t>& hashes);
+	static std::vector<unsigned char> buildFilter(const std::vector<uint64_t>& distinct);
+
+	std::ofstream bloomfile;
+
+	// text of the block being filled and its extent in the enciphered file
+	string block_text;
+	uint64_t num_blocks  = 0;
+	uint64_t block_begin = 0;
+	uint64_t block_end   = 0;
+
+	// bounded queue of closed blocks shared with the workers
+	std::mutex queue_mutex;
+	std::condition_variable queue_cv;
+	std::deque<ClosedBlock> queue;
+	bool closing = false;
+
+	// the next block to commit and everything committed so far: the filters
+	//   written, the block table and the set of the words of the whole file
+	std::mutex commit_mutex;
+	std::condition_variable commit_cv;
+	uint64_t next_commit = 0;
+	std::vector<uint64_t> file_hashes = std::vector<uint64_t>(1024, 0);
+	std::vector<uint64_t> file_distinct;
+	std::vector<uint64_t> block_table;
+	uint64_t filters_pos = 0;
+
+	std::vector<BlockScratch> scratches;
+	std::vector<std::thread> workers;
+};
+
+// best and second-best shifts found for a ciphertext by chi-squared scoring
+//   (or quadgram log10 probability, where larger is better)
+//   confidence estimates the probability that the best shift is correct
+//   from the margin between the two scores (see estimateShift)
+struct ShiftEstimate
+{
+	int best_shift      = 0;
+	int runner_up_shift = 0;
+	double best_score      = 0.0;
+	double runner_up_score = 0.0;
+	double confidence      = 0.0;
+};
+
+// fixed-size header at the start of a quadgram language model file
+//   Layout of the whole file (native byte order):
+//     header : this struct
+//     scores : int16 per quadgram, indexed a*26^3 + b*26^2 + c*26 + d with
+//              A/a = 0 ... Z/z = 25, holding round(scale * log10(probability))
+//     2 zero bytes, so the table can be read with 32-bit vector gathers
+struct QuadgramModelHeader
+{
+	char     magic[4];
+	uint32_t version       = 0;
+	uint32_t num_entries   = 0;
+	int32_t  scale         = 0;  // table units per log10
+	uint64_t num_quadgrams = 0;  // quadgrams counted in the corpus
+	int16_t  floor_score   = 0;  // score of quadgrams the corpus lacks
+	uint16_t reserved0     = 0;
+	uint32_t reserved1     = 0;
+};
+
+// memory-mapped quadgram language model, checked when opened
+class QuadgramModel
+{
+public:
+	explicit QuadgramModel(const fsys::path& modelpath);
+
+	const int16_t* table() const { return(scores); }
+	int32_t scale() const { return(header.scale); }
+
+private:
+	MappedFile modelfile;
+	QuadgramModelHeader header{};
+	const int16_t* scores = nullptr;
+};
+
+// fixed-size header at the start of a word set file
+//   Layout of the whole file (native byte order):
+//     header  : this struct
+//     seeds   : uint32 per bucket, the displacement that sends the bucket's
+//               words to free slots (hash-and-displace perfect hash)
+//     slots   : uint32 per word, offset of the slot's word in strings
+//     strings : each word as a length byte followed by its lowercase letters
+struct WordSetHeader
+{
+	char     magic[4];
+	uint32_t version       = 0;
+	uint32_t num_words     = 0;
+	uint32_t num_buckets   = 0;
+	uint64_t strings_bytes = 0;
+	uint32_t max_length    = 0;  // longest word
+	uint32_t reserved      = 0;
+};
+
+// memory-mapped word set with one probe per lookup, checked when opened
+class WordSet
+{
+public:
+	explicit WordSet(const fsys::path& setpath);
+
+	// whether a word of lowercase letters is in the set
+	bool contains(const char* word, size_t nbytes) const noexcept;
+
+	uint32_t size() const { return(header.num_words); }
+
+private:
+	MappedFile setfile;
+	WordSetHeader header{};
+	const uint32_t* seeds = nullptr;
+	const uint32_t* slots = nullptr;
+	const unsigned char* strings = nullptr;
+};
+
+// per-thread working storage of the shift detection (see crackFileShift)
+struct CrackScratch
+{
+	std::vector<char> buffer;
+	std::vector<uint8_t> letters;
+	std::vector<uint64_t> offsets;
+	std::array<uint64_t,26> counts{};
+	std::array<int64_t,26> quadgram_scores{};
+};
+
+// shift detected for one file and how much of it was read
+struct CrackResult
+{
+	ShiftEstimate estimate;
+	uint64_t file_size   = 0;
+	uint64_t bytes_read  = 0;
+	uint64_t blocks_read = 0;
+	uint64_t nletters    = 0;
+};
+
+// enciphered form of a plaintext search pattern
+//   with ignore_case set, letters of text are compared lowercased
+//   with whole_words set, a match must not touch letters or digits on either side
+struct CipherPattern
+{
+	string text;
+	bool ignore_case = false;
+	bool whole_words = false;
+};
+
+
 /*
  * CONSTANTS
  */
@@ -110,6 +742,155 @@ const varrchr ORIG_PUNCTS = {
 	'}', '~'
 }; 
 
+// classical output format (--classic): letters per group, groups per line
+//   and bytes of input compacted at a time
+const size_t CLASSIC_GROUP_LETTERS = 5;
+const size_t CLASSIC_LINE_GROUPS = 10;
+const size_t CLASSIC_BLOCK_BYTES = 64 * 1024;
+
+// --alphabet: codepoints covered by the dense table (all of 1- and 2-byte
+//   UTF-8, U+0000 to U+07FF)
+const uint32_t CODEPOINT_TABLE_SIZE = 0x800;
+
+// UTF-16 input: bytes read per block (even) and bytes sampled to detect
+//   UTF-16 without a byte order mark
+const size_t UTF16_BLOCK_BYTES = 64 * 1024;
+const size_t UTF16_SAMPLE_BYTES = 4096;
+
+// --csv: quote character and bytes scanned per block (a multiple of 64)
+const char CSV_QUOTE = '"';
+const size_t CSV_BLOCK_BYTES = 256 * 1024;
+
+// --follow: default stat-check interval, bytes enciphered per read, and the
+//   extension of the default state file
+const int FOLLOW_POLL_MS = 250;
+const size_t FOLLOW_BUFFER_BYTES = 256 * 1024;
+const string FOLLOW_STATE_EXT = ".follow";
+
+// --watch: files waiting for a worker before the watcher stops reading
+//   events, bytes enciphered per read, and the extension of the hidden
+//   temporary output renamed into place
+const size_t WATCH_QUEUE_LIMIT = 4096;
+const size_t WATCH_BUFFER_BYTES = 1024 * 1024;
+const string WATCH_TEMP_EXT = ".tmp";
+
+// --serve-shm: ring geometry, futex wait limit (so a stop request is seen),
+//   checks of a sequence before sleeping on it, and the slots a client keeps
+//   in flight
+const char SHM_RING_MAGIC[8] = {'S','C','R','I','N','G','\0','\0'};
+const uint32_t SHM_RING_VERSION = 1;
+const uint32_t SHM_SLOT_COUNT = 64;
+const uint32_t SHM_SLOT_BYTES = 64 * 1024;
+const int SHM_WAIT_MS = 100;
+const int SHM_SPIN_CHECKS = 256;
+const size_t SHM_CLIENT_DEPTH = 8;
+
+// --json: string delimiter and escape characters, and bytes scanned per
+//   block (a multiple of 64)
+const char JSON_QUOTE = '"';
+const char JSON_ESCAPE = '\\';
+const size_t JSON_BLOCK_BYTES = 256 * 1024;
+
+// --tar: size of a tar block (headers, padding) and bytes of member data
+//   enciphered at a time (a multiple of the block size)
+const size_t TAR_BLOCK_BYTES = 512;
+const size_t TAR_BUFFER_BYTES = 256 * 1024;
+
+// --autokey: bytes per chunk processed in parallel
+const size_t AUTOKEY_CHUNK_BYTES = 1024 * 1024;
+
+// --rekey: bytes re-keyed per task, suffix of the temporary copy of each
+//   file and default name of the journal of committed files
+const uint64_t REKEY_CHUNK_BYTES = 4 * 1024 * 1024;
+const string REKEY_TEMP_EXT = ".rekey.tmp";
+const string REKEY_JOURNAL_NAME = "shiftcipher.rekey.journal";
+
+// bytes of input turned into 26 output blocks at a time by --all-shifts
+const size_t ALL_SHIFTS_BLOCK_BYTES = 64 * 1024;
+
+// line-offset index sidecar (see LineIndexWriter/LineIndexReader)
+//   extension appended to the enciphered filename, file magic, format
+//   version and number of lines per block of the skip table
+const string LINE_INDEX_EXT = ".lidx";
+const char LINE_INDEX_MAGIC[4] = {'S','C','L','X'};
+const uint32_t LINE_INDEX_VERSION = 2;
+const uint32_t LINE_INDEX_BLOCK_LINES = 64;
+
+// inverted trigram index sidecar (see TrigramIndexBuilder/queryTrigramIndex)
+//   extension, file magic, format version and the number of lines handed
+//   to an indexing worker at a time
+const string TRIGRAM_INDEX_EXT = ".tgi";
+const char TRIGRAM_INDEX_MAGIC[4] = {'S','C','T','G'};
+const uint32_t TRIGRAM_INDEX_VERSION = 2;
+const size_t TRIGRAM_BATCH_LINES = 4096;
+
+// keys a trigram indexing worker holds before spilling them as a sorted run
+//   (32 MiB per worker) and the extension of the run files, numbered and
+//   written beside the index until finish() has merged them
+const size_t TRIGRAM_RUN_KEYS = 4 * 1024 * 1024;
+const string TRIGRAM_RUN_EXT = ".run";
+
+// Bloom filter sidecar (see BloomIndexWriter/searchBloomFiles)
+//   extension, file magic, format version, bytes of enciphered text per
+//   block filter, bits per distinct word and probes per word (about a 1%
+//   false-positive rate)
+const string BLOOM_INDEX_EXT = ".bloom";
+const char BLOOM_INDEX_MAGIC[4] = {'S','C','B','F'};
+const uint32_t BLOOM_INDEX_VERSION = 2;
+const uint64_t BLOOM_BLOCK_BYTES = 256 * 1024;
+const uint64_t BLOOM_BITS_PER_WORD = 10;
+const uint32_t BLOOM_NUM_HASHES = 7;
+
+// words ahead whose slot in a distinct-word set is prefetched
+const size_t BLOOM_PREFETCH_AHEAD = 8;
+
+// relative frequencies of the letters A-Z in English text, used to score
+//   candidate shifts with the chi-squared statistic
+const std::array<double,26> ENGLISH_LETTER_FREQS = {
+	0.08167, 0.01492, 0.02782, 0.04253, 0.12702, 0.02228, 0.02015,
+	0.06094, 0.06966, 0.00153, 0.00772, 0.04025, 0.02406, 0.06749,
+	0.07507, 0.01929, 0.00095, 0.05987, 0.06327, 0.09056, 0.02758,
+	0.00978, 0.02360, 0.00150, 0.01974, 0.00074
+};
+
+// index of coincidence of English text (random text: 1/26 = 0.0385)
+const double ENGLISH_IOC = 0.0667;
+
+// fewest letters per column for a period tried by --vigenere: the index of
+//   coincidence of shorter columns is mostly noise, and runs high
+const size_t VIGENERE_MIN_COLUMN_LETTERS = 15;
+
+// seed of the sampling offsets, mixed with the file size so that the same
+//   file is always sampled the same way
+const uint64_t SAMPLE_SEED = 0x5348494654ULL;
+
+// letters needed before sampling may stop early
+const uint64_t MIN_CRACK_LETTERS = 100;
+
+// bytes of ciphertext compacted to letters at a time by --crack
+const size_t CRACK_CHUNK_BYTES = 1 << 20;
+
+// quadgram language model (see QuadgramModel/buildQuadgramModel)
+//   default extension, file magic, format version, number of quadgrams,
+//   table units per log10 and the number of letters of Vigenere
+//   ciphertext used to refine a key
+const string QUADGRAM_MODEL_EXT = ".qgm";
+const char QUADGRAM_MODEL_MAGIC[4] = {'S','C','Q','G'};
+const uint32_t QUADGRAM_MODEL_VERSION = 1;
+const uint32_t QUADGRAM_COUNT = 26 * 26 * 26 * 26;
+const int32_t QUADGRAM_SCALE = 1000;
+const size_t QUADGRAM_REFINE_LETTERS = 20000;
+
+// word set (see WordSet/buildWordSet)
+//   default extension, file magic, format version, average words per
+//   perfect-hash bucket and the bytes of ciphertext whose words confirm
+//   the --crack candidates
+const string WORDSET_EXT = ".wset";
+const char WORDSET_MAGIC[4] = {'S','C','W','S'};
+const uint32_t WORDSET_VERSION = 1;
+const uint32_t WORDSET_BUCKET_WORDS = 4;
+const size_t WORDSET_SAMPLE_BYTES = 64 * 1024;
+
 
 /*
  * FUNCTION DECLARATIONS: Function declarations or definitions if not complex 
@@ -156,12 +937,193 @@ void printUsage(const string& progname) noexcept;
 void printHelp(const string& progname) noexcept;
 int parseCommandLine(const vecstr& usrCmdln, CipherOptions* ciphopts);
 
+// mix a character class by an --alphabet-key keyword
+varrchr mixAlphabet(const varrchr& alphabet, const string& keyword) noexcept;
+
 // create full enciphering dictionary (including alphabet, punctuation, numbers
 void generateCipherDict(CipherOptions* ciphopts) noexcept;
 
 // read input file, encipher and write output file
 void encipherFileText(CipherOptions* ciphopts);
 
+// byte table equivalent to a cipher dictionary
+std::array<char,256> cipherDictTable(const chrdict& dict) noexcept;
+
+// compile the encipher mode's transform (cipher dictionary or --transform
+//   chain) into one byte table, and apply it
+ByteTransform compileTransform(const CipherOptions* ciphopts);
+size_t applyTransform(const ByteTransform& transform, const char* in, size_t nbytes, char* out) noexcept;
+void prepareNibbleTables(ByteTransform* transform) noexcept;
+
+// --utf8: apply the transform to ASCII, validate and pass multi-byte
+//   sequences through
+size_t applyTransformUtf8(const ByteTransform& transform, const char* in, size_t nbytes, char* out, size_t* bad_offset) noexcept;
+
+// --alphabet: read alphabets, compile them with the ASCII transform into one
+//   codepoint table, and apply it to UTF-8 text
+std::vector<std::vector<uint32_t>> loadAlphabets(const string& spec);
+CodepointTransform compileCodepointTransform(const CipherOptions* ciphopts);
+size_t applyCodepointTransform(const CodepointTransform& transform, const char* in, size_t nbytes, char* out, size_t* bad_offset) noexcept;
+
+// encipher UTF-16 input as 16-bit code units, writing UTF-16 or UTF-8
+bool detectUtf16(const char* head, size_t nbytes, bool* big_endian, size_t* bom_bytes) noexcept;
+void encipherFileUtf16(CipherOptions* ciphopts);
+
+// encipher to uppercase letters in 5-letter groups
+void encipherClassic(CipherOptions* ciphopts);
+
+// re-key enciphered files in place from one shift to another
+void rekeyFiles(CipherOptions* ciphopts);
+
+// autokey cipher: chunk passes, parallel buffer transform and the mode
+std::array<std::array<char,256>,26> autokeyTables() noexcept;
+void autokeyChunk(const std::array<std::array<char,256>,26>& tables, const char* in, size_t nbytes, char* out,
+                  std::vector<uint8_t>* state, bool decipher) noexcept;
+std::vector<uint8_t> autokeyStateBefore(const char* text, size_t offset, const std::vector<uint8_t>& primer) noexcept;
+std::vector<AutokeyTerm> autokeySummary(const char* text, size_t nbytes, size_t k) noexcept;
+void autokeyBuffer(const char* in, size_t nbytes, char* out, const std::vector<uint8_t>& primer, bool decipher, unsigned nthreads);
+void autokeyFile(CipherOptions* ciphopts);
+
+// encipher selected columns of CSV/TSV text
+ByteTransform compileInPlaceTransform(const CipherOptions* ciphopts, const string& structural, const string& format);
+uint64_t prefixXor(uint64_t bits) noexcept;
+void encipherCsvColumns(CipherOptions* ciphopts);
+
+// encipher the string values of JSON text, optionally of selected members
+uint64_t escapedMask(uint64_t backslashes, uint64_t* carry) noexcept;
+void encipherJsonStrings(CipherOptions* ciphopts);
+
+// encipher a growing (and rotated) file incrementally until signalled
+void requestStop(int) noexcept;
+void followFile(CipherOptions* ciphopts);
+
+// encipher files as they are written into a directory, until signalled
+void encipherWatchedFile(const ByteTransform& transform, const fsys::path& ipath, const fsys::path& outdir,
+                         std::vector<char>* in_buffer, std::vector<char>* out_buffer, uint64_t* nbytes);
+void watchDirectory(CipherOptions* ciphopts);
+
+// shared-memory ring: futex waits on slot sequences, the service and a client
+void waitShmSlot(ShmSlot* slot, uint32_t observed, int timeout_ms);
+void publishShmSlot(ShmSlot* slot, uint32_t seq);
+void wakeShmSlot(ShmSlot* slot);
+void serveSharedRing(CipherOptions* ciphopts);
+void encipherThroughRing(CipherOptions* ciphopts);
+
+// encipher the members of a tar stream without extracting them
+size_t readFull(int fd, char* buffer, size_t nbytes, const fsys::path& path);
+void writeFull(int fd, const char* buffer, size_t nbytes, const fsys::path& path);
+uint64_t tarNumber(const char* field, size_t length) noexcept;
+void encipherTarStream(CipherOptions* ciphopts);
+
+// write the 26 shifted variants of the input file in one read pass
+void writeAllShifts(CipherOptions* ciphopts);
+
+// variable-length (LEB128) unsigned integer encoding used by the sidecar indexes
+size_t writeVarint(std::ostream& ostrm, uint64_t value);
+uint64_t readVarint(const unsigned char*& pos, const unsigned char* end);
+
+// stamp of an enciphered file and the check of a sidecar against it
+CipherFileStamp stampCipherFile(const fsys::path& cipherpath);
+bool matchesCipherFile(const CipherFileStamp& stamp, const fsys::path& cipherpath);
+
+// find the byte offset of a (0-based) line from a line-offset index
+uint64_t lookupLineOffset(const fsys::path& idxpath, const fsys::path& cipherpath, uint64_t line_number, uint64_t* num_lines);
+
+// decipher only the requested range of lines of an enciphered file
+void decipherLineRange(CipherOptions* ciphopts);
+
+// number of worker threads to use for parallel modes
+unsigned resolveThreadCount(const CipherOptions* ciphopts) noexcept;
+
+// position of the first match of an enciphered pattern in a buffer (or n)
+size_t findCipherPattern(const char* hay, size_t n, const CipherPattern& pat) noexcept;
+
+// helpers shared by the search modes: encipher the search pattern, find the
+//   lines containing it and decipher them for printing
+CipherPattern encipherPattern(const CipherOptions* ciphopts);
+void findMatchingLines(const char* base, size_t begin, size_t end, const CipherPattern& pattern,
+                       std::vector<std::pair<size_t,size_t>>* lines) noexcept;
+void decipherSpan(const chrdict& dict, const char* text, size_t nbytes, string* outstr);
+
+// search enciphered files for a plaintext pattern and print matching lines deciphered
+void grepCipherFiles(CipherOptions* ciphopts);
+
+// search enciphered files through their trigram indexes
+void queryTrigramIndex(CipherOptions* ciphopts);
+
+// hash of one enciphered word (or of many, from a padded buffer) and Bloom filter helpers
+uint64_t hashCipherWord(const char* word, size_t nbytes) noexcept;
+void hashCipherWords(const char* text, const std::vector<std::pair<uint32_t,uint32_t>>& words, uint64_t* hashes) noexcept;
+void addToBloomFilter(std::vector<unsigned char>* bits, uint64_t hash) noexcept;
+bool bloomFilterMayContain(const unsigned char* bits, uint64_t nbits, uint64_t hash) noexcept;
+
+// search enciphered files for whole words, skipping files and blocks whose
+//   Bloom filters rule the words out
+void searchBloomFiles(CipherOptions* ciphopts);
+
+// strip text down to its letters as alphabet indices 0-25 (case folded)
+void compactLetters(const char* text, size_t nbytes, std::vector<uint8_t>* letters);
+
+// chi-squared distance between letter counts deciphered with a shift and English
+double chiSquaredEnglish(const std::array<uint64_t,26>& counts, int shift) noexcept;
+
+// count the letters of a text (case folded, A/a = 0 ... Z/z = 25)
+void countLetters(const char* text, size_t nbytes, std::array<uint64_t,26>* counts) noexcept;
+
+// log-likelihood of ciphertext letter counts deciphered with a shift as English
+double logLikelihoodEnglish(const std::array<uint64_t,26>& counts, int shift) noexcept;
+
+// best and runner-up shifts for a set of ciphertext letter counts
+ShiftEstimate estimateShift(const std::array<uint64_t,26>& counts) noexcept;
+
+// detect shift changes between the lines of concatenated ciphertexts
+void detectSegmentShifts(CipherOptions* ciphopts);
+
+// count the quadgrams of an English corpus into a quadgram model file
+void buildQuadgramModel(CipherOptions* ciphopts);
+
+// add the quadgram scores of letters deciphered with every shift 0-25
+void scoreQuadgramShifts(const QuadgramModel& model, const uint8_t* letters, size_t nletters,
+                         std::array<int64_t,26>* scores) noexcept;
+
+// quadgram score of plaintext letters
+int64_t scoreQuadgrams(const QuadgramModel& model, const uint8_t* letters, size_t nletters) noexcept;
+
+// best and runner-up shifts from the quadgram scores of all shifts
+ShiftEstimate estimateShiftQuadgrams(const std::array<int64_t,26>& scores, int32_t scale) noexcept;
+
+// find the runs of letters (words) of a text as (offset, length) pairs
+void tokenizeWords(const char* text, size_t nbytes, std::vector<std::pair<uint32_t,uint32_t>>* tokens);
+
+// as tokenizeWords, for runs of letters and digits (see hashCipherWord)
+void tokenizeCipherWords(const char* text, size_t nbytes, std::vector<std::pair<uint32_t,uint32_t>>* tokens);
+
+// build a perfect-hash word set file from a word list
+void buildWordSet(CipherOptions* ciphopts);
+
+// fraction of the words of a ciphertext that deciphered with a shift are in a word set
+double recognisedWordFraction(const WordSet& words, const char* text,
+                              const std::vector<std::pair<uint32_t,uint32_t>>& tokens, int shift) noexcept;
+
+// estimate the shift of one file, optionally from sampled blocks
+CrackResult crackFileShift(const fsys::path& ifilepath, const CipherOptions* ciphopts,
+                           const QuadgramModel* model, CrackScratch* scratch);
+
+// estimate the shift of a ciphertext file and report it
+void crackShift(CipherOptions* ciphopts);
+
+// letter-only deciphering table for a shift
+std::array<char,256> letterShiftTable(int shift) noexcept;
+
+// estimate the shifts of all files of a directory in parallel and report them
+void crackDirectory(CipherOptions* ciphopts);
+
+// in-place radix-2 complex FFT (inverse=true for the unscaled inverse transform)
+void fourierTransform(std::vector<std::complex<double>>* data, bool inverse);
+
+// estimate the period and key of Vigenere ciphertext
+void analyzeVigenere(CipherOptions* ciphopts);
+
 // Print log-like information to terminal screen
 void printLogInfo(CipherOptions* ciphopts) noexcept;
 
@@ -192,7 +1154,75 @@ int main(int nargs, char* args[]) {
 			generateCipherDict(&cmdopts);
 
 			// can throw a filesystem_error exception
-			encipherFileText(&cmdopts);
+			switch( cmdopts.mode )
+			{
+				case CipherMode::Encipher:
+					encipherFileText(&cmdopts);
+					break;
+				case CipherMode::LineRange:
+					decipherLineRange(&cmdopts);
+					break;
+				case CipherMode::Grep:
+					grepCipherFiles(&cmdopts);
+					break;
+				case CipherMode::IndexQuery:
+					queryTrigramIndex(&cmdopts);
+					break;
+				case CipherMode::BloomSearch:
+					searchBloomFiles(&cmdopts);
+					break;
+				case CipherMode::Vigenere:
+					analyzeVigenere(&cmdopts);
+					break;
+				case CipherMode::Crack:
+					crackShift(&cmdopts);
+					break;
+				case CipherMode::Segments:
+					detectSegmentShifts(&cmdopts);
+					break;
+				case CipherMode::Quadgrams:
+					buildQuadgramModel(&cmdopts);
+					break;
+				case CipherMode::Wordset:
+					buildWordSet(&cmdopts);
+					break;
+				case CipherMode::CrackDir:
+					crackDirectory(&cmdopts);
+					break;
+				case CipherMode::AllShifts:
+					writeAllShifts(&cmdopts);
+					break;
+				case CipherMode::Classic:
+					encipherClassic(&cmdopts);
+					break;
+				case CipherMode::Rekey:
+					rekeyFiles(&cmdopts);
+					break;
+				case CipherMode::Autokey:
+					autokeyFile(&cmdopts);
+					break;
+				case CipherMode::Tar:
+					encipherTarStream(&cmdopts);
+					break;
+				case CipherMode::Csv:
+					encipherCsvColumns(&cmdopts);
+					break;
+				case CipherMode::Json:
+					encipherJsonStrings(&cmdopts);
+					break;
+				case CipherMode::Follow:
+					followFile(&cmdopts);
+					break;
+				case CipherMode::Watch:
+					watchDirectory(&cmdopts);
+					break;
+				case CipherMode::ServeShm:
+					serveSharedRing(&cmdopts);
+					break;
+				case CipherMode::ShmClient:
+					encipherThroughRing(&cmdopts);
+					break;
+			}// end switch(mode)
 
 			// print log-like info
 			if( cmdopts.display_log_info ) {
@@ -208,6 +1238,11 @@ int main(int nargs, char* args[]) {
 		cout << e.what() << endl;
 		return(1);
 	}
+	catch( const std::runtime_error& e ) {
+		// malformed sidecar files, I/O failures, etc.
+		cout << e.what() << endl;
+		return(1);
+	}
 	catch( ... ) {
 		// general catch-all error-handling
 		cout << "Unexpected error encountered. Program terminated." << endl;
@@ -238,6 +1273,35 @@ void printUsage(const string& progname) noexcept
 	cout << "Usage:" << endl;
 	cout << progname << " -i <IFILE>             to read IFILE input file and default output IFILE.ciph" << endl;
         cout << progname << " -i <IFILE> -o <OFILE>  to control name of output file" << endl;
+	cout << progname << " -i <IFILE> --lines A-B to decipher lines A to B of an indexed IFILE" << endl;
+	cout << progname << " -i <IFILE> --all-shifts to write IFILE.shift00 ... IFILE.shift25 in one pass" << endl;
+	cout << progname << " --rekey A:B -i <IFILE> [-i <IFILE> ...] to re-key enciphered IFILEs in place" << endl;
+	cout << progname << " --autokey <PRIMER> -i <IFILE> [-d] [--autokey-bench] for the autokey cipher" << endl;
+	cout << progname << " --tar -i <ARCHIVE|-> [--tar-glob <PATTERN>] [-o <OFILE|->] to encipher tar members" << endl;
+	cout << progname << " --csv --columns 3,7 -i <IFILE> [--delimiter tab] [--header] to encipher CSV columns" << endl;
+	cout << progname << " --json -i <IFILE> [--json-keys msg,user] to encipher JSON string values" << endl;
+	cout << progname << " --follow -i <IFILE> [-o <OFILE>] [--follow-state <FILE>] to encipher a growing log" << endl;
+	cout << progname << " --watch <DIR> --out <DIR> [--threads <N>] to encipher files as they land in DIR" << endl;
+	cout << progname << " --serve-shm <SOCKET> to encipher for other processes through a shared-memory ring" << endl;
+	cout << progname << " --shm-client <SOCKET> -i <IFILE> [-o <OFILE>] to encipher IFILE through that ring" << endl;
+	cout << progname << " --grep <PATTERN> -i <IFILE> [-i <IFILE> ...]" << endl;
+	cout << "      to print deciphered lines of enciphered IFILEs containing PATTERN" << endl;
+	cout << progname << " --index-query <PATTERN> -i <IFILE> [-i <IFILE> ...]" << endl;
+	cout << "      to do the same through the trigram indexes written with --build-index" << endl;
+	cout << progname << " --bloom-search <WORDS> -i <IFILE> [-i <IFILE> ...]" << endl;
+	cout << "      to search for whole WORDS, skipping blocks ruled out by --bloom filters" << endl;
+	cout << progname << " --crack -i <IFILE> [--sample-blocks <N>]" << endl;
+	cout << "      to estimate the shift IFILE was enciphered with" << endl;
+	cout << progname << " --crack-dir <DIR> [--report-format csv|json] [--decipher-to <OUTDIR>] [-o <REPORT>]" << endl;
+	cout << "      to estimate the shifts of all files in DIR" << endl;
+	cout << progname << " --segment-shifts -i <IFILE> [--window <W>] [-o <OFILE>]" << endl;
+	cout << "      to find where the shift changes in concatenated ciphertexts" << endl;
+	cout << progname << " --vigenere -i <IFILE> [--max-period <K>] [-o <OFILE>]" << endl;
+	cout << "      to estimate the key of Vigenere ciphertext (and decipher it to OFILE)" << endl;
+	cout << progname << " --build-quadgrams -i <CORPUS> [-o <MODEL>]" << endl;
+	cout << "      to build a quadgram model for --crack/--vigenere --quadgram-model <MODEL>" << endl;
+	cout << progname << " --build-wordset -i <WORDLIST> [-o <WORDSET>]" << endl;
+	cout << "      to build a word set for --crack --wordset <WORDSET>" << endl;
 	cout << endl;
 	cout << progname << " -h" << endl;
 	cout << progname << " --help";
@@ -283,6 +1347,186 @@ void printHelp(const string& progname) noexcept
 	cout << " \tInclude punctuation in shifted/enciphered alphabet (default: false)" << endl;
 	cout << "  -a, --shift-all           ";
 	cout << " \tShift both numbers and punctuation (default: false)" << endl;
+	cout << "  -d, --decipher            ";
+	cout << " \tDecipher IFILE with SHIFT instead of enciphering it (default: false)" << endl;
+	cout << endl;
+	cout << "      --csv                 ";
+	cout << " \tIFILE is CSV (or TSV with --delimiter tab): encipher only the --columns," << endl;
+	cout << "                            ";
+	cout << " \tleaving delimiters, quotes and line ends in place" << endl;
+	cout << "      --columns <LIST>      ";
+	cout << " \tComma-separated 1-based columns to encipher with --csv, e.g. 3,7" << endl;
+	cout << "      --delimiter <C>       ";
+	cout << " \tField delimiter for --csv (default: ,; \"tab\" for TSV)" << endl;
+	cout << "      --header              ";
+	cout << " \tWith --csv, leave the first record (column names) unchanged" << endl;
+	cout << "      --follow              ";
+	cout << " \tKeep enciphering IFILE as it grows (until interrupted), appending to OFILE;" << endl;
+	cout << "                            ";
+	cout << " \ta restart resumes where it stopped, and a rotated IFILE is followed anew" << endl;
+	cout << "      --follow-state <FILE> ";
+	cout << " \tState file of --follow (default: OFILE" << FOLLOW_STATE_EXT << ")" << endl;
+	cout << "      --poll-ms <MS>        ";
+	cout << " \tInterval of the --follow checks for rotation, and of polling without" << endl;
+	cout << "                            ";
+	cout << " \tinotify (default: " << FOLLOW_POLL_MS << ")" << endl;
+	cout << "      --watch <DIR>         ";
+	cout << " \tKeep enciphering the files written or moved into DIR (until interrupted)," << endl;
+	cout << "                            ";
+	cout << " \t--threads at a time; files already there are enciphered first if stale" << endl;
+	cout << "      --out <DIR>           ";
+	cout << " \tDirectory of the --watch outputs (NAME.ciph, each renamed into place)" << endl;
+	cout << "      --serve-shm <SOCKET>  ";
+	cout << " \tServe a shared-memory ring (until interrupted): producers fill slots," << endl;
+	cout << "                            ";
+	cout << " \twhich are enciphered in place; SOCKET hands the ring to each producer" << endl;
+	cout << "      --shm-client <SOCKET> ";
+	cout << " \tEncipher IFILE to OFILE through the ring of a --serve-shm service" << endl;
+	cout << "      --json                ";
+	cout << " \tIFILE is JSON or JSON Lines: encipher only the string values, leaving" << endl;
+	cout << "                            ";
+	cout << " \tmember names, numbers, literals, escapes and structure in place" << endl;
+	cout << "      --json-keys <LIST>    ";
+	cout << " \tWith --json, encipher only the values (and nested values) of these members" << endl;
+	cout << "      --tar                 ";
+	cout << " \tIFILE is a tar archive (\"-\" for standard input): encipher the data of" << endl;
+	cout << "                            ";
+	cout << " \tits regular files in one streaming pass and write a tar archive to OFILE" << endl;
+	cout << "                            ";
+	cout << " \t(\"-\" for standard output, the default when reading standard input)" << endl;
+	cout << "      --tar-glob <PATTERN>  ";
+	cout << " \tWith --tar, encipher only members whose path matches PATTERN" << endl;
+	cout << "      --autokey <PRIMER>    ";
+	cout << " \tEncipher (or -d decipher) with the autokey cipher: each letter is shifted" << endl;
+	cout << "                            ";
+	cout << " \tby the plaintext letter k places earlier, the k letters of PRIMER first" << endl;
+	cout << "      --autokey-bench       ";
+	cout << " \tWith --autokey, time enciphering and deciphering IFILE on 1 and -j" << endl;
+	cout << "                            ";
+	cout << " \tthreads and check the round trip instead of writing OFILE" << endl;
+	cout << "      --alphabet-key <KEY>  ";
+	cout << " \tEncipher with keyword-mixed alphabets: each shifted class starts with" << endl;
+	cout << "                            ";
+	cout << " \tthe characters of KEY, then the rest in order, and is rotated by SHIFT" << endl;
+	cout << "      --utf8                ";
+	cout << " \tTreat IFILE as UTF-8: shift the ASCII characters, pass multi-byte" << endl;
+	cout << "                            ";
+	cout << " \tcharacters through unchanged and stop at invalid UTF-8" << endl;
+	cout << "      --utf16               ";
+	cout << " \tTreat IFILE as UTF-16 (byte order from its byte order mark, or guessed);" << endl;
+	cout << "                            ";
+	cout << " \tinput starting with a UTF-16 byte order mark is always treated so" << endl;
+	cout << "      --to-utf8             ";
+	cout << " \tWrite UTF-16 input out as UTF-8 instead of UTF-16" << endl;
+	cout << "      --alphabet <ALPHA>    ";
+	cout << " \tAlso shift the letters of ALPHA (greek, cyrillic, latin1 or a UTF-8 file" << endl;
+	cout << "                            ";
+	cout << " \twith one alphabet per line), each within its own alphabet; may be" << endl;
+	cout << "                            ";
+	cout << " \trepeated and implies --utf8" << endl;
+	cout << "      --classic             ";
+	cout << " \tWrite only the letters, shifted and uppercased, in groups of five" << endl;
+	cout << "                            ";
+	cout << " \t(ten groups per line)" << endl;
+	cout << "      --all-shifts          ";
+	cout << " \tWrite all 26 shifts of IFILE to OFILE.shift00 ... OFILE.shift25 (OFILE" << endl;
+	cout << "                            ";
+	cout << " \tdefaults to IFILE), reading IFILE only once" << endl;
+	cout << "      --rekey <A:B>         ";
+	cout << " \tRe-key the IFILEs (-i may be repeated), enciphered with shift A, to" << endl;
+	cout << "                            ";
+	cout << " \tshift B in place, in parallel; each file is replaced only once its" << endl;
+	cout << "                            ";
+	cout << " \tre-keyed copy is complete, and an interrupted run resumes from the journal" << endl;
+	cout << "      --journal <JOURNAL>   ";
+	cout << " \tJournal of files committed by --rekey (default: " << REKEY_JOURNAL_NAME << ")" << endl;
+	cout << endl;
+	cout << "      --transform <STEP>    ";
+	cout << " \tApply a chain of steps instead of SHIFT (repeat for each step, applied" << endl;
+	cout << "                            ";
+	cout << " \tin order): shift:K, unshift:K, lower, upper, replace:XY, drop:CHARS" << endl;
+	cout << endl;
+	cout << "  -x, --line-index          ";
+	cout << " \tAlso write a line-offset index OFILE" << LINE_INDEX_EXT << " (default: false)" << endl;
+	cout << "      --lines <A-B>         ";
+	cout << " \tDecipher only lines A to B (1-based) of IFILE using IFILE" << LINE_INDEX_EXT << endl;
+	cout << "                            ";
+	cout << " \tOutput goes to OFILE if given, otherwise to the terminal" << endl;
+	cout << endl;
+	cout << "      --grep <PATTERN>      ";
+	cout << " \tPrint the deciphered lines of the enciphered IFILEs (-i may be repeated)" << endl;
+	cout << "                            ";
+	cout << " \tthat contain plaintext PATTERN, without deciphering whole files" << endl;
+	cout << "      --index-query <PATTERN>";
+	cout << "\tAs --grep, but look up candidate lines in IFILE" << TRIGRAM_INDEX_EXT << " and verify" << endl;
+	cout << "                            ";
+	cout << " \tonly those (requires the index sidecars written with --build-index)" << endl;
+	cout << "      --build-index         ";
+	cout << " \tAlso write a trigram index OFILE" << TRIGRAM_INDEX_EXT << " (implies --line-index)" << endl;
+	cout << "      --bloom               ";
+	cout << " \tAlso write Bloom filters of the enciphered words OFILE" << BLOOM_INDEX_EXT << endl;
+	cout << "      --bloom-search <WORDS>";
+	cout << " \tAs --grep, but WORDS must match whole words and files or blocks whose" << endl;
+	cout << "                            ";
+	cout << " \tIFILE" << BLOOM_INDEX_EXT << " filters lack a word are skipped without reading them" << endl;
+	cout << "      --crack               ";
+	cout << " \tReport the most likely shift of IFILE (chi-squared against English" << endl;
+	cout << "                            ";
+	cout << " \tletter frequencies), the runner-up and the confidence reached" << endl;
+	cout << "      --sample-blocks <N>   ";
+	cout << " \tWith --crack, read at most N randomly spaced blocks of IFILE and stop" << endl;
+	cout << "                            ";
+	cout << " \tas soon as the confidence is reached (default: 0, read everything)" << endl;
+	cout << "      --sample-size <BYTES> ";
+	cout << " \tBytes per sampled block (default: 65536)" << endl;
+	cout << "      --confidence <C>      ";
+	cout << " \tConfidence that ends sampling early, 0.5 < C < 1 (default: 0.999999)" << endl;
+	cout << "      --crack-dir <DIR>     ";
+	cout << " \tAs --crack for every file in DIR, in parallel; one report line per file" << endl;
+	cout << "                            ";
+	cout << " \t(name, best shift, confidence, runner-up, letters) to OFILE or the terminal" << endl;
+	cout << "      --report-format <FMT> ";
+	cout << " \tFormat of the --crack-dir report: csv or json (default: csv)" << endl;
+	cout << "      --decipher-to <OUTDIR>";
+	cout << "\tAlso write every file of DIR to OUTDIR deciphered with its detected shift" << endl;
+	cout << "      --segment-shifts      ";
+	cout << " \tReport the lines of IFILE where the shift changes (records enciphered" << endl;
+	cout << "                            ";
+	cout << " \twith different shifts); OFILE (if given) receives each segment" << endl;
+	cout << "                            ";
+	cout << " \tdeciphered with its detected shift" << endl;
+	cout << "      --window <W>          ";
+	cout << " \tLetters looked ahead to estimate each segment's shift (default: 200)" << endl;
+	cout << "      --vigenere            ";
+	cout << " \tReport the index of coincidence and autocorrelation of IFILE for key" << endl;
+	cout << "                            ";
+	cout << " \tlengths 1 to K, the most likely key length and the key recovered from" << endl;
+	cout << "                            ";
+	cout << " \tper-column letter counts; OFILE (if given) receives the deciphered text" << endl;
+	cout << "      --max-period <K>      ";
+	cout << " \tLongest key length tried by --vigenere (default: 20)" << endl;
+	cout << "      --build-quadgrams     ";
+	cout << " \tCount the quadgrams of English text IFILE into a binary model written" << endl;
+	cout << "                            ";
+	cout << " \tto OFILE (default: IFILE" << QUADGRAM_MODEL_EXT << ")" << endl;
+	cout << "      --quadgram-model <MODEL>";
+	cout << "\tScore --crack shifts and refine --vigenere keys by quadgram log" << endl;
+	cout << "                            ";
+	cout << " \tprobability from MODEL (reliable on short texts)" << endl;
+	cout << "      --build-wordset       ";
+	cout << " \tStore the words of word list IFILE in a perfect-hash word set written" << endl;
+	cout << "                            ";
+	cout << " \tto OFILE (default: IFILE" << WORDSET_EXT << ")" << endl;
+	cout << "      --wordset <WORDSET>   ";
+	cout << " \tConfirm the best --crack shifts by the fraction of real words they" << endl;
+	cout << "                            ";
+	cout << " \tdecipher to" << endl;
+	cout << "      --top-k <K>           ";
+	cout << " \tShifts confirmed with --wordset, 1-26 (default: 5)" << endl;
+	cout << "      --ignore-case         ";
+	cout << " \tMatch letters of PATTERN regardless of case (default: false)" << endl;
+	cout << "  -j, --threads <N>         ";
+	cout << " \tWorker threads for parallel modes (default: one per CPU)" << endl;
 	cout << "  -h, --help                ";
 	cout << " \tPrint HELP message and stop without processing" << endl;
 	cout << endl;
@@ -334,7 +1578,10 @@ int parseCommandLine(const vecstr& usr_cmdln, CipherOptions* ciphopts)
 		if( (curropt.compare("-i") == 0) or
 		    (curropt.compare("--ifile") == 0) ) 
 		{
-			ciphopts->infilename = usr_cmdln.at(opt_number + 1);
+			ciphopts->infilenames.push_back(usr_cmdln.at(opt_number + 1));
+			if( ciphopts->infilename.empty() ) {
+				ciphopts->infilename = ciphopts->infilenames.front();
+			}
 			opt_number += 2;
 		}
 		else if( (curropt.compare("-o") == 0) or
@@ -367,7 +1614,432 @@ int parseCommandLine(const vecstr& usr_cmdln, CipherOptions* ciphopts)
 			ciphopts->enc_puncts  = true;
 			opt_number += 1;
 		}
-		else if( (curropt.compare("--help") == 0) ) 
+		else if( (curropt.compare("--decipher") == 0) ) 
+		{
+			ciphopts->decipher = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--transform") == 0) ) 
+		{
+			ciphopts->transform_steps.push_back(usr_cmdln.at(opt_number + 1));
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--utf8") == 0) ) 
+		{
+			ciphopts->utf8 = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--csv") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Csv;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--columns") == 0) ) 
+		{
+			// accepted form: comma-separated 1-based column numbers, e.g. "3,7"
+			string currarg = usr_cmdln.at(opt_number + 1);
+			string cols_errmsg = std::format("\nInvalid columns ({}). Expected column numbers such as 3,7.\n", currarg);
+			ciphopts->csv_columns.clear();
+			for(size_t pos = 0; pos <= currarg.size(); ) {
+				size_t comma = std::min(currarg.find(',', pos), currarg.size());
+				size_t used = 0;
+				long long column = 0;
+				try {
+					column = std::stoll(currarg.substr(pos, comma - pos), &used, 10);
+				}
+				catch( const std::logic_error& ) {
+					throw std::invalid_argument(cols_errmsg);
+				}
+				if( (used != comma - pos) or (column < 1) or (column > 1000000) ) {
+					throw std::invalid_argument(cols_errmsg);
+				}
+				ciphopts->csv_columns.push_back(static_cast<size_t>(column));
+				pos = comma + 1;
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--delimiter") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			char delimiter = ( (currarg == "tab") or (currarg == "\\t") ) ? '\t' : ( currarg.size() == 1 ? currarg[0] : '\0' );
+			if( (delimiter == '\0') or (delimiter == '\n') or (delimiter == '\r') or (delimiter == CSV_QUOTE) or
+			    (((delimiter | 0x20) >= 'a') and ((delimiter | 0x20) <= 'z')) or ((delimiter >= '0') and (delimiter <= '9')) )
+			{
+				throw std::invalid_argument(std::format(
+					"\nInvalid delimiter ({}). Expected one punctuation or whitespace character, or tab.\n", currarg));
+			}
+			ciphopts->csv_delimiter = delimiter;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--header") == 0) ) 
+		{
+			ciphopts->csv_header = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--follow") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Follow;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--follow-state") == 0) ) 
+		{
+			ciphopts->follow_state = usr_cmdln.at(opt_number + 1);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--watch") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Watch;
+			ciphopts->watch_dir = usr_cmdln.at(opt_number + 1);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--out") == 0) ) 
+		{
+			ciphopts->out_dir = usr_cmdln.at(opt_number + 1);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--serve-shm") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::ServeShm;
+			ciphopts->shm_socket = usr_cmdln.at(opt_number + 1);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--shm-client") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::ShmClient;
+			ciphopts->shm_socket = usr_cmdln.at(opt_number + 1);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--poll-ms") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			int poll_ms = std::stoi(currarg, nullptr, 10);
+			if( (poll_ms < 1) or (poll_ms > 60000) ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid poll interval ({}). Must be 1 to 60000 milliseconds.\n", currarg));
+			}
+			ciphopts->follow_poll_ms = poll_ms;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--json") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Json;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--json-keys") == 0) ) 
+		{
+			// accepted form: comma-separated member names as written, e.g. "msg,user"
+			string currarg = usr_cmdln.at(opt_number + 1);
+			ciphopts->json_keys.clear();
+			for(size_t pos = 0; pos <= currarg.size(); ) {
+				size_t comma = std::min(currarg.find(',', pos), currarg.size());
+				if( comma == pos ) {
+					throw std::invalid_argument(std::format("\nInvalid JSON keys ({}). Expected member names such as msg,user.\n", currarg));
+				}
+				ciphopts->json_keys.push_back(currarg.substr(pos, comma - pos));
+				pos = comma + 1;
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--tar") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Tar;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--tar-glob") == 0) ) 
+		{
+			ciphopts->tar_glob = usr_cmdln.at(opt_number + 1);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--autokey") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			bool letters_only = not currarg.empty();
+			for(char chr : currarg) {
+				letters_only = letters_only and ((chr | 0x20) >= 'a') and ((chr | 0x20) <= 'z');
+			}
+			if( not letters_only ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid autokey primer ({}). Expected one or more letters.\n", currarg));
+			}
+			ciphopts->autokey_primer = currarg;
+			ciphopts->mode = CipherMode::Autokey;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--autokey-bench") == 0) ) 
+		{
+			ciphopts->autokey_bench = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--alphabet-key") == 0) ) 
+		{
+			ciphopts->alphabet_key = usr_cmdln.at(opt_number + 1);
+			if( ciphopts->alphabet_key.empty() ) {
+				throw std::invalid_argument("\nThe --alphabet-key keyword cannot be empty.\n");
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--utf16") == 0) ) 
+		{
+			ciphopts->utf16 = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--to-utf8") == 0) ) 
+		{
+			ciphopts->to_utf8 = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--alphabet") == 0) ) 
+		{
+			ciphopts->alphabets.push_back(usr_cmdln.at(opt_number + 1));
+			ciphopts->utf8 = true;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--classic") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Classic;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--rekey") == 0) ) 
+		{
+			// accepted form: "A:B", current and new shift
+			string currarg = usr_cmdln.at(opt_number + 1);
+			size_t colon = currarg.find(':');
+			if( (colon == string::npos) or (colon == 0) or (colon + 1 == currarg.size()) ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid re-key ({}). Expected A:B, the current and new shift.\n", currarg));
+			}
+			ciphopts->rekey_from = std::stoi(currarg.substr(0, colon), nullptr, 10);
+			ciphopts->rekey_to   = std::stoi(currarg.substr(colon + 1), nullptr, 10);
+			ciphopts->mode = CipherMode::Rekey;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--journal") == 0) ) 
+		{
+			ciphopts->journal_file = usr_cmdln.at(opt_number + 1);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--all-shifts") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::AllShifts;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--line-index") == 0) ) 
+		{
+			ciphopts->write_line_index = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--lines") == 0) ) 
+		{
+			// accepted forms: "A-B" or a single line "A"
+			string currarg = usr_cmdln.at(opt_number + 1);
+			string lr_errmsg = std::format(
+				"\nInvalid line range ({}). Expected A-B with 1 <= A <= B.\n", currarg);
+
+			size_t dash_pos = currarg.find('-');
+			try {
+				ciphopts->first_line = std::stoull(currarg.substr(0, dash_pos), nullptr, 10);
+				ciphopts->last_line  = ( dash_pos == string::npos ) ? ciphopts->first_line
+					: std::stoull(currarg.substr(dash_pos + 1), nullptr, 10);
+			}
+			catch( const std::logic_error& ) {
+				throw std::invalid_argument(lr_errmsg);
+			}
+
+			if( (ciphopts->first_line == 0) or (ciphopts->last_line < ciphopts->first_line) ) {
+				throw std::invalid_argument(lr_errmsg);
+			}
+
+			// the selected lines are always deciphered
+			ciphopts->mode = CipherMode::LineRange;
+			ciphopts->decipher = true;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--grep") == 0) ) 
+		{
+			ciphopts->grep_pattern = usr_cmdln.at(opt_number + 1);
+			if( ciphopts->grep_pattern.empty() or 
+			    (ciphopts->grep_pattern.find('\n') != string::npos) ) 
+			{
+				throw std::invalid_argument("\nThe --grep pattern must be non-empty and fit on one line.\n");
+			}
+			ciphopts->mode = CipherMode::Grep;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--index-query") == 0) ) 
+		{
+			ciphopts->grep_pattern = usr_cmdln.at(opt_number + 1);
+			if( ciphopts->grep_pattern.empty() or 
+			    (ciphopts->grep_pattern.find('\n') != string::npos) ) 
+			{
+				throw std::invalid_argument("\nThe --index-query pattern must be non-empty and fit on one line.\n");
+			}
+			ciphopts->mode = CipherMode::IndexQuery;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--bloom-search") == 0) ) 
+		{
+			ciphopts->grep_pattern = usr_cmdln.at(opt_number + 1);
+			if( ciphopts->grep_pattern.empty() or 
+			    (ciphopts->grep_pattern.find('\n') != string::npos) ) 
+			{
+				throw std::invalid_argument("\nThe --bloom-search words must be non-empty and fit on one line.\n");
+			}
+			ciphopts->mode = CipherMode::BloomSearch;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--crack") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Crack;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--sample-blocks") == 0) or
+		         (curropt.compare("--sample-size") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			long long value = std::stoll(currarg, nullptr, 10);
+			if( (value < 0) or ((value == 0) and (curropt.compare("--sample-size") == 0)) ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid {} value ({}).\n", curropt, currarg));
+			}
+
+			if( curropt.compare("--sample-blocks") == 0 ) {
+				ciphopts->sample_blocks = static_cast<uint64_t>(value);
+			}
+			else {
+				ciphopts->sample_block_size = static_cast<uint64_t>(value);
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--confidence") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			ciphopts->crack_confidence = std::stod(currarg, nullptr);
+			if( (ciphopts->crack_confidence <= 0.5) or (ciphopts->crack_confidence >= 1.0) ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid confidence ({}). Must be between 0.5 and 1.\n", currarg));
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--crack-dir") == 0) ) 
+		{
+			ciphopts->crack_dir = usr_cmdln.at(opt_number + 1);
+			ciphopts->mode = CipherMode::CrackDir;
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--report-format") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			if( (currarg != "csv") and (currarg != "json") ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid report format ({}). Expected csv or json.\n", currarg));
+			}
+			ciphopts->report_json = ( currarg == "json" );
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--decipher-to") == 0) ) 
+		{
+			ciphopts->decipher_dir = usr_cmdln.at(opt_number + 1);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--segment-shifts") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Segments;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--window") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			long long value = std::stoll(currarg, nullptr, 10);
+			if( value < 1 ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid window ({}). Must be at least 1 letter.\n", currarg));
+			}
+			ciphopts->segment_window = static_cast<uint64_t>(value);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--vigenere") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Vigenere;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--max-period") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			ciphopts->max_period = std::stoi(currarg, nullptr, 10);
+			if( ciphopts->max_period < 1 ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid maximum period ({}). Must be at least 1.\n", currarg));
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--build-quadgrams") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Quadgrams;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--quadgram-model") == 0) ) 
+		{
+			ciphopts->quadgram_model = usr_cmdln.at(opt_number + 1);
+			if( not fsys::exists(fsys::path(ciphopts->quadgram_model)) ) {
+				throw std::invalid_argument(std::format(
+					"\nQuadgram model not found ({}).\n", ciphopts->quadgram_model));
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--build-wordset") == 0) ) 
+		{
+			ciphopts->mode = CipherMode::Wordset;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--wordset") == 0) ) 
+		{
+			ciphopts->wordset = usr_cmdln.at(opt_number + 1);
+			if( not fsys::exists(fsys::path(ciphopts->wordset)) ) {
+				throw std::invalid_argument(std::format(
+					"\nWord set not found ({}).\n", ciphopts->wordset));
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--top-k") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			ciphopts->top_k = std::stoi(currarg, nullptr, 10);
+			if( (ciphopts->top_k < 1) or (ciphopts->top_k > 26) ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid --top-k value ({}). Must be between 1 and 26.\n", currarg));
+			}
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--bloom") == 0) ) 
+		{
+			ciphopts->write_bloom_filter = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--build-index") == 0) ) 
+		{
+			// candidate lines are located through the line-offset index
+			ciphopts->write_trigram_index = true;
+			ciphopts->write_line_index = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("--ignore-case") == 0) ) 
+		{
+			ciphopts->ignore_case = true;
+			opt_number += 1;
+		}
+		else if( (curropt.compare("-j") == 0) or
+		         (curropt.compare("--threads") == 0) ) 
+		{
+			string currarg = usr_cmdln.at(opt_number + 1);
+			int nthreads = std::stoi(currarg, nullptr, 10);
+			if( nthreads < 1 ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid thread count ({}). Must be at least 1.\n", currarg));
+			}
+			ciphopts->num_threads = static_cast<unsigned>(nthreads);
+			opt_number += 2;
+		}
+		else if( (curropt.compare("--help") == 0) ) 
 		{
 			parse_results = 1;
 			printHelp(ciphopts->prog_name_stripped);
@@ -385,7 +2057,7 @@ int parseCommandLine(const vecstr& usr_cmdln, CipherOptions* ciphopts)
 			bool valid_sco_used = false;
 
 			//string curropt = usr_cmdln.at(opt_number);
-			std::set<char> valid_singlechr_opts = {'a', 'l', 'n', 'p', 'h'};
+			std::set<char> valid_singlechr_opts = {'a', 'd', 'l', 'n', 'p', 'x', 'h'};
 
 			// if the overall argument is not valid, use this error message
 			string ia_errmsg = std::format(
@@ -405,9 +2077,15 @@ int parseCommandLine(const vecstr& usr_cmdln, CipherOptions* ciphopts)
 							ciphopts->enc_numbers = true;
 							ciphopts->enc_puncts  = true;
 							break;
+						case 'd':
+							ciphopts->decipher = true;
+							break;
 						case 'n':
 							ciphopts->enc_numbers = true;
 							break;
+						case 'x':
+							ciphopts->write_line_index = true;
+							break;
 						case 'p':
 							ciphopts->enc_puncts = true;
 							break;
@@ -426,6 +2104,8 @@ int parseCommandLine(const vecstr& usr_cmdln, CipherOptions* ciphopts)
 					ciphopts->display_log_info = false;
 					ciphopts->enc_numbers = false;
 					ciphopts->enc_puncts = false;
+					ciphopts->decipher = false;
+					ciphopts->write_line_index = false;
 
 					string sco_errmsg = std::format(
 						"\nInvalid single-character option ({:c}) within ({:s}). See HELP with -h or --help option.\n",
@@ -453,6 +2133,45 @@ int parseCommandLine(const vecstr& usr_cmdln, CipherOptions* ciphopts)
 	return(parse_results);
 }
 
+/*
+ * Description:
+ * Mixes a character class by a keyword (--alphabet-key): the keyword's
+ *   characters of that class come first, in keyword order and without
+ *   repeats, followed by the rest of the class in its usual order. Letters
+ *   of the keyword count in either case for both letter classes.
+ *
+ * Input:
+ * alphabet -> characters of the class in order
+ * keyword  -> keyword
+ *
+ * Output:
+ * Mixed alphabet (a permutation of alphabet)
+ */
+varrchr mixAlphabet(const varrchr& alphabet, const string& keyword) noexcept
+{
+	string order;
+	auto in_class = [&](char chr) {
+		return( std::find(std::begin(alphabet), std::end(alphabet), chr) != std::end(alphabet) );
+	};
+	auto add = [&](char chr) {
+		if( in_class(chr) and (order.find(chr) == string::npos) ) {
+			order.push_back(chr);
+		}
+	};
+
+	for(char chr : keyword) {
+		add(chr);
+		if( ((chr | 0x20) >= 'a') and ((chr | 0x20) <= 'z') ) {
+			add(static_cast<char>(chr ^ 0x20));
+		}
+	}
+	for(char chr : alphabet) {
+		add(chr);
+	}
+
+	return( varrchr(order.data(), order.size()) );
+}
+
 /*
  * Description:
  * Generate the necessary alphabet, punctuation and number mappings to put
@@ -466,18 +2185,47 @@ int parseCommandLine(const vecstr& usr_cmdln, CipherOptions* ciphopts)
  */
 void generateCipherDict(CipherOptions* ciphopts) noexcept
 {
+	// deciphering is enciphering with the inverse shift
+	int signed_shift = ciphopts->decipher ? -ciphopts->shift_amount : ciphopts->shift_amount;
+
 	// shift amount for regular uppercase & lowercase alphabet
-	ciphopts->effective_shift = calculateEffectiveShift(ciphopts->shift_amount);
+	ciphopts->effective_shift = calculateEffectiveShift(signed_shift);
 
 	// shift amounts for numbers, punctuation, both or neither
 	if( ciphopts->enc_numbers ) {
 		ciphopts->numbers_shift = calculateEffectiveShift(
-			ciphopts->shift_amount, static_cast<int>(ORIG_NUMBERS.size()));
+			signed_shift, static_cast<int>(ORIG_NUMBERS.size()));
 	}
 
 	if( ciphopts->enc_puncts ) {
 		ciphopts->puncts_shift = calculateEffectiveShift(
-			ciphopts->shift_amount, static_cast<int>(ORIG_PUNCTS.size()));
+			signed_shift, static_cast<int>(ORIG_PUNCTS.size()));
+	}
+
+	// --alphabet-key: the ciphertext alphabets are the keyword-mixed classes
+	//   rotated by SHIFT; a mixed alphabet is not a rotation of the plain
+	//   one, so deciphering inverts the enciphering mapping
+	if( not ciphopts->alphabet_key.empty() ) {
+		auto add_class = [&](const varrchr& orig, bool shifted) {
+			varrchr cipher = orig;
+			if( shifted ) {
+				cipher = mixAlphabet(orig, ciphopts->alphabet_key).cshift(
+					calculateEffectiveShift(ciphopts->shift_amount, static_cast<int>(orig.size())));
+			}
+			for(size_t n = 0; n < orig.size(); ++n) {
+				if( ciphopts->decipher ) {
+					ciphopts->cipher_dict[cipher[n]] = orig[n];
+				}
+				else {
+					ciphopts->cipher_dict[orig[n]] = cipher[n];
+				}
+			}
+		};
+		add_class(ORIG_UPPER, true);
+		add_class(ORIG_LOWER, true);
+		add_class(ORIG_NUMBERS, ciphopts->enc_numbers);
+		add_class(ORIG_PUNCTS, ciphopts->enc_puncts);
+		return;
 	}
 
 	// copies of the character arrays to be circularly shifted
@@ -535,6 +2283,32 @@ void encipherFileText(CipherOptions* ciphopts)
 		ifile.open(ifilepath);
 	}
 
+	// UTF-16 input (--utf16 or a UTF-16 byte order mark) is enciphered as
+	//   16-bit code units rather than lines of bytes
+	char head[2] = {0, 0};
+	bool big_endian = false;
+	size_t bom_bytes = 0;
+	ifile.read(head, 2);
+	detectUtf16(head, static_cast<size_t>(ifile.gcount()), &big_endian, &bom_bytes);
+	if( ciphopts->utf16 or (bom_bytes > 0) ) {
+		ifile.close();
+		encipherFileUtf16(ciphopts);
+		return;
+	}
+	ifile.clear();
+	ifile.seekg(0);
+
+	// Compile the transforms before any output is created, so a bad step
+	//   leaves an existing OFILE and its sidecars as they were
+	//   every byte goes through one table, however many transforms are chained
+	const ByteTransform transform = compileTransform(ciphopts);
+
+	// --alphabet: ASCII and 2-byte characters through one codepoint table
+	CodepointTransform cp_transform;
+	if( not ciphopts->alphabets.empty() ) {
+		cp_transform = compileCodepointTransform(ciphopts);
+	}
+
 	// Output text file
 	string fulloname;
 	if( ciphopts->use_default_oname ) {
@@ -549,30 +2323,85 @@ void encipherFileText(CipherOptions* ciphopts)
 
 	std::ofstream ofile(ofilepath);
 
+	// Optional line-offset index written alongside the output file
+	std::unique_ptr<LineIndexWriter> line_index;
+	uint64_t out_offset{0};
+	if( ciphopts->write_line_index ) {
+		line_index = std::make_unique<LineIndexWriter>(fsys::path(fulloname + LINE_INDEX_EXT));
+	}
+
+	// Optional trigram index, built by worker threads from the enciphered lines
+	std::unique_ptr<TrigramIndexBuilder> trigram_index;
+	if( ciphopts->write_trigram_index ) {
+		unsigned nworkers = std::max(1u, resolveThreadCount(ciphopts) - 1);
+		trigram_index = std::make_unique<TrigramIndexBuilder>(fsys::path(fulloname + TRIGRAM_INDEX_EXT), nworkers);
+	}
+
+	// Optional Bloom filters of the enciphered words
+	std::unique_ptr<BloomIndexWriter> bloom_index;
+	if( ciphopts->write_bloom_filter ) {
+		bloom_index = std::make_unique<BloomIndexWriter>(fsys::path(fulloname + BLOOM_INDEX_EXT), resolveThreadCount(ciphopts) - 1);
+	}
+
 	// Read input stream and write enciphered output stream
-	
 	size_t num_chrs_read{0};
+	uint64_t in_offset{0};
 
 	string origstr, outstr;
 	while( std::getline(ifile, origstr) ) {
-		for(size_t n = 0; n < origstr.size(); ++n, ++num_chrs_read, ciphopts->nbytes_file++) {
-			if(ciphopts->cipher_dict.contains(origstr[n])) {
-				outstr.push_back(ciphopts->cipher_dict[origstr[n]]);
-			}
-			else {
-				outstr.push_back(origstr[n]);
+		if( line_index ) {
+			line_index->addLine(out_offset);
+		}
+
+		outstr.resize(origstr.size());
+		if( ciphopts->utf8 ) {
+			size_t bad_offset = 0;
+			outstr.resize( cp_transform.units.empty()
+				? applyTransformUtf8(transform, origstr.data(), origstr.size(), outstr.data(), &bad_offset)
+				: applyCodepointTransform(cp_transform, origstr.data(), origstr.size(), outstr.data(), &bad_offset) );
+			if( bad_offset < origstr.size() ) {
+				throw std::runtime_error(std::format("\nInvalid UTF-8 at byte {:d} of {}.\n",
+				                                     in_offset + bad_offset, ifilepath.string()));
 			}
 		}
+		else {
+			outstr.resize(applyTransform(transform, origstr.data(), origstr.size(), outstr.data()));
+		}
+		in_offset += origstr.size() + 1;
+		num_chrs_read += origstr.size();
+		ciphopts->nbytes_file += origstr.size();
 
-		ofile << outstr << endl;
+		ofile << outstr << '\n';
 
-		origstr.clear();
-		outstr.clear();
-	}
+		if( trigram_index ) {
+			trigram_index->addLine(outstr);
+		}
+
+		if( bloom_index ) {
+			bloom_index->addLine(outstr, out_offset);
+		}
+
+		out_offset += outstr.size() + 1;  // line plus its newline
+
+		origstr.clear();
+		outstr.clear();
+	}
 
 	if( ifile.is_open() ) { ifile.close(); }
 	if( ofile.is_open() ) { ofile.close(); }
 
+	if( line_index ) {
+		line_index->finish(ofilepath);
+	}
+
+	if( trigram_index ) {
+		trigram_index->finish(ofilepath);
+	}
+
+	if( bloom_index ) {
+		bloom_index->finish(ofilepath);
+	}
+
 	// Print to screen the number of characters read
 	if( not ciphopts->display_log_info ) {
 		cout << endl;
@@ -583,6 +2412,7306 @@ void encipherFileText(CipherOptions* ciphopts)
 	return;
 }
 
+/*
+ * Description:
+ * Byte table equivalent to a cipher dictionary (bytes missing from the
+ *   dictionary map to themselves).
+ *
+ * Input:
+ * dict -> cipher dictionary from generateCipherDict
+ *
+ * Output:
+ * 256-entry byte table
+ */
+std::array<char,256> cipherDictTable(const chrdict& dict) noexcept
+{
+	std::array<char,256> table{};
+	for(size_t n = 0; n < 256; ++n) {
+		table[n] = static_cast<char>(n);
+	}
+	for(const auto& [orig, shifted] : dict) {
+		table[static_cast<unsigned char>(orig)] = shifted;
+	}
+
+	return(table);
+}
+
+/*
+ * Description:
+ * Compiles the byte-to-byte transform of the encipher mode into a single
+ *   table. Without --transform steps it is the cipher dictionary. Otherwise
+ *   the steps are composed left to right, each as a table over the output of
+ *   the previous ones:
+ *     shift:K    encipher with shift K (numbers/punctuation as with -n/-p)
+ *     unshift:K  decipher with shift K
+ *     lower      fold letters to lowercase
+ *     upper      fold letters to uppercase
+ *     replace:XY replace character X with Y
+ *     drop:CHARS delete the characters CHARS
+ *   so a chain of any length costs one lookup per byte. Newlines separate
+ *   the lines and cannot be replaced or dropped.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * Compiled transform (throws std::invalid_argument for a malformed step)
+ */
+ByteTransform compileTransform(const CipherOptions* ciphopts)
+{
+	ByteTransform transform;
+	if( ciphopts->transform_steps.empty() ) {
+		transform.table = cipherDictTable(ciphopts->cipher_dict);
+		prepareNibbleTables(&transform);
+		return(transform);
+	}
+
+	for(size_t n = 0; n < 256; ++n) {
+		transform.table[n] = static_cast<char>(n);
+	}
+
+	for(const string& step : ciphopts->transform_steps) {
+		const size_t colon = step.find(':');
+		const string name = step.substr(0, colon);
+		const string arg  = ( colon == string::npos ) ? string() : step.substr(colon + 1);
+		const string step_errmsg = std::format("\nInvalid --transform step ({}). See HELP with -h or --help option.\n", step);
+
+		// table of this step alone
+		std::array<char,256> step_table = cipherDictTable(chrdict());
+		std::array<bool,256> step_drop{};
+		if( (name == "shift") or (name == "unshift") ) {
+			CipherOptions stepopts;
+			stepopts.enc_numbers = ciphopts->enc_numbers;
+			stepopts.enc_puncts  = ciphopts->enc_puncts;
+			stepopts.decipher    = ( name == "unshift" );
+			try {
+				size_t used = 0;
+				stepopts.shift_amount = std::stoi(arg, &used, 10);
+				if( used != arg.size() ) {
+					throw std::invalid_argument(step_errmsg);
+				}
+			}
+			catch( const std::logic_error& ) {
+				throw std::invalid_argument(step_errmsg);
+			}
+			generateCipherDict(&stepopts);
+			step_table = cipherDictTable(stepopts.cipher_dict);
+		}
+		else if( ((name == "lower") or (name == "upper")) and (colon == string::npos) ) {
+			for(char chr = 'A'; chr <= 'Z'; ++chr) {
+				char lower = static_cast<char>(chr | 0x20);
+				step_table[static_cast<unsigned char>( (name == "lower") ? chr : lower )] = ( name == "lower" ) ? lower : chr;
+			}
+		}
+		else if( ciphopts->utf8 and std::any_of(arg.begin(), arg.end(), [](char chr) { return( static_cast<unsigned char>(chr) >= 0x80 ); }) ) {
+			// multi-byte characters are passed through whole in --utf8 mode
+			throw std::invalid_argument(std::format("\nInvalid --transform step ({}). With --utf8 only ASCII characters can be replaced or dropped.\n", step));
+		}
+		else if( (name == "replace") and (arg.size() == 2) and (arg.find('\n') == string::npos) ) {
+			step_table[static_cast<unsigned char>(arg[0])] = arg[1];
+		}
+		else if( (name == "drop") and (not arg.empty()) and (arg.find('\n') == string::npos) ) {
+			for(char chr : arg) {
+				step_drop[static_cast<unsigned char>(chr)] = true;
+			}
+		}
+		else {
+			throw std::invalid_argument(step_errmsg);
+		}
+
+		// compose: bytes already dropped stay dropped
+		for(size_t n = 0; n < 256; ++n) {
+			unsigned char mid = static_cast<unsigned char>(transform.table[n]);
+			transform.drop[n] = transform.drop[n] or step_drop[mid];
+			transform.table[n] = step_table[mid];
+		}
+	}
+
+	for(bool dropped : transform.drop) {
+		transform.drops_any = transform.drops_any or dropped;
+	}
+	prepareNibbleTables(&transform);
+
+	return(transform);
+}
+
+/*
+ * Description:
+ * Helpers for applyTransform: the table lookup of a whole register of
+ *   bytes at a time. With AVX-512 VBMI the 256-byte table sits in four
+ *   registers and two two-source byte permutes (VPERMI2B, 7-bit index) plus
+ *   a blend on the top bit translate 64 bytes. With SSSE3/AVX2 pshufb only
+ *   indexes 16 bytes, so the table is split by high nibble into 16 rows
+ *   stored as differences of consecutive rows (prepareNibbleTables); the
+ *   low half of the table is applied by eight pshufb on an index lowered
+ *   by 16 per step with signed saturation, so a byte stops contributing
+ *   (index negative, pshufb yields 0) once its row is passed and the xor of
+ *   the differences it picked up leaves exactly its own row's entry. Bytes
+ *   of 0x80 and above go through the upper eight rows the same way, only
+ *   for blocks that contain any.
+ */
+void prepareNibbleTables(ByteTransform* transform) noexcept
+{
+	for(size_t row = 0; row < 16; ++row) {
+		for(size_t col = 0; col < 16; ++col) {
+			uint8_t entry = static_cast<uint8_t>(transform->table[16 * row + col]);
+			uint8_t above = ( row % 8 == 0 ) ? 0 : static_cast<uint8_t>(transform->table[16 * (row - 1) + col]);
+			transform->nibble_tables[row][col] = entry ^ above;
+		}
+	}
+
+	return;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+size_t translateBytesAVX512(const ByteTransform& transform, const char* in, size_t nbytes, char* out) noexcept
+{
+	const __m512i rows0 = _mm512_loadu_si512(transform.table.data());
+	const __m512i rows1 = _mm512_loadu_si512(transform.table.data() + 64);
+	const __m512i rows2 = _mm512_loadu_si512(transform.table.data() + 128);
+	const __m512i rows3 = _mm512_loadu_si512(transform.table.data() + 192);
+
+	size_t n = 0;
+	for(; n + 64 <= nbytes; n += 64) {
+		__m512i bytes = _mm512_loadu_si512(in + n);
+		__m512i lower = _mm512_permutex2var_epi8(rows0, bytes, rows1);
+		__m512i upper = _mm512_permutex2var_epi8(rows2, bytes, rows3);
+		_mm512_storeu_si512(out + n, _mm512_mask_blend_epi8(_mm512_movepi8_mask(bytes), lower, upper));
+	}
+
+	return(n);
+}
+
+__attribute__((target("avx2")))
+size_t translateBytesAVX2(const ByteTransform& transform, const char* in, size_t nbytes, char* out) noexcept
+{
+	__m256i rows[16];
+	for(size_t row = 0; row < 16; ++row) {
+		rows[row] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(transform.nibble_tables[row].data())));
+	}
+	const __m256i step = _mm256_set1_epi8(16);
+	const __m256i top  = _mm256_set1_epi8(static_cast<char>(0x80));
+
+	size_t n = 0;
+	for(; n + 32 <= nbytes; n += 32) {
+		__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + n));
+		__m256i index = bytes;
+		__m256i result = _mm256_shuffle_epi8(rows[0], index);
+		for(size_t row = 1; row < 8; ++row) {
+			index = _mm256_subs_epi8(index, step);
+			result = _mm256_xor_si256(result, _mm256_shuffle_epi8(rows[row], index));
+		}
+		if( _mm256_movemask_epi8(bytes) != 0 ) {
+			index = _mm256_xor_si256(bytes, top);
+			__m256i upper = _mm256_shuffle_epi8(rows[8], index);
+			for(size_t row = 9; row < 16; ++row) {
+				index = _mm256_subs_epi8(index, step);
+				upper = _mm256_xor_si256(upper, _mm256_shuffle_epi8(rows[row], index));
+			}
+			result = _mm256_or_si256(result, upper);
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n), result);
+	}
+
+	return(n);
+}
+
+__attribute__((target("ssse3")))
+size_t translateBytesSSSE3(const ByteTransform& transform, const char* in, size_t nbytes, char* out) noexcept
+{
+	__m128i rows[16];
+	for(size_t row = 0; row < 16; ++row) {
+		rows[row] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(transform.nibble_tables[row].data()));
+	}
+	const __m128i step = _mm_set1_epi8(16);
+	const __m128i top  = _mm_set1_epi8(static_cast<char>(0x80));
+
+	size_t n = 0;
+	for(; n + 16 <= nbytes; n += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + n));
+		__m128i index = bytes;
+		__m128i result = _mm_shuffle_epi8(rows[0], index);
+		for(size_t row = 1; row < 8; ++row) {
+			index = _mm_subs_epi8(index, step);
+			result = _mm_xor_si128(result, _mm_shuffle_epi8(rows[row], index));
+		}
+		if( _mm_movemask_epi8(bytes) != 0 ) {
+			index = _mm_xor_si128(bytes, top);
+			__m128i upper = _mm_shuffle_epi8(rows[8], index);
+			for(size_t row = 9; row < 16; ++row) {
+				index = _mm_subs_epi8(index, step);
+				upper = _mm_xor_si128(upper, _mm_shuffle_epi8(rows[row], index));
+			}
+			result = _mm_or_si128(result, upper);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + n), result);
+	}
+
+	return(n);
+}
+#endif
+
+/*
+ * Description:
+ * Applies a compiled transform to a run of bytes. Without dropped bytes the
+ *   lookup is done a register at a time (AVX-512 VBMI, AVX2 or SSSE3), so
+ *   any substitution costs the same as a shift.
+ *
+ * Input:
+ * transform -> compiled transform
+ * in        -> bytes to transform
+ * nbytes    -> number of bytes
+ * out       -> (output) at least nbytes of space (may equal in)
+ *
+ * Output:
+ * Number of bytes written (fewer than nbytes if some were dropped)
+ */
+size_t applyTransform(const ByteTransform& transform, const char* in, size_t nbytes, char* out) noexcept
+{
+	if( not transform.drops_any ) {
+		size_t n = 0;
+#if defined(__x86_64__)
+		// whole registers by in-register table lookup, the tail a byte at a time
+		static const bool has_avx512 = __builtin_cpu_supports("avx512vbmi") and __builtin_cpu_supports("avx512bw");
+		static const bool has_avx2   = __builtin_cpu_supports("avx2");
+		static const bool has_ssse3  = __builtin_cpu_supports("ssse3");
+		if( has_avx512 ) {
+			n = translateBytesAVX512(transform, in, nbytes, out);
+		}
+		else if( has_avx2 ) {
+			n = translateBytesAVX2(transform, in, nbytes, out);
+		}
+		else if( has_ssse3 ) {
+			n = translateBytesSSSE3(transform, in, nbytes, out);
+		}
+#endif
+		for(; n < nbytes; ++n) {
+			out[n] = transform.table[static_cast<unsigned char>(in[n])];
+		}
+		return(nbytes);
+	}
+
+	size_t count = 0;
+	for(size_t n = 0; n < nbytes; ++n) {
+		unsigned char byte = static_cast<unsigned char>(in[n]);
+		out[count] = transform.table[byte];
+		count += transform.drop[byte] ? 0 : 1;
+	}
+
+	return(count);
+}
+
+/*
+ * Description:
+ * Helpers for applyTransformUtf8: length of the leading run of ASCII bytes
+ *   (64 bytes per test with AVX2: the two loads are or-ed and one movemask
+ *   shows whether any byte has its top bit set; 8 bytes per test otherwise)
+ *   and length of a valid UTF-8 sequence (0 if the bytes are not one:
+ *   stray continuation bytes, overlong forms, surrogates, codepoints past
+ *   U+10FFFF and truncated sequences are all rejected).
+ */
+size_t asciiPrefixScalar(const char* text, size_t nbytes) noexcept
+{
+	size_t n = 0;
+	for(; n + 8 <= nbytes; n += 8) {
+		uint64_t word;
+		std::memcpy(&word, text + n, 8);
+		if( (word & 0x8080808080808080ULL) != 0 ) {
+			break;
+		}
+	}
+	while( (n < nbytes) and (static_cast<unsigned char>(text[n]) < 0x80) ) {
+		++n;
+	}
+
+	return(n);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+size_t asciiPrefixAVX2(const char* text, size_t nbytes) noexcept
+{
+	size_t n = 0;
+	for(; n + 64 <= nbytes; n += 64) {
+		__m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + n));
+		__m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + n + 32));
+		if( _mm256_movemask_epi8(_mm256_or_si256(lo, hi)) != 0 ) {
+			uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(lo)) |
+			                (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hi))) << 32);
+			return( n + static_cast<size_t>(std::countr_zero(mask)) );
+		}
+	}
+
+	return( n + asciiPrefixScalar(text + n, nbytes - n) );
+}
+#endif
+
+size_t asciiPrefix(const char* text, size_t nbytes) noexcept
+{
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	if( has_avx2 ) {
+		return( asciiPrefixAVX2(text, nbytes) );
+	}
+#endif
+	return( asciiPrefixScalar(text, nbytes) );
+}
+
+size_t utf8SequenceLength(const char* text, size_t nbytes) noexcept
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+	const unsigned char lead = bytes[0];
+
+	// length and allowed range of the second byte, by lead byte
+	size_t length = 0;
+	unsigned char second_lo = 0x80, second_hi = 0xBF;
+	if( (lead >= 0xC2) and (lead <= 0xDF) ) { length = 2; }
+	else if( lead == 0xE0 ) { length = 3; second_lo = 0xA0; }
+	else if( lead == 0xED ) { length = 3; second_hi = 0x9F; }
+	else if( (lead >= 0xE1) and (lead <= 0xEF) ) { length = 3; }
+	else if( lead == 0xF0 ) { length = 4; second_lo = 0x90; }
+	else if( lead == 0xF4 ) { length = 4; second_hi = 0x8F; }
+	else if( (lead >= 0xF1) and (lead <= 0xF3) ) { length = 4; }
+
+	if( (length == 0) or (length > nbytes) or (bytes[1] < second_lo) or (bytes[1] > second_hi) ) {
+		return(0);
+	}
+	for(size_t n = 2; n < length; ++n) {
+		if( (bytes[n] & 0xC0) != 0x80 ) {
+			return(0);
+		}
+	}
+
+	return(length);
+}
+
+/*
+ * Description:
+ * Applies a compiled transform to UTF-8 text (--utf8). Runs of ASCII are
+ *   found with the vector test of asciiPrefix and go through the table
+ *   kernel of applyTransform whole; each multi-byte sequence between them is
+ *   validated and copied through untouched, so accented or non-Latin text
+ *   costs little more than ASCII. The transform must map ASCII to ASCII
+ *   (compileTransform checks this in --utf8 mode).
+ *
+ * Input:
+ * transform -> compiled transform
+ * in        -> UTF-8 bytes to transform (whole sequences, e.g. one line)
+ * nbytes    -> number of bytes
+ * out       -> (output) at least nbytes of space (may equal in)
+ * bad_offset -> (output) offset of the first invalid byte, nbytes if the
+ *                text is valid UTF-8 (the output stops before that byte)
+ *
+ * Output:
+ * Number of bytes written
+ */
+size_t applyTransformUtf8(const ByteTransform& transform, const char* in, size_t nbytes, char* out, size_t* bad_offset) noexcept
+{
+	size_t count = 0;
+	size_t n = 0;
+	while( n < nbytes ) {
+		const size_t run = asciiPrefix(in + n, nbytes - n);
+		count += applyTransform(transform, in + n, run, out + count);
+		n += run;
+		if( n == nbytes ) {
+			break;
+		}
+
+		const size_t length = utf8SequenceLength(in + n, nbytes - n);
+		if( length == 0 ) {
+			break;
+		}
+		std::memmove(out + count, in + n, length);
+		count += length;
+		n += length;
+	}
+	*bad_offset = n;
+
+	return(count);
+}
+
+/*
+ * Description:
+ * Reads the alphabets of an --alphabet specification: a built-in name
+ *   (greek, cyrillic or latin1, each an uppercase and a lowercase alphabet)
+ *   or a UTF-8 file with one alphabet per line, its letters in order
+ *   (blank lines, spaces and lines starting with '#' are ignored). Letters
+ *   must be 2-byte UTF-8 characters (U+0080 to U+07FF), which covers the
+ *   Latin-1, Latin Extended, Greek, Cyrillic, Armenian, Hebrew and Arabic
+ *   blocks.
+ *
+ * Input:
+ * spec -> built-in alphabet name or alphabet file
+ *
+ * Output:
+ * Alphabets as ordered codepoints (throws std::invalid_argument for an
+ *   unknown name or malformed file)
+ */
+std::vector<std::vector<uint32_t>> loadAlphabets(const string& spec)
+{
+	std::vector<std::vector<uint32_t>> alphabets;
+	auto add_range = [](std::vector<uint32_t>* alphabet, uint32_t first, uint32_t last, uint32_t skip) {
+		for(uint32_t cp = first; cp <= last; ++cp) {
+			if( cp != skip ) {
+				alphabet->push_back(cp);
+			}
+		}
+	};
+
+	if( spec == "greek" ) {
+		// U+03A2 is unassigned; final sigma (U+03C2) is left as it is
+		alphabets.resize(2);
+		add_range(&alphabets[0], 0x0391, 0x03A9, 0x03A2);
+		add_range(&alphabets[1], 0x03B1, 0x03C9, 0x03C2);
+		return(alphabets);
+	}
+	if( spec == "cyrillic" ) {
+		// Russian order, with Yo after Ie
+		alphabets.resize(2);
+		add_range(&alphabets[0], 0x0410, 0x0415, 0);
+		alphabets[0].push_back(0x0401);
+		add_range(&alphabets[0], 0x0416, 0x042F, 0);
+		add_range(&alphabets[1], 0x0430, 0x0435, 0);
+		alphabets[1].push_back(0x0451);
+		add_range(&alphabets[1], 0x0436, 0x044F, 0);
+		return(alphabets);
+	}
+	if( spec == "latin1" ) {
+		// accented letters of Latin-1, without the multiplication and
+		//   division signs
+		alphabets.resize(2);
+		add_range(&alphabets[0], 0x00C0, 0x00DE, 0x00D7);
+		add_range(&alphabets[1], 0x00E0, 0x00FE, 0x00F7);
+		return(alphabets);
+	}
+
+	fsys::path alphapath( spec );
+	if( not fsys::exists(alphapath) ) {
+		throw std::invalid_argument(std::format(
+			"\nInvalid alphabet ({}). Expected greek, cyrillic, latin1 or an alphabet file.\n", spec));
+	}
+
+	std::ifstream alphafile(alphapath, std::ios::binary);
+	string line;
+	size_t lineno = 0;
+	while( std::getline(alphafile, line) ) {
+		++lineno;
+		if( line.starts_with("#") ) {
+			continue;
+		}
+
+		std::vector<uint32_t> alphabet;
+		for(size_t n = 0; n < line.size(); ) {
+			unsigned char lead = static_cast<unsigned char>(line[n]);
+			if( (lead == ' ') or (lead == '\t') or (lead == '\r') ) {
+				++n;
+				continue;
+			}
+			if( utf8SequenceLength(line.data() + n, line.size() - n) != 2 ) {
+				throw std::invalid_argument(std::format(
+					"\nInvalid alphabet file {} (line {:d}). Letters must be 2-byte UTF-8 characters (U+0080 to U+07FF).\n",
+					spec, lineno));
+			}
+			alphabet.push_back( (static_cast<uint32_t>(lead & 0x1F) << 6) | (static_cast<unsigned char>(line[n + 1]) & 0x3F) );
+			n += 2;
+		}
+		if( not alphabet.empty() ) {
+			alphabets.push_back(std::move(alphabet));
+		}
+	}
+
+	if( alphabets.empty() ) {
+		throw std::invalid_argument(std::format("\nInvalid alphabet file {}. It defines no letters.\n", spec));
+	}
+
+	return(alphabets);
+}
+
+/*
+ * Description:
+ * Compiles the --alphabet transform: the ASCII part is the byte transform
+ *   of the English alphabets (and -n/-p), and every letter of the extra
+ *   alphabets is shifted among the letters of its own alphabet (the shift
+ *   taken modulo the alphabet's size, negated for -d). The result is one
+ *   dense table indexed by codepoint holding the encoded output.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * Compiled transform (throws std::invalid_argument for bad alphabets)
+ */
+CodepointTransform compileCodepointTransform(const CipherOptions* ciphopts)
+{
+	if( not ciphopts->transform_steps.empty() ) {
+		throw std::invalid_argument("\nThe --alphabet option cannot be combined with --transform steps.\n");
+	}
+
+	auto encode = [](uint32_t cp) -> uint32_t {
+		return( (0xC0 | (cp >> 6)) | ((0x80 | (cp & 0x3F)) << 8) );
+	};
+
+	CodepointTransform transform;
+	transform.ascii = compileTransform(ciphopts);
+	transform.units.resize(CODEPOINT_TABLE_SIZE);
+	for(uint32_t cp = 0; cp < 0x80; ++cp) {
+		transform.units[cp] = static_cast<unsigned char>(transform.ascii.table[cp]);
+	}
+	for(uint32_t cp = 0x80; cp < CODEPOINT_TABLE_SIZE; ++cp) {
+		transform.units[cp] = encode(cp);
+	}
+
+	const int signed_shift = ciphopts->decipher ? -ciphopts->shift_amount : ciphopts->shift_amount;
+	std::vector<bool> seen(CODEPOINT_TABLE_SIZE, false);
+	for(const string& spec : ciphopts->alphabets) {
+		for(const std::vector<uint32_t>& alphabet : loadAlphabets(spec)) {
+			const size_t shift = static_cast<size_t>(calculateEffectiveShift(signed_shift, static_cast<int>(alphabet.size())));
+			for(size_t n = 0; n < alphabet.size(); ++n) {
+				if( seen[alphabet[n]] ) {
+					throw std::invalid_argument(std::format(
+						"\nInvalid alphabet ({}). Letter U+{:04X} belongs to more than one alphabet.\n", spec, alphabet[n]));
+				}
+				seen[alphabet[n]] = true;
+				transform.units[alphabet[n]] = encode(alphabet[(n + shift) % alphabet.size()]);
+			}
+		}
+	}
+
+	return(transform);
+}
+
+/*
+ * Description:
+ * Helpers for applyCodepointTransform: one character through the table
+ *   (ASCII or 2-byte sequence; longer sequences are validated and copied),
+ *   and with AVX2 a 32-byte block made of ASCII and 2-byte sequences only.
+ *   The block kernel decodes the codepoint of every byte's sequence in
+ *   vector registers (a continuation byte takes its lead from the byte
+ *   before it), gathers the table entries eight at a time, keeps the lead
+ *   or continuation byte of each entry and packs the 32 results back into
+ *   bytes. It returns false, writing nothing, for any other block.
+ */
+size_t codepointStep(const CodepointTransform& transform, const char* in, size_t nbytes, char* out) noexcept
+{
+	const unsigned char lead = static_cast<unsigned char>(in[0]);
+	if( lead < 0x80 ) {
+		out[0] = static_cast<char>(transform.units[lead]);
+		return(1);
+	}
+
+	const size_t length = utf8SequenceLength(in, nbytes);
+	if( length == 2 ) {
+		uint32_t entry = transform.units[(static_cast<uint32_t>(lead & 0x1F) << 6) | (static_cast<unsigned char>(in[1]) & 0x3F)];
+		out[0] = static_cast<char>(entry & 0xFF);
+		out[1] = static_cast<char>(entry >> 8);
+	}
+	else if( length > 0 ) {
+		std::memmove(out, in, length);
+	}
+
+	return(length);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+bool codepointBlockAVX2(const uint32_t* units, const char* in, char* out) noexcept
+{
+	const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+	const __m256i lead_offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(static_cast<char>(0xC2)));
+	const uint32_t ascii = ~static_cast<uint32_t>(_mm256_movemask_epi8(bytes));
+	const uint32_t leads = static_cast<uint32_t>(_mm256_movemask_epi8(
+		_mm256_cmpeq_epi8(_mm256_min_epu8(lead_offset, _mm256_set1_epi8(0x1D)), lead_offset)));
+	const uint32_t conts = static_cast<uint32_t>(_mm256_movemask_epi8(
+		_mm256_cmpeq_epi8(_mm256_and_si256(bytes, _mm256_set1_epi8(static_cast<char>(0xC0))), _mm256_set1_epi8(static_cast<char>(0x80)))));
+
+	// every byte ASCII, lead or continuation, every lead followed by exactly
+	//   one continuation, and no sequence crossing the end of the block
+	if( ((ascii | leads | conts) != 0xFFFFFFFFu) or (conts != (leads << 1)) or ((leads >> 31) != 0) ) {
+		return(false);
+	}
+
+	const __m256i low5 = _mm256_set1_epi32(0x1F);
+	const __m256i low6 = _mm256_set1_epi32(0x3F);
+	const __m256i high2 = _mm256_set1_epi32(0xC0);
+	const __m256i cont_tag = _mm256_set1_epi32(0x80);
+	const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+	__m256i results[4];
+	for(int g = 0; g < 4; ++g) {
+		const char* base = in + 8 * g;
+		__m256i cur  = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(base)));
+		__m256i prev = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(base - 1)));
+		__m256i next = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(base + 1)));
+
+		__m256i is_cont  = _mm256_cmpeq_epi32(_mm256_and_si256(cur, high2), cont_tag);
+		__m256i is_ascii = _mm256_cmpgt_epi32(cont_tag, cur);
+		__m256i lead = _mm256_blendv_epi8(cur, prev, is_cont);
+		__m256i cont = _mm256_blendv_epi8(next, cur, is_cont);
+		__m256i index = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(lead, low5), 6), _mm256_and_si256(cont, low6));
+		index = _mm256_blendv_epi8(index, cur, is_ascii);
+
+		__m256i entry = _mm256_i32gather_epi32(reinterpret_cast<const int*>(units), index, 4);
+		entry = _mm256_blendv_epi8(entry, _mm256_srli_epi32(entry, 8), is_cont);
+		results[g] = _mm256_and_si256(entry, byte_mask);
+	}
+
+	__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(results[0], results[1]), _mm256_packus_epi32(results[2], results[3]));
+	packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+
+	return(true);
+}
+#endif
+
+/*
+ * Description:
+ * Applies an --alphabet transform to UTF-8 text. Runs of ASCII go through
+ *   the byte table kernel whole (see applyTransformUtf8); stretches of
+ *   ASCII mixed with 2-byte characters go through the AVX2 block kernel
+ *   32 bytes at a time; everything else a character at a time. Characters
+ *   of 3 and 4 bytes are validated and copied unchanged.
+ *
+ * Input:
+ * transform  -> compiled transform
+ * in         -> UTF-8 bytes to transform (whole sequences, e.g. one line)
+ * nbytes     -> number of bytes
+ * out        -> (output) at least nbytes of space (may equal in)
+ * bad_offset -> (output) offset of the first invalid byte, nbytes if the
+ *                text is valid UTF-8 (the output stops before that byte)
+ *
+ * Output:
+ * Number of bytes written
+ */
+size_t applyCodepointTransform(const CodepointTransform& transform, const char* in, size_t nbytes, char* out, size_t* bad_offset) noexcept
+{
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	size_t n = 0;
+	while( n < nbytes ) {
+		const size_t run = asciiPrefix(in + n, nbytes - n);
+		applyTransform(transform.ascii, in + n, run, out + n);
+		n += run;
+
+#if defined(__x86_64__)
+		// the kernel reads one byte either side of its block
+		if( has_avx2 ) {
+			while( (n > 0) and (n + 33 <= nbytes) and codepointBlockAVX2(transform.units.data(), in + n, out + n) ) {
+				n += 32;
+			}
+		}
+#endif
+		if( n == nbytes ) {
+			break;
+		}
+
+		const size_t length = codepointStep(transform, in + n, nbytes - n, out + n);
+		if( length == 0 ) {
+			break;
+		}
+		n += length;
+	}
+	*bad_offset = n;
+
+	return(n);
+}
+
+/*
+ * Description:
+ * Decides whether text is UTF-16 and in which byte order: a byte order
+ *   mark (FF FE or FE FF) decides it. Without one, the high-order byte of
+ *   a unit names its script block, so in a sample of the text those bytes
+ *   (odd offsets little-endian, even offsets big-endian) are mostly zeros
+ *   for ASCII or Latin text, or take only a few distinct values for a
+ *   handful of other scripts, while the low-order bytes vary widely.
+ *
+ * Input:
+ * head       -> first bytes of the file
+ * nbytes     -> number of bytes of head
+ * big_endian -> (output) byte order when UTF-16 is detected
+ * bom_bytes  -> (output) 2 if head starts with a byte order mark, else 0
+ *
+ * Output:
+ * True if the text was detected as UTF-16
+ */
+bool detectUtf16(const char* head, size_t nbytes, bool* big_endian, size_t* bom_bytes) noexcept
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(head);
+	*bom_bytes = 0;
+	if( (nbytes >= 2) and (bytes[0] == 0xFF) and (bytes[1] == 0xFE) ) {
+		*big_endian = false;
+		*bom_bytes = 2;
+		return(true);
+	}
+	if( (nbytes >= 2) and (bytes[0] == 0xFE) and (bytes[1] == 0xFF) ) {
+		*big_endian = true;
+		*bom_bytes = 2;
+		return(true);
+	}
+
+	size_t zeros[2] = {0, 0};
+	std::array<std::bitset<256>,2> seen;
+	const size_t nunits = std::min(nbytes, UTF16_SAMPLE_BYTES) / 2;
+	for(size_t n = 0; n < 2 * nunits; ++n) {
+		zeros[n & 1] += ( bytes[n] == 0 ) ? 1 : 0;
+		seen[n & 1].set(bytes[n]);
+	}
+
+	// side (0 even, 1 odd) that looks like the high-order bytes, if any
+	auto high_side = [&](size_t high, size_t low) {
+		bool mostly_zero = (2 * zeros[high] > nunits) and (8 * zeros[low] < zeros[high]);
+		bool few_blocks  = (seen[high].count() <= 8) and (4 * seen[high].count() <= seen[low].count());
+		return( mostly_zero or few_blocks );
+	};
+	if( (nunits > 0) and high_side(1, 0) ) {
+		*big_endian = false;
+		return(true);
+	}
+	if( (nunits > 0) and high_side(0, 1) ) {
+		*big_endian = true;
+		return(true);
+	}
+
+	return(false);
+}
+
+/*
+ * Description:
+ * Helpers for encipherFileUtf16: shifting host-order code units in place
+ *   through the codepoint table (units of U+0800 and above, surrogates
+ *   included, are left alone; with AVX2 16 units per vector, their table
+ *   entries fetched by two 8-wide gathers), and encoding units as UTF-8
+ *   (with AVX2, 16 ASCII units at a time are packed straight to bytes).
+ *   A high surrogate at the end of one call waits in pending_high for the
+ *   low surrogate at the start of the next.
+ */
+void shiftUnitsScalar(const uint32_t* table, uint16_t* units, size_t nunits) noexcept
+{
+	for(size_t n = 0; n < nunits; ++n) {
+		if( units[n] < CODEPOINT_TABLE_SIZE ) {
+			units[n] = static_cast<uint16_t>(table[units[n]]);
+		}
+	}
+
+	return;
+}
+
+bool asciiUnitsScalar(const uint16_t* units, char* out) noexcept
+{
+	uint64_t words[4];
+	std::memcpy(words, units, sizeof(words));
+	if( ((words[0] | words[1] | words[2] | words[3]) & 0xFF80FF80FF80FF80ULL) != 0 ) {
+		return(false);
+	}
+	for(size_t n = 0; n < 16; ++n) {
+		out[n] = static_cast<char>(units[n]);
+	}
+
+	return(true);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+void shiftUnitsAVX2(const uint32_t* table, uint16_t* units, size_t nunits) noexcept
+{
+	const __m256i last16 = _mm256_set1_epi16(static_cast<short>(CODEPOINT_TABLE_SIZE - 1));
+	const __m256i last32 = _mm256_set1_epi32(static_cast<int>(CODEPOINT_TABLE_SIZE - 1));
+	size_t n = 0;
+	for(; n + 16 <= nunits; n += 16) {
+		__m256i unit16 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(units + n));
+		__m256i in_table = _mm256_cmpeq_epi16(_mm256_min_epu16(unit16, last16), unit16);
+		if( _mm256_testz_si256(in_table, in_table) ) {
+			continue;
+		}
+
+		// indexes clamped into the table; entries of units past it are discarded
+		__m256i index_lo = _mm256_min_epu32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(unit16)), last32);
+		__m256i index_hi = _mm256_min_epu32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(unit16, 1)), last32);
+		__m256i shifted = _mm256_packus_epi32(_mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index_lo, 4),
+		                                      _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index_hi, 4));
+		shifted = _mm256_permute4x64_epi64(shifted, 0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(units + n), _mm256_blendv_epi8(unit16, shifted, in_table));
+	}
+	shiftUnitsScalar(table, units + n, nunits - n);
+
+	return;
+}
+
+__attribute__((target("avx2")))
+bool asciiUnitsAVX2(const uint16_t* units, char* out) noexcept
+{
+	__m256i unit16 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(units));
+	if( not _mm256_testz_si256(unit16, _mm256_set1_epi16(static_cast<short>(0xFF80))) ) {
+		return(false);
+	}
+	__m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(unit16), _mm256_extracti128_si256(unit16, 1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out), packed);
+
+	return(true);
+}
+#endif
+
+void shiftUnits(const uint32_t* table, uint16_t* units, size_t nunits) noexcept
+{
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	if( has_avx2 ) {
+		shiftUnitsAVX2(table, units, nunits);
+		return;
+	}
+#endif
+	shiftUnitsScalar(table, units, nunits);
+
+	return;
+}
+
+size_t encodeUnitsUtf8(const uint16_t* units, size_t nunits, char* out, uint32_t* pending_high, size_t* bad_index) noexcept
+{
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	size_t count = 0;
+	size_t n = 0;
+	*bad_index = nunits;
+	while( n < nunits ) {
+		if( (*pending_high == 0) and (n + 16 <= nunits) ) {
+#if defined(__x86_64__)
+			const bool ascii = has_avx2 ? asciiUnitsAVX2(units + n, out + count) : asciiUnitsScalar(units + n, out + count);
+#else
+			const bool ascii = asciiUnitsScalar(units + n, out + count);
+#endif
+			if( ascii ) {
+				n += 16;
+				count += 16;
+				continue;
+			}
+		}
+
+		const uint32_t unit = units[n];
+		uint32_t cp = unit;
+		if( *pending_high != 0 ) {
+			if( (unit < 0xDC00) or (unit > 0xDFFF) ) {
+				*bad_index = n;
+				return(count);
+			}
+			cp = 0x10000 + ((*pending_high - 0xD800) << 10) + (unit - 0xDC00);
+			*pending_high = 0;
+		}
+		else if( (unit >= 0xD800) and (unit <= 0xDBFF) ) {
+			*pending_high = unit;
+			++n;
+			continue;
+		}
+		else if( (unit >= 0xDC00) and (unit <= 0xDFFF) ) {
+			*bad_index = n;
+			return(count);
+		}
+		++n;
+
+		if( cp < 0x80 ) {
+			out[count++] = static_cast<char>(cp);
+		}
+		else if( cp < 0x800 ) {
+			out[count++] = static_cast<char>(0xC0 | (cp >> 6));
+			out[count++] = static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else if( cp < 0x10000 ) {
+			out[count++] = static_cast<char>(0xE0 | (cp >> 12));
+			out[count++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			out[count++] = static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else {
+			out[count++] = static_cast<char>(0xF0 | (cp >> 18));
+			out[count++] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			out[count++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			out[count++] = static_cast<char>(0x80 | (cp & 0x3F));
+		}
+	}
+
+	return(count);
+}
+
+/*
+ * Description:
+ * Enciphers UTF-16 text (--utf16, or any input starting with a UTF-16 byte
+ *   order mark; see detectUtf16 for the byte order). Blocks of the file are
+ *   read into host-order code units, shifted in place as 16-bit units
+ *   through the same codepoint table as --alphabet (ASCII letters, -n/-p and
+ *   any --alphabet letters) and written either back as UTF-16 in the input's
+ *   byte order or, with --to-utf8, transcoded to UTF-8 in the same pass (the
+ *   byte order mark is dropped). Unpaired surrogates only matter, and stop
+ *   with their offset, when transcoding.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND, or input that is not UTF-16)
+ */
+void encipherFileUtf16(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+	if( ciphopts->write_line_index or ciphopts->write_trigram_index or ciphopts->write_bloom_filter ) {
+		throw std::invalid_argument("\nLine, trigram and Bloom indexes are not written for UTF-16 input.\n");
+	}
+
+	// codepoint -> shifted codepoint, for every unit below the table size
+	std::vector<uint32_t> table(CODEPOINT_TABLE_SIZE);
+	if( not ciphopts->alphabets.empty() ) {
+		const CodepointTransform cp_transform = compileCodepointTransform(ciphopts);
+		for(uint32_t cp = 0; cp < CODEPOINT_TABLE_SIZE; ++cp) {
+			uint32_t entry = cp_transform.units[cp];
+			table[cp] = ( cp < 0x80 ) ? entry : (((entry & 0x1F) << 6) | ((entry >> 8) & 0x3F));
+		}
+	}
+	else {
+		const ByteTransform transform = compileTransform(ciphopts);
+		if( transform.drops_any ) {
+			throw std::invalid_argument("\nThe --transform drop step is not supported for UTF-16 input.\n");
+		}
+		for(uint32_t cp = 0; cp < CODEPOINT_TABLE_SIZE; ++cp) {
+			table[cp] = ( cp < 0x80 ) ? static_cast<unsigned char>(transform.table[cp]) : cp;
+		}
+	}
+
+	const string fulloname = ciphopts->use_default_oname ? ciphopts->infilename + ".ciph" : ciphopts->outfilename;
+	std::ifstream ifile(ifilepath, std::ios::binary);
+
+	std::vector<char> inbuf(UTF16_BLOCK_BYTES);
+	ifile.read(inbuf.data(), static_cast<std::streamsize>(inbuf.size()));
+	size_t nread = static_cast<size_t>(ifile.gcount());
+
+	bool big_endian = false;
+	size_t bom_bytes = 0;
+	if( not detectUtf16(inbuf.data(), nread, &big_endian, &bom_bytes) ) {
+		throw std::runtime_error(std::format("\nInput file {} does not look like UTF-16 (no byte order mark).\n", ifilepath.string()));
+	}
+	// checked up front so a malformed input leaves OFILE as it was
+	if( (fsys::file_size(ifilepath) - bom_bytes) % 2 != 0 ) {
+		throw std::runtime_error(std::format("\nInput file {} has an odd number of bytes for UTF-16.\n", ifilepath.string()));
+	}
+	std::ofstream ofile(fsys::path(fulloname), std::ios::binary | std::ios::trunc);
+
+	std::vector<uint16_t> units(UTF16_BLOCK_BYTES / 2);
+	string outbuf(3 * units.size() + 4, '\0');
+	uint32_t pending_high = 0;
+	uint64_t in_offset = 0;
+	uint64_t nunits_total = 0;
+	size_t skip = ciphopts->to_utf8 ? bom_bytes : 0;
+
+	while( nread > 0 ) {
+		if( nread % 2 != 0 ) {
+			throw std::runtime_error(std::format("\nInput file {} has an odd number of bytes for UTF-16.\n", ifilepath.string()));
+		}
+
+		const size_t nunits = nread / 2;
+		std::memcpy(units.data(), inbuf.data(), nread);
+		if( big_endian ) {
+			for(size_t n = 0; n < nunits; ++n) {
+				units[n] = __builtin_bswap16(units[n]);
+			}
+		}
+		shiftUnits(table.data(), units.data() + skip / 2, nunits - skip / 2);
+
+		if( ciphopts->to_utf8 ) {
+			size_t bad_index = 0;
+			size_t nout = encodeUnitsUtf8(units.data() + skip / 2, nunits - skip / 2, outbuf.data(), &pending_high, &bad_index);
+			ofile.write(outbuf.data(), static_cast<std::streamsize>(nout));
+			if( bad_index < nunits - skip / 2 ) {
+				throw std::runtime_error(std::format("\nUnpaired UTF-16 surrogate at byte {:d} of {}.\n",
+				                                     in_offset + skip + 2 * bad_index, ifilepath.string()));
+			}
+		}
+		else {
+			if( big_endian ) {
+				for(size_t n = 0; n < nunits; ++n) {
+					units[n] = __builtin_bswap16(units[n]);
+				}
+			}
+			ofile.write(reinterpret_cast<const char*>(units.data()), static_cast<std::streamsize>(nread));
+		}
+
+		nunits_total += nunits - skip / 2;
+		in_offset += nread;
+		skip = 0;
+		ifile.read(inbuf.data(), static_cast<std::streamsize>(inbuf.size()));
+		nread = static_cast<size_t>(ifile.gcount());
+	}
+	if( pending_high != 0 ) {
+		throw std::runtime_error(std::format("\nUnpaired UTF-16 surrogate at the end of {}.\n", ifilepath.string()));
+	}
+	ciphopts->nbytes_file += in_offset;
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Read {:d} UTF-16 {} code units from the input file.", nunits_total, big_endian ? "BE" : "LE") << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Enciphers IFILE in the classical format: only the letters are kept,
+ *   shifted and uppercased, in groups of five separated by spaces, ten
+ *   groups per line. Blocks of input are stripped to their letters by the
+ *   vectorized left-packing of compactLetters, shifted with a branch-free
+ *   loop over the packed letters (or looked up in a 26-letter table compiled
+ *   from --alphabet-key/--transform) and copied out a group at a time, so no
+ *   byte goes through a per-character filter. The output goes to OFILE, or
+ *   IFILE.ciph by default.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND, std::invalid_argument for a
+ *   transform that does not keep the letters letters)
+ */
+void encipherClassic(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	const string fulloname = ciphopts->use_default_oname ? ciphopts->infilename + ".ciph" : ciphopts->outfilename;
+	std::ifstream ifile(ifilepath, std::ios::binary);
+
+	const uint8_t shift = static_cast<uint8_t>(ciphopts->effective_shift);
+	const size_t line_letters = CLASSIC_GROUP_LETTERS * CLASSIC_LINE_GROUPS;
+
+	// --alphabet-key and --transform: the letters go through the compiled
+	//   transform instead of the plain shift; the letters are case folded
+	//   before enciphering, so both cases must map to the same letter
+	const bool plain_shift = ciphopts->alphabet_key.empty() and ciphopts->transform_steps.empty();
+	std::array<uint8_t,26> letter_map{};
+	std::array<bool,26> letter_drop{};
+	bool drops_letters = false;
+	if( not plain_shift ) {
+		const ByteTransform transform = compileTransform(ciphopts);
+		auto fold = [](char chr) {
+			const unsigned char byte = static_cast<unsigned char>(chr);
+			return( static_cast<unsigned char>( ((byte >= 'a') and (byte <= 'z')) ? byte - 0x20 : byte ) );
+		};
+		for(size_t letter = 0; letter < 26; ++letter) {
+			const unsigned char upper = static_cast<unsigned char>('A' + letter);
+			const unsigned char lower = static_cast<unsigned char>('a' + letter);
+			const unsigned char mapped = fold(transform.table[upper]);
+			const unsigned char mapped_lower = fold(transform.table[lower]);
+			if( (transform.drop[upper] != transform.drop[lower]) or
+			    ((not transform.drop[upper]) and (mapped != mapped_lower)) ) {
+				throw std::invalid_argument(std::format("\nWith --classic the letters are case folded, so {} and {} must encipher alike.\n",
+				                                        static_cast<char>(upper), static_cast<char>(lower)));
+			}
+			if( (not transform.drop[upper]) and ((mapped < 'A') or (mapped > 'Z')) ) {
+				throw std::invalid_argument(std::format("\nWith --classic the output is letters only, but {} enciphers to a non-letter.\n",
+				                                        static_cast<char>(upper)));
+			}
+			letter_map[letter] = mapped;
+			letter_drop[letter] = transform.drop[upper];
+			drops_letters = drops_letters or letter_drop[letter];
+		}
+	}
+	std::ofstream ofile(fsys::path(fulloname), std::ios::binary | std::ios::trunc);
+	std::vector<char> inbuf(CLASSIC_BLOCK_BYTES);
+	std::vector<uint8_t> letters;
+	letters.reserve(CLASSIC_BLOCK_BYTES + 64);
+
+	// every letter takes at most two bytes of output (itself and a separator)
+	string outbuf(2 * CLASSIC_BLOCK_BYTES + 2, '\0');
+	uint64_t nletters = 0;
+
+	while( ifile.read(inbuf.data(), static_cast<std::streamsize>(inbuf.size())) or (ifile.gcount() > 0) ) {
+		const size_t nread = static_cast<size_t>(ifile.gcount());
+		ciphopts->nbytes_file += nread;
+
+		letters.clear();
+		compactLetters(inbuf.data(), nread, &letters);
+		if( plain_shift ) {
+			for(uint8_t& letter : letters) {
+				letter = static_cast<uint8_t>(letter + shift);
+				letter = static_cast<uint8_t>('A' + letter - ( (letter >= 26) ? 26 : 0 ));
+			}
+		}
+		else if( not drops_letters ) {
+			for(uint8_t& letter : letters) {
+				letter = letter_map[letter];
+			}
+		}
+		else {
+			size_t kept = 0;
+			for(uint8_t letter : letters) {
+				letters[kept] = letter_map[letter];
+				kept += letter_drop[letter] ? 0 : 1;
+			}
+			letters.resize(kept);
+		}
+
+		// the separator goes in front of each letter that starts a group
+		size_t out = 0;
+		for(size_t n = 0; n < letters.size(); ) {
+			const size_t in_group = nletters % CLASSIC_GROUP_LETTERS;
+			if( (in_group == 0) and (nletters > 0) ) {
+				outbuf[out++] = ( nletters % line_letters == 0 ) ? '\n' : ' ';
+			}
+
+			const size_t count = std::min(CLASSIC_GROUP_LETTERS - in_group, letters.size() - n);
+			std::memcpy(outbuf.data() + out, letters.data() + n, count);
+			out += count;
+			n += count;
+			nletters += count;
+		}
+		ofile.write(outbuf.data(), static_cast<std::streamsize>(out));
+	}
+	if( nletters > 0 ) {
+		ofile.put('\n');
+	}
+
+	ofile.close();
+	if( not ofile ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to write output file.", fsys::path(fulloname), ec);
+	}
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Read {:d} characters from the input file.", ciphopts->nbytes_file) << endl;
+		cout << std::format("Wrote {:d} letters in groups of {:d}.", nletters, CLASSIC_GROUP_LETTERS) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Re-keys enciphered files in place from shift A to shift B. The composed
+ *   rotation (decipher A, then encipher B, per character class as chosen
+ *   with -n/-p, through the --alphabet-key mixed alphabets when given) is
+ *   compiled into one byte table, and every file is split into
+ *   chunks that worker threads read, translate and write at the same offset
+ *   of a temporary copy (FILE.rekey.tmp), in parallel across files and
+ *   chunks. The original is untouched until its copy is complete: the copy
+ *   is flushed to disk, a "commit" line for the file is appended to the
+ *   journal and flushed, and only then is the copy renamed over the
+ *   original. Rerunning after a crash with the same A:B skips committed
+ *   files (finishing the rename if it had not happened) and redoes the
+ *   rest; the journal is removed once every file is done. Files are keyed
+ *   by their canonical path, so each is re-keyed once however it is named,
+ *   and an empty journal (a crash before its header was written) counts as
+ *   a fresh one.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void rekeyFiles(CipherOptions* ciphopts)
+{
+	for(const string& fname : ciphopts->infilenames) {
+		if( not fsys::exists(fsys::path(fname)) ) {
+			string errmsg{"Input file not found."};
+			std::error_code ec;
+			throw fsys::filesystem_error(errmsg, fsys::path(fname), ec);
+		}
+	}
+
+	CipherOptions keyopts;
+	keyopts.enc_numbers = ciphopts->enc_numbers;
+	keyopts.enc_puncts  = ciphopts->enc_puncts;
+	keyopts.transform_steps = {std::format("unshift:{}", ciphopts->rekey_from), std::format("shift:{}", ciphopts->rekey_to)};
+	ByteTransform transform;
+	if( ciphopts->alphabet_key.empty() ) {
+		transform = compileTransform(&keyopts);
+	}
+	else {
+		// keyword-mixed alphabets are not rotations of each other, so the
+		//   composition is taken from the two cipher dictionaries directly
+		CipherOptions fromopts;
+		fromopts.enc_numbers  = ciphopts->enc_numbers;
+		fromopts.enc_puncts   = ciphopts->enc_puncts;
+		fromopts.alphabet_key = ciphopts->alphabet_key;
+		CipherOptions toopts = fromopts;
+		fromopts.decipher     = true;
+		fromopts.shift_amount = ciphopts->rekey_from;
+		toopts.shift_amount   = ciphopts->rekey_to;
+		generateCipherDict(&fromopts);
+		generateCipherDict(&toopts);
+		const std::array<char,256> from_table = cipherDictTable(fromopts.cipher_dict);
+		const std::array<char,256> to_table   = cipherDictTable(toopts.cipher_dict);
+		for(size_t n = 0; n < 256; ++n) {
+			transform.table[n] = to_table[static_cast<unsigned char>(from_table[n])];
+		}
+		prepareNibbleTables(&transform);
+	}
+
+	// journal of a previous, interrupted run
+	const fsys::path journalpath( ciphopts->journal_file.empty() ? REKEY_JOURNAL_NAME : ciphopts->journal_file );
+	string journal_header = std::format("rekey {}:{} numbers={:d} puncts={:d}", ciphopts->rekey_from,
+	                                    ciphopts->rekey_to, static_cast<int>(ciphopts->enc_numbers),
+	                                    static_cast<int>(ciphopts->enc_puncts));
+	if( not ciphopts->alphabet_key.empty() ) {
+		journal_header += " alphabet-key=" + ciphopts->alphabet_key;
+	}
+	std::set<string> committed;
+	if( fsys::exists(journalpath) and (fsys::file_size(journalpath) > 0) ) {
+		std::ifstream jfile(journalpath);
+		string line;
+		if( not std::getline(jfile, line) or (line != journal_header) ) {
+			throw std::invalid_argument(std::format(
+				"\nJournal {} belongs to another re-key run. Finish or remove it first.\n", journalpath.string()));
+		}
+		while( std::getline(jfile, line) ) {
+			if( line.starts_with("commit ") ) {
+				committed.insert(line.substr(7));
+			}
+		}
+	}
+
+	int journal_fd = ::open(journalpath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if( journal_fd < 0 ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to open journal.", journalpath, ec);
+	}
+	std::mutex journal_lock;
+	auto append_journal = [&](const string& line) {
+		std::lock_guard<std::mutex> guard(journal_lock);
+		string entry = line + '\n';
+		if( (::write(journal_fd, entry.data(), entry.size()) != static_cast<ssize_t>(entry.size())) or
+		    (::fsync(journal_fd) != 0) )
+		{
+			std::error_code ec(errno, std::generic_category());
+			throw fsys::filesystem_error("Unable to write journal.", journalpath, ec);
+		}
+	};
+	if( committed.empty() and (fsys::file_size(journalpath) == 0) ) {
+		append_journal(journal_header);
+	}
+
+	// the rename and the directory entry that records it
+	auto finish_rename = [](const fsys::path& temppath, const fsys::path& path) {
+		fsys::rename(temppath, path);
+		int dir_fd = ::open(fsys::absolute(path).parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if( dir_fd >= 0 ) {
+			::fsync(dir_fd);
+			::close(dir_fd);
+		}
+	};
+
+	struct RekeyFile
+	{
+		fsys::path path;
+		fsys::path temppath;
+		uint64_t size = 0;
+		std::atomic<uint64_t> chunks_left{0};
+		std::exception_ptr error;
+	};
+
+	// one entry per file however it is spelled, so a file named twice (or
+	//   through a link) is neither re-keyed twice nor journaled under two names
+	std::vector<fsys::path> paths;
+	std::set<fsys::path> seen;
+	for(const string& fname : ciphopts->infilenames) {
+		fsys::path path = fsys::weakly_canonical(fsys::path(fname));
+		if( seen.insert(path).second ) {
+			paths.push_back(path);
+		}
+	}
+
+	std::vector<RekeyFile> files(paths.size());
+	std::vector<std::pair<size_t,uint64_t>> tasks;
+	size_t nskipped = 0;
+
+	for(size_t f = 0; f < files.size(); ++f) {
+		RekeyFile& file = files[f];
+		file.path = paths[f];
+		file.temppath = fsys::path(file.path.string() + REKEY_TEMP_EXT);
+
+		if( committed.contains(file.path.string()) ) {
+			if( fsys::exists(file.temppath) ) {
+				finish_rename(file.temppath, file.path);
+			}
+			++nskipped;
+			continue;
+		}
+
+		// a leftover copy of an uncommitted file is incomplete, start over
+		struct stat st{};
+		int temp_fd = -1;
+		if( ::stat(file.path.c_str(), &st) == 0 ) {
+			temp_fd = ::open(file.temppath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+		}
+		if( (temp_fd < 0) or (::ftruncate(temp_fd, st.st_size) != 0) ) {
+			std::error_code ec(errno, std::generic_category());
+			if( temp_fd >= 0 ) { ::close(temp_fd); }
+			::close(journal_fd);
+			throw fsys::filesystem_error("Unable to create temporary file.", file.temppath, ec);
+		}
+		::close(temp_fd);
+
+		file.size = static_cast<uint64_t>(st.st_size);
+		const uint64_t nchunks = std::max<uint64_t>(1, (file.size + REKEY_CHUNK_BYTES - 1) / REKEY_CHUNK_BYTES);
+		file.chunks_left = nchunks;
+		for(uint64_t c = 0; c < nchunks; ++c) {
+			tasks.emplace_back(f, c);
+		}
+	}
+
+	// translate chunks; whoever finishes a file's last chunk commits it
+	std::atomic<size_t> next_task{0};
+	auto rekey_worker = [&]() {
+		std::vector<char> buffer(REKEY_CHUNK_BYTES);
+		for(size_t t = next_task++; t < tasks.size(); t = next_task++) {
+			RekeyFile& file = files[tasks[t].first];
+			const uint64_t offset = tasks[t].second * REKEY_CHUNK_BYTES;
+			const size_t nbytes = static_cast<size_t>(std::min<uint64_t>(REKEY_CHUNK_BYTES, file.size - offset));
+
+			try {
+				int in_fd  = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+				int out_fd = ::open(file.temppath.c_str(), O_WRONLY | O_CLOEXEC);
+				bool done = (in_fd >= 0) and (out_fd >= 0) and
+				            (::pread(in_fd, buffer.data(), nbytes, static_cast<off_t>(offset)) == static_cast<ssize_t>(nbytes));
+				if( done ) {
+					applyTransform(transform, buffer.data(), nbytes, buffer.data());
+					done = ::pwrite(out_fd, buffer.data(), nbytes, static_cast<off_t>(offset)) == static_cast<ssize_t>(nbytes);
+				}
+				std::error_code ec(errno, std::generic_category());
+				if( in_fd >= 0 ) { ::close(in_fd); }
+				if( out_fd >= 0 ) { ::close(out_fd); }
+				if( not done ) {
+					throw fsys::filesystem_error("Unable to re-key file.", file.path, ec);
+				}
+			}
+			catch( ... ) {
+				std::lock_guard<std::mutex> guard(journal_lock);
+				if( not file.error ) {
+					file.error = std::current_exception();
+				}
+			}
+
+			if( --file.chunks_left > 0 ) {
+				continue;
+			}
+
+			try {
+				if( file.error ) {
+					fsys::remove(file.temppath);
+					continue;
+				}
+
+				int temp_fd = ::open(file.temppath.c_str(), O_WRONLY | O_CLOEXEC);
+				bool synced = (temp_fd >= 0) and (::fsync(temp_fd) == 0);
+				std::error_code ec(errno, std::generic_category());
+				if( temp_fd >= 0 ) { ::close(temp_fd); }
+				if( not synced ) {
+					throw fsys::filesystem_error("Unable to flush temporary file.", file.temppath, ec);
+				}
+
+				append_journal("commit " + file.path.string());
+				finish_rename(file.temppath, file.path);
+			}
+			catch( ... ) {
+				std::lock_guard<std::mutex> guard(journal_lock);
+				file.error = std::current_exception();
+			}
+		}
+	};
+
+	const unsigned nthreads = resolveThreadCount(ciphopts);
+	std::vector<std::thread> workers;
+	for(unsigned w = 1; w < std::min<size_t>(nthreads, tasks.size()); ++w) {
+		workers.emplace_back(rekey_worker);
+	}
+	rekey_worker();
+	for(std::thread& thrd : workers) {
+		thrd.join();
+	}
+	::close(journal_fd);
+
+	for(const RekeyFile& file : files) {
+		if( file.error ) {
+			std::rethrow_exception(file.error);
+		}
+		ciphopts->nbytes_file += file.size;
+	}
+	fsys::remove(journalpath);
+
+	cout << endl;
+	cout << std::format("Re-keyed {:d} files from shift {} to shift {}", files.size() - nskipped,
+	                    ciphopts->rekey_from, ciphopts->rekey_to) << endl;
+	if( nskipped > 0 ) {
+		cout << std::format("Skipped {:d} files committed by an earlier run", nskipped) << endl;
+	}
+	cout << endl;
+
+	return;
+}
+
+/*
+ * Description:
+ * Helpers for the autokey mode. The 26 rotation tables come from
+ *   generateCipherDict like every other shift. The autokey state before a
+ *   letter is the k key letters that come next (oldest first): the primer,
+ *   then the plaintext letters. autokeyChunk runs a stretch of text from a
+ *   given state and leaves the state after it. autokeyStateBefore finds the
+ *   state before any byte of plaintext by looking back for its last k
+ *   letters (filling from the primer near the start). autokeySummary is the
+ *   deciphering counterpart for ciphertext, whose state is not known ahead:
+ *   each plaintext letter is its ciphertext letter minus the plaintext
+ *   letter k places earlier, so every letter of the state after a chunk is
+ *   a constant plus or minus exactly one letter of the state before it, and
+ *   the chunk is summarised as those k terms.
+ */
+std::array<std::array<char,256>,26> autokeyTables() noexcept
+{
+	std::array<std::array<char,256>,26> tables{};
+	for(int shift = 0; shift < 26; ++shift) {
+		CipherOptions shiftopts;
+		shiftopts.shift_amount = shift;
+		generateCipherDict(&shiftopts);
+		tables[static_cast<size_t>(shift)] = cipherDictTable(shiftopts.cipher_dict);
+	}
+
+	return(tables);
+}
+
+void autokeyChunk(const std::array<std::array<char,256>,26>& tables, const char* in, size_t nbytes, char* out,
+                  std::vector<uint8_t>* state, bool decipher) noexcept
+{
+	const size_t k = state->size();
+	size_t oldest = 0;
+	for(size_t n = 0; n < nbytes; ++n) {
+		const unsigned char byte = static_cast<unsigned char>(in[n]);
+		const uint8_t index = static_cast<uint8_t>((byte | 0x20) - 'a');
+		if( index >= 26 ) {
+			out[n] = static_cast<char>(byte);
+			continue;
+		}
+
+		const uint8_t key = (*state)[oldest];
+		if( decipher ) {
+			out[n] = tables[(26 - key) % 26][byte];
+			(*state)[oldest] = static_cast<uint8_t>((index + 26 - key) % 26);
+		}
+		else {
+			out[n] = tables[key][byte];
+			(*state)[oldest] = index;
+		}
+		oldest = ( oldest + 1 == k ) ? 0 : oldest + 1;
+	}
+	std::rotate(state->begin(), state->begin() + static_cast<std::ptrdiff_t>(oldest), state->end());
+
+	return;
+}
+
+std::vector<uint8_t> autokeyStateBefore(const char* text, size_t offset, const std::vector<uint8_t>& primer) noexcept
+{
+	const size_t k = primer.size();
+	std::vector<uint8_t> state(k);
+	size_t found = 0;
+	for(size_t n = offset; (n > 0) and (found < k); --n) {
+		const uint8_t index = static_cast<uint8_t>((static_cast<unsigned char>(text[n - 1]) | 0x20) - 'a');
+		if( index < 26 ) {
+			state[k - 1 - found] = index;
+			++found;
+		}
+	}
+	std::copy(primer.begin() + static_cast<std::ptrdiff_t>(found), primer.end(), state.begin());
+
+	return(state);
+}
+
+std::vector<AutokeyTerm> autokeySummary(const char* text, size_t nbytes, size_t k) noexcept
+{
+	std::vector<AutokeyTerm> terms(k);
+	for(size_t n = 0; n < k; ++n) {
+		terms[n] = AutokeyTerm{0, false, static_cast<uint32_t>(n)};
+	}
+
+	size_t oldest = 0;
+	for(size_t n = 0; n < nbytes; ++n) {
+		const uint8_t index = static_cast<uint8_t>((static_cast<unsigned char>(text[n]) | 0x20) - 'a');
+		if( index >= 26 ) {
+			continue;
+		}
+		const AutokeyTerm key = terms[oldest];
+		terms[oldest] = AutokeyTerm{static_cast<uint8_t>((index + 26 - key.constant) % 26), not key.negated, key.source};
+		oldest = ( oldest + 1 == k ) ? 0 : oldest + 1;
+	}
+	std::rotate(terms.begin(), terms.begin() + static_cast<std::ptrdiff_t>(oldest), terms.end());
+
+	return(terms);
+}
+
+/*
+ * Description:
+ * Enciphers or deciphers a buffer with the autokey cipher, in parallel
+ *   over AUTOKEY_CHUNK_BYTES chunks. Enciphering only looks back at
+ *   plaintext, so each chunk starts from autokeyStateBefore and all chunks
+ *   run at once. Deciphering has a serial dependency, so it takes three
+ *   passes: every chunk is summarised in parallel (autokeySummary), the
+ *   states at the chunk boundaries are then resolved in order from the
+ *   primer (k small operations per chunk), and finally all chunks are
+ *   deciphered in parallel from their resolved states. A single thread
+ *   runs straight through.
+ *
+ * Input:
+ * in       -> text to encipher or decipher
+ * nbytes   -> number of bytes
+ * out      -> (output) nbytes of space
+ * primer   -> primer letters as alphabet indices (A/a = 0)
+ * decipher -> decipher instead of encipher
+ * nthreads -> number of threads to use
+ *
+ * Output:
+ * None
+ */
+void autokeyBuffer(const char* in, size_t nbytes, char* out, const std::vector<uint8_t>& primer, bool decipher, unsigned nthreads)
+{
+	static const std::array<std::array<char,256>,26> tables = autokeyTables();
+	const size_t nchunks = (nbytes + AUTOKEY_CHUNK_BYTES - 1) / AUTOKEY_CHUNK_BYTES;
+	std::vector<std::vector<uint8_t>> states(nchunks + 1);
+
+	auto run_parallel = [&](auto&& chunk_work) {
+		std::atomic<size_t> next_chunk{0};
+		auto worker = [&]() {
+			for(size_t c = next_chunk++; c < nchunks; c = next_chunk++) {
+				chunk_work(c, in + c * AUTOKEY_CHUNK_BYTES, std::min(AUTOKEY_CHUNK_BYTES, nbytes - c * AUTOKEY_CHUNK_BYTES));
+			}
+		};
+		std::vector<std::thread> workers;
+		for(unsigned w = 1; w < std::min<size_t>(nthreads, nchunks); ++w) {
+			workers.emplace_back(worker);
+		}
+		worker();
+		for(std::thread& thrd : workers) {
+			thrd.join();
+		}
+	};
+
+	// a single thread gains nothing from the chunked passes
+	if( (nthreads <= 1) or (nchunks <= 1) ) {
+		std::vector<uint8_t> state = primer;
+		autokeyChunk(tables, in, nbytes, out, &state, decipher);
+		return;
+	}
+
+	if( not decipher ) {
+		run_parallel([&](size_t c, const char* chunk, size_t chunk_bytes) {
+			std::vector<uint8_t> state = autokeyStateBefore(in, c * AUTOKEY_CHUNK_BYTES, primer);
+			autokeyChunk(tables, chunk, chunk_bytes, out + c * AUTOKEY_CHUNK_BYTES, &state, false);
+		});
+		return;
+	}
+
+	// chunk summaries, then boundary states in order, then the chunks
+	std::vector<std::vector<AutokeyTerm>> summaries(nchunks);
+	run_parallel([&](size_t c, const char* chunk, size_t chunk_bytes) {
+		summaries[c] = autokeySummary(chunk, chunk_bytes, primer.size());
+	});
+
+	states[0] = primer;
+	for(size_t c = 0; c < nchunks; ++c) {
+		states[c + 1].resize(primer.size());
+		for(size_t n = 0; n < primer.size(); ++n) {
+			const AutokeyTerm& term = summaries[c][n];
+			const uint8_t source = states[c][term.source];
+			states[c + 1][n] = static_cast<uint8_t>((term.constant + (term.negated ? 26 - source : source)) % 26);
+		}
+	}
+
+	run_parallel([&](size_t c, const char* chunk, size_t chunk_bytes) {
+		std::vector<uint8_t> state = states[c];
+		autokeyChunk(tables, chunk, chunk_bytes, out + c * AUTOKEY_CHUNK_BYTES, &state, true);
+	});
+
+	return;
+}
+
+/*
+ * Description:
+ * Autokey mode (--autokey PRIMER): each letter is shifted by the letter k
+ *   places earlier in the plaintext, k being the length of the primer whose
+ *   letters key the first k letters; other characters are copied and do not
+ *   count. IFILE is enciphered (or with -d deciphered) into OFILE, or
+ *   IFILE.ciph by default, with autokeyBuffer. With --autokey-bench nothing
+ *   is written: both directions are timed on IFILE with one thread and with
+ *   all threads, and the round trip is checked.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void autokeyFile(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	std::vector<uint8_t> primer;
+	for(char chr : ciphopts->autokey_primer) {
+		primer.push_back(static_cast<uint8_t>((chr | 0x20) - 'a'));
+	}
+
+	const MappedFile infile(ifilepath);
+	const unsigned nthreads = resolveThreadCount(ciphopts);
+	std::vector<char> outbuf(infile.size());
+	ciphopts->nbytes_file += infile.size();
+
+	if( not ciphopts->autokey_bench ) {
+		autokeyBuffer(infile.data(), infile.size(), outbuf.data(), primer, ciphopts->decipher, nthreads);
+
+		const string fulloname = ciphopts->use_default_oname ? ciphopts->infilename + ".ciph" : ciphopts->outfilename;
+		std::ofstream ofile(fsys::path(fulloname), std::ios::binary | std::ios::trunc);
+		ofile.write(outbuf.data(), static_cast<std::streamsize>(outbuf.size()));
+
+		if( not ciphopts->display_log_info ) {
+			cout << endl;
+			cout << std::format("Read {:d} characters from the input file.", infile.size()) << endl;
+			cout << endl;
+		}
+		return;
+	}
+
+	// encipher IFILE, then decipher the result back, at 1 and all threads
+	std::vector<char> backbuf(infile.size());
+	auto throughput = [&](const char* in, char* out, bool decipher, unsigned threads) {
+		const auto start = std::chrono::steady_clock::now();
+		autokeyBuffer(in, infile.size(), out, primer, decipher, threads);
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return( static_cast<double>(infile.size()) / 1e6 / std::max(elapsed.count(), 1e-9) );
+	};
+
+	cout << endl;
+	cout << std::format("Autokey benchmark: {:d} bytes, primer of {:d} letters", infile.size(), primer.size()) << endl;
+	for(unsigned threads : {1u, nthreads}) {
+		double enc_rate = throughput(infile.data(), outbuf.data(), false, threads);
+		double dec_rate = throughput(outbuf.data(), backbuf.data(), true, threads);
+		if( not std::equal(backbuf.begin(), backbuf.end(), infile.data()) ) {
+			throw std::runtime_error("\nAutokey round trip failed: deciphering did not restore the input.\n");
+		}
+		cout << std::format("  {:3d} threads: encipher {:8.1f} MB/s, decipher {:8.1f} MB/s", threads, enc_rate, dec_rate) << endl;
+	}
+	cout << "  round trip verified" << endl;
+	cout << endl;
+
+	return;
+}
+
+/*
+ * Description:
+ * Helpers for encipherTarStream: reading and writing whole buffers on file
+ *   descriptors (pipes return short counts), and the numeric fields of a
+ *   tar header (octal text, or base-256 when the top bit of the first byte
+ *   is set, as GNU tar writes sizes of 8 GiB and more).
+ */
+size_t readFull(int fd, char* buffer, size_t nbytes, const fsys::path& path)
+{
+	size_t total = 0;
+	while( total < nbytes ) {
+		ssize_t nread = ::read(fd, buffer + total, nbytes - total);
+		if( (nread < 0) and (errno == EINTR) ) {
+			continue;
+		}
+		if( nread < 0 ) {
+			std::error_code ec(errno, std::generic_category());
+			throw fsys::filesystem_error("Unable to read input.", path, ec);
+		}
+		if( nread == 0 ) {
+			break;
+		}
+		total += static_cast<size_t>(nread);
+	}
+
+	return(total);
+}
+
+void writeFull(int fd, const char* buffer, size_t nbytes, const fsys::path& path)
+{
+	size_t total = 0;
+	while( total < nbytes ) {
+		ssize_t nwritten = ::write(fd, buffer + total, nbytes - total);
+		if( (nwritten < 0) and (errno == EINTR) ) {
+			continue;
+		}
+		if( nwritten <= 0 ) {
+			std::error_code ec(errno, std::generic_category());
+			throw fsys::filesystem_error("Unable to write output.", path, ec);
+		}
+		total += static_cast<size_t>(nwritten);
+	}
+
+	return;
+}
+
+uint64_t tarNumber(const char* field, size_t length) noexcept
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(field);
+	uint64_t value = 0;
+	if( bytes[0] & 0x80 ) {
+		for(size_t n = 1; n < length; ++n) {
+			value = (value << 8) | bytes[n];
+		}
+		return(value);
+	}
+
+	size_t n = 0;
+	while( (n < length) and (bytes[n] == ' ') ) {
+		++n;
+	}
+	for(; (n < length) and (bytes[n] >= '0') and (bytes[n] <= '7'); ++n) {
+		value = (value << 3) | (bytes[n] - '0');
+	}
+
+	return(value);
+}
+
+/*
+ * Description:
+ * Enciphers the regular-file members of a tar stream (--tar) without
+ *   extracting them: IFILE (or standard input for "-") is read one header
+ *   at a time, headers, padding and every other member (directories, links,
+ *   members not matching --tar-glob) are copied unchanged, and the data of
+ *   matching regular files goes through the byte table in TAR_BUFFER_BYTES
+ *   pieces, so the archive is processed in one streaming pass with constant
+ *   memory. Member names come from the ustar name and prefix fields, or
+ *   from a preceding GNU long-name or pax path record, and a pax size
+ *   record (extended or global header) overrides the size field. The output goes to
+ *   OFILE ("-" for standard output), IFILE.ciph by default, or standard
+ *   output when reading standard input; the report then goes to the error
+ *   stream so as not to mix with the archive.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND, or a malformed archive)
+ */
+void encipherTarStream(CipherOptions* ciphopts)
+{
+	const bool from_stdin = ( ciphopts->infilename == "-" );
+	const fsys::path ifilepath( from_stdin ? "<stdin>" : ciphopts->infilename );
+	if( (not from_stdin) and (not fsys::exists(ifilepath)) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	const ByteTransform transform = compileTransform(ciphopts);
+	if( transform.drops_any ) {
+		throw std::invalid_argument("\nThe --transform drop step would change member sizes and is not supported with --tar.\n");
+	}
+
+	const bool to_stdout = ( ciphopts->use_default_oname and from_stdin ) or ( ciphopts->outfilename == "-" );
+	const fsys::path ofilepath( to_stdout ? "<stdout>" : (ciphopts->use_default_oname ? ciphopts->infilename + ".ciph" : ciphopts->outfilename) );
+
+	int in_fd = from_stdin ? STDIN_FILENO : ::open(ifilepath.c_str(), O_RDONLY | O_CLOEXEC);
+	if( in_fd < 0 ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to open input file.", ifilepath, ec);
+	}
+	int out_fd = to_stdout ? STDOUT_FILENO : ::open(ofilepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if( out_fd < 0 ) {
+		std::error_code ec(errno, std::generic_category());
+		if( not from_stdin ) { ::close(in_fd); }
+		throw fsys::filesystem_error("Unable to open output file.", ofilepath, ec);
+	}
+
+	std::vector<char> buffer(TAR_BUFFER_BYTES);
+	char header[TAR_BLOCK_BYTES];
+	string long_name;          // from a GNU long-name record or pax path
+	uint64_t pax_size = 0, global_size = 0;         // pax size= of the next member, of all members
+	bool has_pax_size = false, has_global_size = false;
+	uint64_t in_offset = 0;
+	uint64_t nmembers = 0, nenciphered = 0, nbytes_enciphered = 0;
+
+	try {
+		while( true ) {
+			size_t nread = readFull(in_fd, header, TAR_BLOCK_BYTES, ifilepath);
+			if( nread == 0 ) {
+				break;
+			}
+			if( nread < TAR_BLOCK_BYTES ) {
+				throw std::runtime_error(std::format("\nTruncated tar header at byte {:d} of {}.\n", in_offset, ifilepath.string()));
+			}
+			writeFull(out_fd, header, TAR_BLOCK_BYTES, ofilepath);
+			in_offset += TAR_BLOCK_BYTES;
+
+			// end of archive: the zero blocks and anything after them are copied
+			if( std::all_of(header, header + TAR_BLOCK_BYTES, [](char chr) { return( chr == 0 ); }) ) {
+				while( (nread = readFull(in_fd, buffer.data(), buffer.size(), ifilepath)) > 0 ) {
+					writeFull(out_fd, buffer.data(), nread, ofilepath);
+				}
+				break;
+			}
+
+			// checksum: header bytes summed with the checksum field read as spaces
+			uint64_t checksum = 0;
+			for(size_t n = 0; n < TAR_BLOCK_BYTES; ++n) {
+				checksum += ( (n >= 148) and (n < 156) ) ? ' ' : static_cast<unsigned char>(header[n]);
+			}
+			if( checksum != tarNumber(header + 148, 8) ) {
+				throw std::runtime_error(std::format("\nInvalid tar header checksum at byte {:d} of {}.\n",
+				                                     in_offset - TAR_BLOCK_BYTES, ifilepath.string()));
+			}
+
+			// pax extended headers ('x' for the next member, 'g' for all that
+			//   follow) and GNU long names/links describe a member, they are not one
+			const char type = header[156];
+			const bool metadata = (type == 'L') or (type == 'K') or (type == 'x') or (type == 'g');
+
+			// a pax size= record overrides the header field, which cannot hold
+			//   sizes of 8 GiB and more in octal
+			uint64_t size = tarNumber(header + 124, 12);
+			if( not metadata ) {
+				size = has_pax_size ? pax_size : (has_global_size ? global_size : size);
+			}
+			const uint64_t padded = (size + TAR_BLOCK_BYTES - 1) / TAR_BLOCK_BYTES * TAR_BLOCK_BYTES;
+
+			string name = long_name;
+			if( name.empty() ) {
+				name.assign(header, strnlen(header, 100));
+				if( std::memcmp(header + 257, "ustar", 5) == 0 ) {
+					string prefix(header + 345, strnlen(header + 345, 155));
+					name = prefix.empty() ? name : prefix + "/" + name;
+				}
+			}
+
+			const bool regular  = (type == '0') or (type == '\0') or (type == '7');
+			const bool encipher = regular and (ciphopts->tar_glob.empty() or (::fnmatch(ciphopts->tar_glob.c_str(), name.c_str(), 0) == 0));
+			string record;
+
+			for(uint64_t done = 0; done < padded; ) {
+				const size_t piece = static_cast<size_t>(std::min<uint64_t>(buffer.size(), padded - done));
+				if( readFull(in_fd, buffer.data(), piece, ifilepath) < piece ) {
+					throw std::runtime_error(std::format("\nTruncated tar member {} in {}.\n", name, ifilepath.string()));
+				}
+				if( encipher and (done < size) ) {
+					applyTransform(transform, buffer.data(), static_cast<size_t>(std::min<uint64_t>(piece, size - done)), buffer.data());
+				}
+				if( metadata and (record.size() < size) ) {
+					record.append(buffer.data(), static_cast<size_t>(std::min<uint64_t>(piece, size - record.size())));
+				}
+				writeFull(out_fd, buffer.data(), piece, ofilepath);
+				done += piece;
+			}
+			in_offset += padded;
+
+			// the name and size recorded by metadata members apply to the next
+			//   member (to every following one for a pax global header)
+			if( type == 'L' ) {
+				long_name.assign(record.c_str());
+			}
+			else if( (type == 'x') or (type == 'g') ) {
+				// pax records: "<length> <key>=<value>\n"
+				for(size_t pos = 0; pos < record.size(); ) {
+					size_t space = record.find(' ', pos);
+					size_t length = ( space == string::npos ) ? 0 : std::strtoull(record.c_str() + pos, nullptr, 10);
+					if( (length == 0) or (pos + length > record.size()) ) {
+						break;
+					}
+					string entry = record.substr(space + 1, pos + length - space - 2);
+					if( entry.starts_with("path=") and (type == 'x') ) {
+						long_name = entry.substr(5);
+					}
+					else if( entry.starts_with("size=") ) {
+						( type == 'x' ? pax_size : global_size ) = std::strtoull(entry.c_str() + 5, nullptr, 10);
+						( type == 'x' ? has_pax_size : has_global_size ) = true;
+					}
+					pos += length;
+				}
+			}
+			else if( not metadata ) {
+				++nmembers;
+				nenciphered += encipher ? 1 : 0;
+				nbytes_enciphered += encipher ? size : 0;
+				long_name.clear();
+				has_pax_size = false;
+			}
+		}
+	}
+	catch( ... ) {
+		if( not from_stdin ) { ::close(in_fd); }
+		if( not to_stdout ) { ::close(out_fd); }
+		throw;
+	}
+
+	if( not from_stdin ) { ::close(in_fd); }
+	if( not to_stdout ) { ::close(out_fd); }
+	ciphopts->nbytes_file += in_offset;
+
+	if( not ciphopts->display_log_info ) {
+		std::ostream& report = to_stdout ? cerr : cout;
+		report << endl;
+		report << std::format("Enciphered {:d} of {:d} tar members ({:d} bytes of file data).", nenciphered, nmembers, nbytes_enciphered) << endl;
+		report << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Compiles the transform of the modes that encipher fields in place (--csv,
+ *   --json): the encipher transform with the structural characters taken out
+ *   of the punctuation class (the other punctuation is shifted among itself),
+ *   so no field byte is turned into, or out of, a structural character. The
+ *   shifted bytes are blended back at their own offsets, so nothing may be
+ *   dropped either.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ * structural -> characters that must keep their meaning
+ * format -> name of the format, for the error message
+ *
+ * Output:
+ * Compiled transform (throws std::invalid_argument if --transform steps
+ *   would still change the structure or drop characters)
+ */
+ByteTransform compileInPlaceTransform(const CipherOptions* ciphopts, const string& structural, const string& format)
+{
+	ByteTransform transform = compileTransform(ciphopts);
+
+	if( ciphopts->enc_puncts and ciphopts->transform_steps.empty() ) {
+		string kept;
+		for(char chr : ORIG_PUNCTS) {
+			if( structural.find(chr) == string::npos ) {
+				kept.push_back(chr);
+			}
+		}
+		const varrchr puncts(kept.data(), kept.size());
+		const size_t count = kept.size();
+
+		varrchr cipher = ciphopts->alphabet_key.empty() ? puncts : mixAlphabet(puncts, ciphopts->alphabet_key);
+		const int signed_shift = ( ciphopts->decipher and ciphopts->alphabet_key.empty() ) ? -ciphopts->shift_amount : ciphopts->shift_amount;
+		cipher = cipher.cshift(calculateEffectiveShift(signed_shift, static_cast<int>(count)));
+		for(size_t n = 0; n < count; ++n) {
+			if( ciphopts->decipher and (not ciphopts->alphabet_key.empty()) ) {
+				transform.table[static_cast<unsigned char>(cipher[n])] = puncts[n];
+			}
+			else {
+				transform.table[static_cast<unsigned char>(puncts[n])] = cipher[n];
+			}
+		}
+		for(char chr : structural) {
+			transform.table[static_cast<unsigned char>(chr)] = chr;
+		}
+		prepareNibbleTables(&transform);
+	}
+
+	for(size_t n = 0; n < 256; ++n) {
+		const bool from = structural.find(static_cast<char>(n)) != string::npos;
+		const bool to   = structural.find(transform.table[n]) != string::npos;
+		if( ((from or to) and (transform.table[n] != static_cast<char>(n))) or transform.drop[n] ) {
+			throw std::invalid_argument(std::format("\nThe --transform steps would change the {} structure or drop characters.\n", format));
+		}
+	}
+
+	return(transform);
+}
+
+/*
+ * Description:
+ * Helpers for encipherCsvColumns: bitmasks of the delimiters, quotes and
+ *   newlines of 64 bytes (bit n for byte n; two 32-byte compares each with
+ *   AVX2), the inclusive prefix XOR that turns quote bits into the mask of
+ *   quoted bytes, and the blend that keeps a shifted byte wherever a mask
+ *   bit is set (a masked byte move with AVX-512BW).
+ */
+void csvMasksScalar(const char* text, char delimiter, uint64_t* delims, uint64_t* quotes, uint64_t* newlines) noexcept
+{
+	*delims = *quotes = *newlines = 0;
+	for(size_t n = 0; n < 64; ++n) {
+		*delims   |= static_cast<uint64_t>( text[n] == delimiter ) << n;
+		*quotes   |= static_cast<uint64_t>( text[n] == CSV_QUOTE ) << n;
+		*newlines |= static_cast<uint64_t>( text[n] == '\n' ) << n;
+	}
+
+	return;
+}
+
+uint64_t prefixXor(uint64_t bits) noexcept
+{
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+
+	return(bits);
+}
+
+void blendMaskedScalar(const char* shifted, uint64_t mask, char* text) noexcept
+{
+	while( mask != 0 ) {
+		const size_t n = static_cast<size_t>(std::countr_zero(mask));
+		text[n] = shifted[n];
+		mask &= mask - 1;
+	}
+
+	return;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline uint64_t equalMaskAVX2(__m256i lo, __m256i hi, __m256i value) noexcept
+{
+	return( static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, value)))) |
+	        (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, value)))) << 32) );
+}
+
+__attribute__((target("avx2")))
+void csvMasksAVX2(const char* text, char delimiter, uint64_t* delims, uint64_t* quotes, uint64_t* newlines) noexcept
+{
+	const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text));
+	const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + 32));
+	*delims   = equalMaskAVX2(lo, hi, _mm256_set1_epi8(delimiter));
+	*quotes   = equalMaskAVX2(lo, hi, _mm256_set1_epi8(CSV_QUOTE));
+	*newlines = equalMaskAVX2(lo, hi, _mm256_set1_epi8('\n'));
+
+	return;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void blendMaskedAVX512(const char* shifted, uint64_t mask, char* text) noexcept
+{
+	_mm512_mask_storeu_epi8(text, mask, _mm512_loadu_si512(shifted));
+
+	return;
+}
+#endif
+
+/*
+ * Description:
+ * Enciphers only the selected columns of CSV/TSV text (--csv --columns).
+ *   Blocks of IFILE are shifted whole into a second buffer by the vector
+ *   table lookup, then scanned 64 bytes at a time: bitmasks of delimiters,
+ *   quotes and newlines are built with vector compares, the quoted bytes
+ *   are the prefix XOR of the quote bits (carried from one 64 bytes to the
+ *   next, so a doubled quote toggles twice and stays inside), and the
+ *   delimiters and newlines outside quotes give the field boundaries. The
+ *   selected fields' bytes form a mask under which the shifted bytes are
+ *   blended back, so nothing is split into lines or fields. Quoted fields
+ *   may span lines. With --header the first record is left as it is.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void encipherCsvColumns(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+	if( ciphopts->csv_columns.empty() ) {
+		throw std::invalid_argument("\nThe --csv mode needs the --columns to encipher.\n");
+	}
+
+	const string structural{ciphopts->csv_delimiter, CSV_QUOTE, '\n', '\r'};
+	const ByteTransform transform = compileInPlaceTransform(ciphopts, structural, "CSV");
+	const string fulloname = ciphopts->use_default_oname ? ciphopts->infilename + ".ciph" : ciphopts->outfilename;
+	std::ifstream ifile(ifilepath, std::ios::binary);
+	std::ofstream ofile(fsys::path(fulloname), std::ios::binary | std::ios::trunc);
+
+#if defined(__x86_64__)
+	static const bool has_avx2   = __builtin_cpu_supports("avx2");
+	static const bool has_avx512 = __builtin_cpu_supports("avx512bw");
+#endif
+
+	// column numbers are 1-based; selected[field] for 0-based fields
+	std::vector<bool> selected;
+	for(size_t column : ciphopts->csv_columns) {
+		selected.resize(std::max(selected.size(), column), false);
+		selected[column - 1] = true;
+	}
+
+	std::vector<char> text(CSV_BLOCK_BYTES), shifted(CSV_BLOCK_BYTES);
+	uint64_t quoted_carry = 0;   // all ones while inside quotes
+	size_t field = 0;
+	uint64_t records = 0;
+	bool in_header = ciphopts->csv_header;
+	char last_byte = '\n';
+
+	while( ifile.read(text.data(), static_cast<std::streamsize>(text.size())) or (ifile.gcount() > 0) ) {
+		const size_t nread = static_cast<size_t>(ifile.gcount());
+		// the last 64 bytes are padded with zeros, which are never structural
+		const size_t padded = (nread + 63) / 64 * 64;
+		std::fill(text.begin() + static_cast<std::ptrdiff_t>(nread), text.begin() + static_cast<std::ptrdiff_t>(padded), '\0');
+		applyTransform(transform, text.data(), padded, shifted.data());
+
+		for(size_t base = 0; base < padded; base += 64) {
+			uint64_t delims, quotes, newlines;
+#if defined(__x86_64__)
+			if( has_avx2 ) {
+				csvMasksAVX2(text.data() + base, ciphopts->csv_delimiter, &delims, &quotes, &newlines);
+			}
+			else {
+				csvMasksScalar(text.data() + base, ciphopts->csv_delimiter, &delims, &quotes, &newlines);
+			}
+#else
+			csvMasksScalar(text.data() + base, ciphopts->csv_delimiter, &delims, &quotes, &newlines);
+#endif
+			const uint64_t quoted = prefixXor(quotes) ^ quoted_carry;
+			quoted_carry = ( quoted >> 63 ) ? ~0ULL : 0;
+			uint64_t boundaries = (delims | newlines) & ~quoted;
+
+			// bytes of selected fields, boundary by boundary
+			uint64_t keep = 0;
+			size_t start = 0;
+			while( true ) {
+				const size_t end = ( boundaries == 0 ) ? 64 : static_cast<size_t>(std::countr_zero(boundaries)) + 1;
+				if( (end > start) and (field < selected.size()) and selected[field] and (not in_header) ) {
+					keep |= ( end - start == 64 ) ? ~0ULL : (((1ULL << (end - start)) - 1) << start);
+				}
+				if( boundaries == 0 ) {
+					break;
+				}
+				if( (newlines >> (end - 1)) & 1 ) {
+					field = 0;
+					in_header = false;
+					++records;
+				}
+				else {
+					++field;
+				}
+				start = end;
+				boundaries &= boundaries - 1;
+			}
+
+#if defined(__x86_64__)
+			if( has_avx512 ) {
+				blendMaskedAVX512(shifted.data() + base, keep, text.data() + base);
+				continue;
+			}
+#endif
+			blendMaskedScalar(shifted.data() + base, keep, text.data() + base);
+		}
+
+		ofile.write(text.data(), static_cast<std::streamsize>(nread));
+		ciphopts->nbytes_file += nread;
+		last_byte = text[nread - 1];
+	}
+	records += ( last_byte != '\n' ) ? 1 : 0;
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Enciphered {:d} selected columns of {:d} records.", ciphopts->csv_columns.size(), records) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Helpers for encipherJsonStrings: bitmasks of the quotes, backslashes,
+ *   'u' characters and structural characters ({ } [ ] : ,) of 64 bytes, and
+ *   the mask of the characters escaped by a backslash. A run of backslashes
+ *   escapes the character after it when the run has odd length; the runs
+ *   are told apart by the parity of their start, with one add carrying each
+ *   run to its end (carry holds a backslash left open at the end of the
+ *   previous 64 bytes).
+ */
+void jsonMasksScalar(const char* text, uint64_t* quotes, uint64_t* backslashes, uint64_t* unicode, uint64_t* structurals) noexcept
+{
+	*quotes = *backslashes = *unicode = *structurals = 0;
+	for(size_t n = 0; n < 64; ++n) {
+		const char folded = static_cast<char>(text[n] | 0x20);
+		*quotes      |= static_cast<uint64_t>( text[n] == JSON_QUOTE ) << n;
+		*backslashes |= static_cast<uint64_t>( text[n] == JSON_ESCAPE ) << n;
+		*unicode     |= static_cast<uint64_t>( text[n] == 'u' ) << n;
+		*structurals |= static_cast<uint64_t>( (folded == '{') or (folded == '}') or (text[n] == ':') or (text[n] == ',') ) << n;
+	}
+
+	return;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+void jsonMasksAVX2(const char* text, uint64_t* quotes, uint64_t* backslashes, uint64_t* unicode, uint64_t* structurals) noexcept
+{
+	const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text));
+	const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + 32));
+	// '[' and ']' fold onto '{' and '}' with the 0x20 bit set
+	const __m256i fold = _mm256_set1_epi8(0x20);
+	const __m256i lo_folded = _mm256_or_si256(lo, fold);
+	const __m256i hi_folded = _mm256_or_si256(hi, fold);
+	*quotes      = equalMaskAVX2(lo, hi, _mm256_set1_epi8(JSON_QUOTE));
+	*backslashes = equalMaskAVX2(lo, hi, _mm256_set1_epi8(JSON_ESCAPE));
+	*unicode     = equalMaskAVX2(lo, hi, _mm256_set1_epi8('u'));
+	*structurals = equalMaskAVX2(lo_folded, hi_folded, _mm256_set1_epi8('{')) |
+	               equalMaskAVX2(lo_folded, hi_folded, _mm256_set1_epi8('}')) |
+	               equalMaskAVX2(lo, hi, _mm256_set1_epi8(':')) |
+	               equalMaskAVX2(lo, hi, _mm256_set1_epi8(','));
+
+	return;
+}
+#endif
+
+uint64_t escapedMask(uint64_t backslashes, uint64_t* carry) noexcept
+{
+	const uint64_t even_bits = 0x5555555555555555ULL;
+	const uint64_t escaped_first = *carry;
+
+	backslashes &= ~escaped_first;
+	const uint64_t follows_backslash = (backslashes << 1) | escaped_first;
+	const uint64_t odd_starts = backslashes & ~even_bits & ~follows_backslash;
+	uint64_t even_starts_ends = 0;
+	*carry = __builtin_add_overflow(odd_starts, backslashes, &even_starts_ends) ? 1 : 0;
+	const uint64_t odd_ends = even_starts_ends << 1;
+
+	return( (even_bits ^ odd_ends) & follows_backslash );
+}
+
+/*
+ * Description:
+ * Enciphers only the string values of JSON text (--json), such as JSON Lines
+ *   logs: member names, numbers, literals and structure are left as they
+ *   are, as are escape sequences (\n, \", \uXXXX) inside the strings. Text is
+ *   read a block at a time and scanned 64 bytes at a time into bitmasks;
+ *   escaped quotes are removed and a prefix XOR of the remaining quotes marks
+ *   the bytes inside strings. The structural characters and quotes outside
+ *   strings are then walked in order to tell member names from values (and,
+ *   with --json-keys, the values of the selected members), and the
+ *   enciphered bytes of those strings are blended back into the block.
+ *   Memory is bounded by the block and the nesting depth.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND, std::runtime_error for
+ *   mismatched brackets or unterminated strings)
+ */
+void encipherJsonStrings(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	const ByteTransform transform = compileInPlaceTransform(ciphopts, string{JSON_QUOTE, JSON_ESCAPE}, "JSON");
+	const string fulloname = ciphopts->use_default_oname ? ciphopts->infilename + ".ciph" : ciphopts->outfilename;
+	std::ifstream ifile(ifilepath, std::ios::binary);
+	std::ofstream ofile(fsys::path(fulloname), std::ios::binary | std::ios::trunc);
+
+#if defined(__x86_64__)
+	static const bool has_avx2   = __builtin_cpu_supports("avx2");
+	static const bool has_avx512 = __builtin_cpu_supports("avx512bw");
+#endif
+
+	// member names longer than every selected key need not be kept whole
+	const vecstr& keys = ciphopts->json_keys;
+	size_t key_limit = 0;
+	for(const string& key : keys) {
+		key_limit = std::max(key_limit, key.size() + 1);
+	}
+
+	// open objects and arrays, and whether their string values are selected
+	struct JsonFrame { bool object; bool selected; };
+	std::vector<JsonFrame> frames;
+	bool expect_key = false;                 // the next string is a member name
+	bool member_selected = keys.empty();     // the current member was selected
+	auto value_selected = [&]() {
+		return( keys.empty() or ((not frames.empty()) and (frames.back().selected or (frames.back().object and member_selected))) );
+	};
+
+	std::vector<char> text(JSON_BLOCK_BYTES), shifted(JSON_BLOCK_BYTES);
+	uint64_t escape_carry = 0;   // the first byte is escaped
+	uint64_t quoted_carry = 0;   // all ones while inside a string
+	uint64_t hex_carry = 0;      // \u digits continued from the previous 64 bytes
+	bool in_key = false, in_value = false;
+	string key;
+	uint64_t nstrings = 0, nvalues = 0;
+
+	while( ifile.read(text.data(), static_cast<std::streamsize>(text.size())) or (ifile.gcount() > 0) ) {
+		const size_t nread = static_cast<size_t>(ifile.gcount());
+		// the last 64 bytes are padded with zeros, which are never structural
+		const size_t padded = (nread + 63) / 64 * 64;
+		std::fill(text.begin() + static_cast<std::ptrdiff_t>(nread), text.begin() + static_cast<std::ptrdiff_t>(padded), '\0');
+		applyTransform(transform, text.data(), padded, shifted.data());
+
+		for(size_t base = 0; base < padded; base += 64) {
+			const char* block = text.data() + base;
+			uint64_t quotes, backslashes, unicode, structurals;
+#if defined(__x86_64__)
+			if( has_avx2 ) {
+				jsonMasksAVX2(block, &quotes, &backslashes, &unicode, &structurals);
+			}
+			else {
+				jsonMasksScalar(block, &quotes, &backslashes, &unicode, &structurals);
+			}
+#else
+			jsonMasksScalar(block, &quotes, &backslashes, &unicode, &structurals);
+#endif
+			const uint64_t escaped = escapedMask(backslashes, &escape_carry);
+			quotes &= ~escaped;
+			const uint64_t quoted = prefixXor(quotes) ^ quoted_carry;
+			quoted_carry = ( quoted >> 63 ) ? ~0ULL : 0;
+
+			// escape sequences keep their plain bytes: the backslash, the
+			//   escaped character and the four hex digits after \u
+			uint64_t fixed = (backslashes & ~escaped) | escaped | hex_carry;
+			hex_carry = 0;
+			for(uint64_t hex = escaped & unicode & quoted; hex != 0; hex &= hex - 1) {
+				const unsigned pos = static_cast<unsigned>(std::countr_zero(hex));
+				fixed     |= ( pos < 63 ) ? (0xFULL << (pos + 1)) : 0;
+				hex_carry |= ( pos > 59 ) ? (0xFULL >> (63 - pos)) : 0;
+			}
+
+			// quotes and structural characters outside strings, in order
+			uint64_t keep = 0;
+			size_t start = 0;
+			for(uint64_t tokens = (structurals & ~quoted) | quotes; tokens != 0; tokens &= tokens - 1) {
+				const size_t pos = static_cast<size_t>(std::countr_zero(tokens));
+				const char chr = block[pos];
+				if( chr == JSON_QUOTE ) {
+					if( (quoted >> pos) & 1 ) {
+						in_key = expect_key;
+						in_value = (not in_key) and value_selected();
+						expect_key = false;
+						key.clear();
+						start = pos + 1;
+						continue;
+					}
+					if( in_value and (pos > start) ) {
+						keep |= ((1ULL << (pos - start)) - 1) << start;
+					}
+					if( in_key ) {
+						key.append(block + start, std::min(pos - start, key_limit - std::min(key_limit, key.size())));
+						member_selected = keys.empty() or (std::find(keys.begin(), keys.end(), key) != keys.end());
+					}
+					else {
+						++nstrings;
+						nvalues += in_value ? 1 : 0;
+					}
+					in_key = in_value = false;
+					continue;
+				}
+
+				const char folded = static_cast<char>(chr | 0x20);
+				if( folded == '{' ) {
+					frames.push_back({chr == '{', value_selected()});
+					expect_key = frames.back().object;
+				}
+				else if( folded == '}' ) {
+					if( frames.empty() or (frames.back().object != (chr == '}')) ) {
+						throw std::runtime_error(std::format("\nMalformed JSON: unmatched {} at byte {:d} of {}.\n",
+							chr, ciphopts->nbytes_file + base + pos, ciphopts->infilename));
+					}
+					frames.pop_back();
+					expect_key = false;
+				}
+				else {
+					// ',' starts the next member of an object; ':' its value
+					expect_key = (chr == ',') and (not frames.empty()) and frames.back().object;
+				}
+			}
+			// a string still open runs on into the next 64 bytes
+			if( quoted >> 63 ) {
+				if( in_value and (start < 64) ) {
+					keep |= ~0ULL << start;
+				}
+				if( in_key ) {
+					key.append(block + start, std::min(64 - start, key_limit - std::min(key_limit, key.size())));
+				}
+			}
+			keep &= ~fixed;
+
+#if defined(__x86_64__)
+			if( has_avx512 ) {
+				blendMaskedAVX512(shifted.data() + base, keep, text.data() + base);
+				continue;
+			}
+#endif
+			blendMaskedScalar(shifted.data() + base, keep, text.data() + base);
+		}
+
+		ofile.write(text.data(), static_cast<std::streamsize>(nread));
+		ciphopts->nbytes_file += nread;
+	}
+	if( quoted_carry or (not frames.empty()) ) {
+		throw std::runtime_error(std::format("\nMalformed JSON: unterminated {} at end of {}.\n",
+			quoted_carry ? "string" : "object or array", ciphopts->infilename));
+	}
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Enciphered {:d} of {:d} string values.", nvalues, nstrings) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+// set by SIGINT/SIGTERM to end the long-running modes (--follow, --watch)
+//   once the work in hand is written
+volatile sig_atomic_t stop_requested = 0;
+
+void requestStop(int) noexcept
+{
+	stop_requested = 1;
+
+	return;
+}
+
+/*
+ * Description:
+ * Enciphers IFILE as it grows (--follow), like tail -F: appended bytes are
+ *   read from the last offset, enciphered and appended to OFILE, so each
+ *   wake-up costs a read, a write and a small state update, never a rescan.
+ *   Wake-ups come from inotify (IFILE modified, moved or deleted, or a file
+ *   created in its directory), with a stat check every --poll-ms that also
+ *   serves as the only wake-up where inotify is unavailable. A new file at
+ *   the path (rotation) is followed from its start once the old one is
+ *   drained; a file cut short (copytruncate) is followed from its start.
+ *   The state file records the input file's identity and both offsets, at
+ *   most once per poll interval and only after OFILE has been synced, so the
+ *   recorded output offset is always on disk; a restart truncates OFILE to
+ *   the recorded offset and goes on from there (the bytes enciphered since
+ *   the last record are enciphered again). Runs until SIGINT or SIGTERM.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND or failed reads/writes)
+ */
+void followFile(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	const ByteTransform transform = compileTransform(ciphopts);
+	const fsys::path ofilepath( ciphopts->use_default_oname ? ciphopts->infilename + ".ciph" : ciphopts->outfilename );
+	const fsys::path statepath( ciphopts->follow_state.empty() ? ofilepath.string() + FOLLOW_STATE_EXT : ciphopts->follow_state );
+	const int poll_ms = ( ciphopts->follow_poll_ms > 0 ) ? ciphopts->follow_poll_ms : FOLLOW_POLL_MS;
+
+	int in_fd = ::open(ifilepath.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat in_st;
+	if( (in_fd < 0) or (::fstat(in_fd, &in_st) != 0) ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to open input file.", ifilepath, ec);
+	}
+
+	// resume when the state file matches OFILE; the input offset only
+	//   applies to the same file, not yet cut short (otherwise IFILE was
+	//   rotated or truncated meanwhile and is followed from its start)
+	uint64_t in_offset = 0, out_offset = 0;
+	bool resumed = false;
+	{
+		std::ifstream sfile(statepath);
+		string magic;
+		uint64_t dev = 0, ino = 0, in_saved = 0, out_saved = 0;
+		struct stat out_st;
+		if( (sfile >> magic >> dev >> ino >> in_saved >> out_saved) and (magic == "shiftcipher-follow") and
+		    (::stat(ofilepath.c_str(), &out_st) == 0) and (static_cast<uint64_t>(out_st.st_size) >= out_saved) )
+		{
+			resumed = true;
+			out_offset = out_saved;
+			if( (dev == static_cast<uint64_t>(in_st.st_dev)) and (ino == static_cast<uint64_t>(in_st.st_ino)) and
+			    (in_saved <= static_cast<uint64_t>(in_st.st_size)) )
+			{
+				in_offset = in_saved;
+			}
+		}
+	}
+
+	// bytes written after the last state update are enciphered again
+	int out_fd = ::open(ofilepath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	int state_fd = ::open(statepath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	if( (out_fd < 0) or (state_fd < 0) or (::ftruncate(out_fd, static_cast<off_t>(out_offset)) != 0) or
+	    (::lseek(out_fd, static_cast<off_t>(out_offset), SEEK_SET) < 0) or (::lseek(in_fd, static_cast<off_t>(in_offset), SEEK_SET) < 0) )
+	{
+		std::error_code ec(errno, std::generic_category());
+		::close(in_fd);
+		if( out_fd >= 0 ) { ::close(out_fd); }
+		if( state_fd >= 0 ) { ::close(state_fd); }
+		throw fsys::filesystem_error("Unable to open output or state file.", ( out_fd < 0 ) ? ofilepath : statepath, ec);
+	}
+
+	// fixed-width record, rewritten in place; OFILE is synced first so the
+	//   recorded offset never points past what reached the disk
+	auto last_save = std::chrono::steady_clock::now();
+	bool unsaved = false;
+	auto saveState = [&]() {
+		if( ::fdatasync(out_fd) != 0 ) {
+			std::error_code ec(errno, std::generic_category());
+			throw fsys::filesystem_error("Unable to flush output file.", ofilepath, ec);
+		}
+		const string record = std::format("shiftcipher-follow {:20d} {:20d} {:20d} {:20d}\n",
+			static_cast<uint64_t>(in_st.st_dev), static_cast<uint64_t>(in_st.st_ino), in_offset, out_offset);
+		if( ::pwrite(state_fd, record.data(), record.size(), 0) != static_cast<ssize_t>(record.size()) ) {
+			std::error_code ec(errno, std::generic_category());
+			throw fsys::filesystem_error("Unable to write state file.", statepath, ec);
+		}
+		last_save = std::chrono::steady_clock::now();
+		unsaved = false;
+	};
+
+	std::vector<char> in_buffer(FOLLOW_BUFFER_BYTES), out_buffer(FOLLOW_BUFFER_BYTES);
+	uint64_t nbytes = 0, nrotations = 0;
+	auto encipherAppended = [&]() {
+		size_t nread = 0;
+		bool appended = false;
+		while( (nread = readFull(in_fd, in_buffer.data(), in_buffer.size(), ifilepath)) > 0 ) {
+			const size_t nout = applyTransform(transform, in_buffer.data(), nread, out_buffer.data());
+			writeFull(out_fd, out_buffer.data(), nout, ofilepath);
+			in_offset += nread;
+			out_offset += nout;
+			nbytes += nread;
+			appended = true;
+		}
+		// one sync and state update per poll interval, however often IFILE grows
+		unsaved = unsaved or appended;
+		if( unsaved and (std::chrono::steady_clock::now() - last_save >= std::chrono::milliseconds(poll_ms)) ) {
+			saveState();
+		}
+	};
+
+	// inotify watches on IFILE and on its directory (for the file that
+	//   replaces it); without them the stat checks are the wake-ups
+	int notify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	const fsys::path dirpath = ifilepath.has_parent_path() ? ifilepath.parent_path() : fsys::path(".");
+	if( (notify_fd >= 0) and
+	    ((::inotify_add_watch(notify_fd, ifilepath.c_str(), IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF) < 0) or
+	     (::inotify_add_watch(notify_fd, dirpath.c_str(), IN_CREATE | IN_MOVED_TO) < 0)) )
+	{
+		::close(notify_fd);
+		notify_fd = -1;
+	}
+
+	stop_requested = 0;
+	struct sigaction action{}, old_int{}, old_term{};
+	action.sa_handler = requestStop;
+	sigemptyset(&action.sa_mask);
+	::sigaction(SIGINT, &action, &old_int);
+	::sigaction(SIGTERM, &action, &old_term);
+
+	try {
+		saveState();
+		while( not stop_requested ) {
+			encipherAppended();
+
+			// a new file at the path: finish the old one, then start the new
+			struct stat path_st;
+			if( (::stat(ifilepath.c_str(), &path_st) == 0) and ((path_st.st_dev != in_st.st_dev) or (path_st.st_ino != in_st.st_ino)) ) {
+				int new_fd = ::open(ifilepath.c_str(), O_RDONLY | O_CLOEXEC);
+				if( (new_fd >= 0) and (::fstat(new_fd, &path_st) == 0) ) {
+					encipherAppended();
+					::close(in_fd);
+					in_fd = new_fd;
+					in_st = path_st;
+					in_offset = 0;
+					++nrotations;
+					if( notify_fd >= 0 ) {
+						::inotify_add_watch(notify_fd, ifilepath.c_str(), IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+					}
+					saveState();
+					continue;
+				}
+				if( new_fd >= 0 ) {
+					::close(new_fd);
+				}
+			}
+			// the same file cut short: start it again
+			else if( (::fstat(in_fd, &path_st) == 0) and (static_cast<uint64_t>(path_st.st_size) < in_offset) ) {
+				::lseek(in_fd, 0, SEEK_SET);
+				in_offset = 0;
+				saveState();
+				continue;
+			}
+
+			// sleep until IFILE or its directory changes, a signal, or the next check
+			if( notify_fd >= 0 ) {
+				struct pollfd pfd{notify_fd, POLLIN, 0};
+				if( ::poll(&pfd, 1, poll_ms) > 0 ) {
+					// the events only wake the loop, their contents are not needed
+					alignas(struct inotify_event) char events[4096];
+					while( ::read(notify_fd, events, sizeof(events)) > 0 ) {}
+				}
+			}
+			else {
+				::poll(nullptr, 0, poll_ms);
+			}
+		}
+		saveState();
+		::fdatasync(state_fd);
+	}
+	catch( ... ) {
+		::sigaction(SIGINT, &old_int, nullptr);
+		::sigaction(SIGTERM, &old_term, nullptr);
+		::close(in_fd);
+		::close(out_fd);
+		::close(state_fd);
+		if( notify_fd >= 0 ) { ::close(notify_fd); }
+		throw;
+	}
+
+	::sigaction(SIGINT, &old_int, nullptr);
+	::sigaction(SIGTERM, &old_term, nullptr);
+	::close(in_fd);
+	::close(out_fd);
+	::close(state_fd);
+	if( notify_fd >= 0 ) { ::close(notify_fd); }
+	ciphopts->nbytes_file = nbytes;
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Followed {}: enciphered {:d} bytes{}, {:d} rotations; state in {}.",
+		                    ifilepath.string(), nbytes, resumed ? " since the restart" : "", nrotations, statepath.string()) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Enciphers one file for --watch into outdir: the output is written to a
+ *   hidden temporary file, synced and renamed to NAME.ciph, so readers of
+ *   outdir only ever see complete files.
+ *
+ * Input:
+ * transform -> compiled transform
+ * ipath -> file to encipher
+ * outdir -> directory of the enciphered file
+ * in_buffer, out_buffer -> the worker's read and transform buffers
+ * nbytes -> incremented by the bytes read
+ *
+ * Output:
+ * None (throws fsys::filesystem_error for failed reads, writes or renames;
+ *   the temporary file is removed)
+ */
+void encipherWatchedFile(const ByteTransform& transform, const fsys::path& ipath, const fsys::path& outdir,
+                         std::vector<char>* in_buffer, std::vector<char>* out_buffer, uint64_t* nbytes)
+{
+	const string name = ipath.filename().string();
+	const fsys::path opath = outdir / (name + ".ciph");
+	const fsys::path temppath = outdir / ("." + name + ".ciph" + WATCH_TEMP_EXT);
+
+	int in_fd = ::open(ipath.c_str(), O_RDONLY | O_CLOEXEC);
+	if( in_fd < 0 ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to open input file.", ipath, ec);
+	}
+	int out_fd = ::open(temppath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if( out_fd < 0 ) {
+		std::error_code ec(errno, std::generic_category());
+		::close(in_fd);
+		throw fsys::filesystem_error("Unable to open output file.", temppath, ec);
+	}
+
+	try {
+		size_t nread = 0;
+		while( (nread = readFull(in_fd, in_buffer->data(), in_buffer->size(), ipath)) > 0 ) {
+			const size_t nout = applyTransform(transform, in_buffer->data(), nread, out_buffer->data());
+			writeFull(out_fd, out_buffer->data(), nout, temppath);
+			*nbytes += nread;
+		}
+		if( ::fdatasync(out_fd) != 0 ) {
+			std::error_code ec(errno, std::generic_category());
+			throw fsys::filesystem_error("Unable to write output.", temppath, ec);
+		}
+		fsys::rename(temppath, opath);
+	}
+	catch( ... ) {
+		::close(in_fd);
+		::close(out_fd);
+		::unlink(temppath.c_str());
+		throw;
+	}
+	::close(in_fd);
+	::close(out_fd);
+
+	return;
+}
+
+/*
+ * Description:
+ * Enciphers the files that land in a directory (--watch DIR --out DIR), a
+ *   long-running replacement for polling the directory. inotify reports
+ *   each file as it is closed after writing or moved in; the names go to a
+ *   bounded queue served by --threads workers (the watcher waits while the
+ *   queue is full), and a name already queued is not queued twice. A file
+ *   that lands again while it is enciphered is queued again once that job
+ *   ends, so no two jobs ever share its temporary output. Hidden
+ *   files (names starting with '.', as uploads in progress often are) are
+ *   skipped. The directory is listed once at start, and again only if the
+ *   kernel's event queue overflowed, for files whose output is missing or
+ *   older. Runs until SIGINT or SIGTERM, then finishes the queued files.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for DIRECTORY NOT FOUND or if inotify is
+ *   unavailable; failures of single files are reported and skipped)
+ */
+void watchDirectory(CipherOptions* ciphopts)
+{
+	const fsys::path watchdir( ciphopts->watch_dir );
+	if( not fsys::is_directory(watchdir) ) {
+		string errmsg{"Watch directory not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, watchdir, ec);
+	}
+	if( ciphopts->out_dir.empty() ) {
+		throw std::invalid_argument("\nThe --watch mode needs the --out directory for the enciphered files.\n");
+	}
+	const fsys::path outdir( ciphopts->out_dir );
+	fsys::create_directories(outdir);
+	if( fsys::equivalent(watchdir, outdir) ) {
+		throw std::invalid_argument("\nThe --watch and --out directories must differ.\n");
+	}
+
+	const ByteTransform transform = compileTransform(ciphopts);
+
+	int notify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if( (notify_fd < 0) or (::inotify_add_watch(notify_fd, watchdir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0) ) {
+		std::error_code ec(errno, std::generic_category());
+		if( notify_fd >= 0 ) { ::close(notify_fd); }
+		throw fsys::filesystem_error("Unable to watch directory.", watchdir, ec);
+	}
+
+	// bounded queue of file names shared with the workers, the names being
+	//   enciphered, and those of them that landed again meanwhile
+	std::mutex queue_mutex;
+	std::condition_variable queue_cv, space_cv;
+	std::deque<string> queue;
+	std::set<string> queued, active, again;
+	bool closing = false;
+
+	std::mutex report_mutex;
+	std::atomic<uint64_t> nfiles{0}, nfailed{0}, nbytes{0};
+
+	auto enqueue = [&](const string& name) {
+		if( name.empty() or (name[0] == '.') ) {
+			return;
+		}
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		space_cv.wait(lock, [&]() { return( queue.size() < WATCH_QUEUE_LIMIT ); });
+		if( queued.count(name) > 0 ) {
+			return;
+		}
+		if( active.count(name) > 0 ) {
+			again.insert(name);
+			return;
+		}
+		queue.push_back(name);
+		queued.insert(name);
+		queue_cv.notify_one();
+	};
+
+	// the files whose output is missing or older than them
+	auto enqueueStale = [&]() {
+		std::error_code ec;
+		for(const fsys::directory_entry& entry : fsys::directory_iterator(watchdir, ec)) {
+			const string name = entry.path().filename().string();
+			std::error_code out_ec;
+			const fsys::file_time_type out_time = fsys::last_write_time(outdir / (name + ".ciph"), out_ec);
+			if( entry.is_regular_file(ec) and (out_ec or (out_time < entry.last_write_time(ec))) ) {
+				enqueue(name);
+			}
+		}
+	};
+
+	auto watch_worker = [&]() {
+		std::vector<char> in_buffer(WATCH_BUFFER_BYTES), out_buffer(WATCH_BUFFER_BYTES);
+		while( true ) {
+			string name;
+			{
+				std::unique_lock<std::mutex> lock(queue_mutex);
+				queue_cv.wait(lock, [&]() { return( closing or (not queue.empty()) ); });
+				if( queue.empty() ) {
+					break;
+				}
+				name = std::move(queue.front());
+				queue.pop_front();
+				queued.erase(name);
+				active.insert(name);
+				space_cv.notify_one();
+			}
+
+			uint64_t file_bytes = 0;
+			try {
+				encipherWatchedFile(transform, watchdir / name, outdir, &in_buffer, &out_buffer, &file_bytes);
+				++nfiles;
+				nbytes += file_bytes;
+				if( not ciphopts->display_log_info ) {
+					std::lock_guard<std::mutex> guard(report_mutex);
+					cout << std::format("{} -> {}", (watchdir / name).string(), (outdir / (name + ".ciph")).string()) << endl;
+				}
+			}
+			catch( const std::exception& error ) {
+				++nfailed;
+				std::lock_guard<std::mutex> guard(report_mutex);
+				std::cerr << std::format("Unable to encipher {}: {}", (watchdir / name).string(), error.what()) << endl;
+			}
+
+			// written again while this copy was enciphered: queued again (past
+			//   the limit if need be, a worker must not wait for itself)
+			std::lock_guard<std::mutex> guard(queue_mutex);
+			active.erase(name);
+			if( again.erase(name) > 0 ) {
+				queue.push_back(name);
+				queued.insert(name);
+				queue_cv.notify_one();
+			}
+		}
+	};
+
+	// SIGINT/SIGTERM are blocked outside ppoll, so the workers never take
+	//   them and a signal cannot slip in between the check and the wait
+	stop_requested = 0;
+	struct sigaction action{}, old_int{}, old_term{};
+	action.sa_handler = requestStop;
+	sigemptyset(&action.sa_mask);
+	::sigaction(SIGINT, &action, &old_int);
+	::sigaction(SIGTERM, &action, &old_term);
+	sigset_t stop_signals, wait_mask;
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGINT);
+	sigaddset(&stop_signals, SIGTERM);
+	::pthread_sigmask(SIG_BLOCK, &stop_signals, &wait_mask);
+	sigdelset(&wait_mask, SIGINT);
+	sigdelset(&wait_mask, SIGTERM);
+
+	const unsigned nworkers = resolveThreadCount(ciphopts);
+	std::vector<std::thread> workers;
+	for(unsigned n = 0; n < nworkers; ++n) {
+		workers.emplace_back(watch_worker);
+	}
+
+	enqueueStale();
+	alignas(struct inotify_event) char events[64 * 1024];
+	while( not stop_requested ) {
+		struct pollfd pfd{notify_fd, POLLIN, 0};
+		if( ::ppoll(&pfd, 1, nullptr, &wait_mask) <= 0 ) {
+			continue;
+		}
+		ssize_t nread = 0;
+		while( (nread = ::read(notify_fd, events, sizeof(events))) > 0 ) {
+			for(ssize_t pos = 0; pos < nread; ) {
+				const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(events + pos);
+				if( event->mask & IN_Q_OVERFLOW ) {
+					enqueueStale();
+				}
+				else if( (event->len > 0) and (not (event->mask & IN_ISDIR)) ) {
+					enqueue(string(event->name));
+				}
+				pos += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(queue_mutex);
+		closing = true;
+	}
+	queue_cv.notify_all();
+	for(std::thread& worker : workers) {
+		worker.join();
+	}
+	::close(notify_fd);
+	::pthread_sigmask(SIG_UNBLOCK, &stop_signals, nullptr);
+	::sigaction(SIGINT, &old_int, nullptr);
+	::sigaction(SIGTERM, &old_term, nullptr);
+	ciphopts->nbytes_file = nbytes;
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Watched {}: enciphered {:d} files ({:d} bytes) into {}, {:d} failed.",
+		                    watchdir.string(), nfiles.load(), nbytes.load(), outdir.string(), nfailed.load()) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Helpers for the shared-memory ring: sleep on a slot's sequence while it
+ *   still holds the observed value (a process-shared futex, so a change and
+ *   its wake-up cannot cross), and store a new sequence, waking the
+ *   sleepers only if there are any, so a busy ring makes no system calls.
+ *   wakeShmSlot wakes the sleepers without a change (the ring was closed).
+ */
+void waitShmSlot(ShmSlot* slot, uint32_t observed, int timeout_ms)
+{
+	static_assert( std::atomic<uint32_t>::is_always_lock_free and (sizeof(std::atomic<uint32_t>) == sizeof(uint32_t)) );
+
+	for(int n = 0; n < SHM_SPIN_CHECKS; ++n) {
+		if( slot->seq.load(std::memory_order_acquire) != observed ) {
+			return;
+		}
+#if defined(__x86_64__)
+		_mm_pause();
+#endif
+	}
+
+	struct timespec timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+	slot->waiters.fetch_add(1);
+	if( slot->seq.load() == observed ) {
+		::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&slot->seq), FUTEX_WAIT, observed, ( timeout_ms >= 0 ) ? &timeout : nullptr, nullptr, 0);
+	}
+	slot->waiters.fetch_sub(1);
+
+	return;
+}
+
+void publishShmSlot(ShmSlot* slot, uint32_t seq)
+{
+	slot->seq.store(seq);
+	wakeShmSlot(slot);
+
+	return;
+}
+
+void wakeShmSlot(ShmSlot* slot)
+{
+	if( slot->waiters.load() > 0 ) {
+		::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&slot->seq), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Serves a shared-memory ring (--serve-shm SOCKET) so co-located processes
+ *   can have data enciphered without linking anything or copying it through
+ *   a socket. The ring is a sealed memfd (see ShmRingHeader): SOCKET, a UNIX
+ *   socket, hands its descriptor to each producer that connects, once. Any
+ *   number of producers take tickets and fill slots; the service takes the
+ *   slots in ticket order, enciphers each in place and marks it done, and a
+ *   producer frees its slot after reading the result. A full ring makes the
+ *   next producer wait for its slot (backpressure). Waits spin briefly and
+ *   then sleep on the slot's sequence with a futex. A producer that dies
+ *   holding a ticket stalls the ring behind it. Runs until SIGINT or SIGTERM;
+ *   the ring is then marked closed and every sleeper woken, so producers
+ *   still in flight fail instead of waiting forever.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception if the ring or the socket cannot be set up)
+ */
+void serveSharedRing(CipherOptions* ciphopts)
+{
+	const ByteTransform transform = compileTransform(ciphopts);
+	const fsys::path sockpath( ciphopts->shm_socket );
+
+	// the ring: header, slot headers, then the data areas
+	const size_t slots_offset = (sizeof(ShmRingHeader) + 63) / 64 * 64;
+	const size_t data_offset = slots_offset + (SHM_SLOT_COUNT * sizeof(ShmSlot) + 63) / 64 * 64;
+	const size_t ring_bytes = data_offset + static_cast<size_t>(SHM_SLOT_COUNT) * SHM_SLOT_BYTES;
+
+	int ring_fd = ::memfd_create("shiftcipher-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if( (ring_fd < 0) or (::ftruncate(ring_fd, static_cast<off_t>(ring_bytes)) != 0) or
+	    (::fcntl(ring_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) )
+	{
+		std::error_code ec(errno, std::generic_category());
+		if( ring_fd >= 0 ) { ::close(ring_fd); }
+		throw fsys::filesystem_error("Unable to create the shared-memory ring.", sockpath, ec);
+	}
+	void* mapping = ::mmap(nullptr, ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+	if( mapping == MAP_FAILED ) {
+		std::error_code ec(errno, std::generic_category());
+		::close(ring_fd);
+		throw fsys::filesystem_error("Unable to map the shared-memory ring.", sockpath, ec);
+	}
+	char* ring = static_cast<char*>(mapping);
+	ShmRingHeader* header = new (ring) ShmRingHeader{};
+	std::memcpy(header->magic, SHM_RING_MAGIC, sizeof(header->magic));
+	header->version = SHM_RING_VERSION;
+	header->slot_count = SHM_SLOT_COUNT;
+	header->slot_bytes = SHM_SLOT_BYTES;
+	header->next_ticket.store(0);
+	header->closed.store(0);
+	ShmSlot* slots = reinterpret_cast<ShmSlot*>(ring + slots_offset);
+	for(uint32_t n = 0; n < SHM_SLOT_COUNT; ++n) {
+		new (&slots[n]) ShmSlot{};
+		slots[n].seq.store(n);
+	}
+
+	// the socket handing out the ring (a stale socket file is replaced)
+	struct sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if( sockpath.string().size() >= sizeof(address.sun_path) ) {
+		::munmap(mapping, ring_bytes);
+		::close(ring_fd);
+		throw std::invalid_argument(std::format("\nSocket path too long ({}).\n", sockpath.string()));
+	}
+	std::memcpy(address.sun_path, sockpath.c_str(), sockpath.string().size());
+	struct stat sock_st;
+	if( (::lstat(sockpath.c_str(), &sock_st) == 0) and S_ISSOCK(sock_st.st_mode) ) {
+		::unlink(sockpath.c_str());
+	}
+	int listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if( (listen_fd < 0) or (::bind(listen_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) or
+	    (::listen(listen_fd, 16) != 0) )
+	{
+		std::error_code ec(errno, std::generic_category());
+		if( listen_fd >= 0 ) { ::close(listen_fd); }
+		::munmap(mapping, ring_bytes);
+		::close(ring_fd);
+		throw fsys::filesystem_error("Unable to listen on socket.", sockpath, ec);
+	}
+
+	stop_requested = 0;
+	struct sigaction action{}, old_int{}, old_term{};
+	action.sa_handler = requestStop;
+	sigemptyset(&action.sa_mask);
+	::sigaction(SIGINT, &action, &old_int);
+	::sigaction(SIGTERM, &action, &old_term);
+
+	// each connection gets the ring descriptor and is closed
+	std::atomic<uint64_t> nproducers{0};
+	std::thread handover([&]() {
+		while( not stop_requested ) {
+			int conn_fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+			if( conn_fd < 0 ) {
+				if( (errno == EINTR) or (errno == ECONNABORTED) ) {
+					continue;
+				}
+				break;
+			}
+			char byte = 'R';
+			struct iovec payload{&byte, 1};
+			alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+			struct msghdr message{};
+			message.msg_iov = &payload;
+			message.msg_iovlen = 1;
+			message.msg_control = control;
+			message.msg_controllen = sizeof(control);
+			struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+			std::memcpy(CMSG_DATA(cmsg), &ring_fd, sizeof(int));
+			if( ::sendmsg(conn_fd, &message, MSG_NOSIGNAL) == 1 ) {
+				++nproducers;
+			}
+			::close(conn_fd);
+		}
+	});
+
+	// the service loop: slots in ticket order, enciphered in place
+	uint64_t ticket = 0, nbytes = 0;
+	while( not stop_requested ) {
+		ShmSlot& slot = slots[ticket % SHM_SLOT_COUNT];
+		const uint32_t filled = static_cast<uint32_t>(ticket + 1);
+		const uint32_t seq = slot.seq.load(std::memory_order_acquire);
+		if( seq != filled ) {
+			waitShmSlot(&slot, seq, SHM_WAIT_MS);
+			continue;
+		}
+		char* data = ring + data_offset + (ticket % SHM_SLOT_COUNT) * SHM_SLOT_BYTES;
+		const size_t length = std::min<size_t>(slot.length, SHM_SLOT_BYTES);
+		slot.length = static_cast<uint32_t>(applyTransform(transform, data, length, data));
+		nbytes += length;
+		publishShmSlot(&slot, filled + 1);
+		++ticket;
+	}
+
+	header->closed.store(1);
+	for(uint32_t n = 0; n < SHM_SLOT_COUNT; ++n) {
+		wakeShmSlot(&slots[n]);
+	}
+	::shutdown(listen_fd, SHUT_RDWR);
+	handover.join();
+	::close(listen_fd);
+	::unlink(sockpath.c_str());
+	::munmap(mapping, ring_bytes);
+	::close(ring_fd);
+	::sigaction(SIGINT, &old_int, nullptr);
+	::sigaction(SIGTERM, &old_term, nullptr);
+	ciphopts->nbytes_file = nbytes;
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Served {:d} slots ({:d} bytes) for {:d} producers through {}.",
+		                    ticket, nbytes, nproducers.load(), sockpath.string()) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Enciphers IFILE through the ring of a --serve-shm service (--shm-client
+ *   SOCKET), as any producer would: the ring's memfd is received over SOCKET
+ *   and mapped, each slot-sized chunk of IFILE is copied into the slot of a
+ *   new ticket, and the enciphered slots are written to OFILE in order. Up
+ *   to SHM_CLIENT_DEPTH slots are kept in flight; while waiting for a free
+ *   slot the client also collects its own finished ones, which another
+ *   lap's ticket may be waiting for. Waits are bounded by SHM_WAIT_MS, so a
+ *   service that stopped (the ring marked closed) ends the client with an
+ *   error.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND, or if the service cannot be
+ *   reached or stops before IFILE is enciphered)
+ */
+void encipherThroughRing(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+	const fsys::path sockpath( ciphopts->shm_socket );
+	const fsys::path ofilepath( ciphopts->use_default_oname ? ciphopts->infilename + ".ciph" : ciphopts->outfilename );
+
+	// receive the ring descriptor
+	struct sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if( sockpath.string().size() >= sizeof(address.sun_path) ) {
+		throw std::invalid_argument(std::format("\nSocket path too long ({}).\n", sockpath.string()));
+	}
+	std::memcpy(address.sun_path, sockpath.c_str(), sockpath.string().size());
+	int conn_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	int ring_fd = -1;
+	if( (conn_fd >= 0) and (::connect(conn_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0) ) {
+		char byte = 0;
+		struct iovec payload{&byte, 1};
+		alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+		struct msghdr message{};
+		message.msg_iov = &payload;
+		message.msg_iovlen = 1;
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+		if( ::recvmsg(conn_fd, &message, MSG_CMSG_CLOEXEC) == 1 ) {
+			struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+			if( (cmsg != nullptr) and (cmsg->cmsg_level == SOL_SOCKET) and (cmsg->cmsg_type == SCM_RIGHTS) ) {
+				std::memcpy(&ring_fd, CMSG_DATA(cmsg), sizeof(int));
+			}
+		}
+	}
+	std::error_code sock_ec(errno, std::generic_category());
+	if( conn_fd >= 0 ) { ::close(conn_fd); }
+	struct stat ring_st;
+	if( (ring_fd < 0) or (::fstat(ring_fd, &ring_st) != 0) or (static_cast<size_t>(ring_st.st_size) < sizeof(ShmRingHeader)) ) {
+		if( ring_fd >= 0 ) { ::close(ring_fd); }
+		throw fsys::filesystem_error("Unable to receive the shared-memory ring.", sockpath, sock_ec);
+	}
+	const size_t ring_bytes = static_cast<size_t>(ring_st.st_size);
+	void* mapping = ::mmap(nullptr, ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+	::close(ring_fd);
+	if( mapping == MAP_FAILED ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to map the shared-memory ring.", sockpath, ec);
+	}
+	char* ring = static_cast<char*>(mapping);
+	ShmRingHeader* header = reinterpret_cast<ShmRingHeader*>(ring);
+	const uint32_t slot_count = header->slot_count;
+	const uint32_t slot_bytes = header->slot_bytes;
+	const size_t slots_offset = (sizeof(ShmRingHeader) + 63) / 64 * 64;
+	const size_t data_offset = slots_offset + (slot_count * sizeof(ShmSlot) + 63) / 64 * 64;
+	if( (std::memcmp(header->magic, SHM_RING_MAGIC, sizeof(header->magic)) != 0) or (header->version != SHM_RING_VERSION) or
+	    (slot_count < 3) or (slot_bytes == 0) or (data_offset + static_cast<size_t>(slot_count) * slot_bytes > ring_bytes) )
+	{
+		::munmap(mapping, ring_bytes);
+		throw std::runtime_error(std::format("\nNot a ShiftCipher shared-memory ring: {}.\n", sockpath.string()));
+	}
+	ShmSlot* slots = reinterpret_cast<ShmSlot*>(ring + slots_offset);
+
+	int in_fd = ::open(ifilepath.c_str(), O_RDONLY | O_CLOEXEC);
+	int out_fd = ::open(ofilepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if( (in_fd < 0) or (out_fd < 0) ) {
+		std::error_code ec(errno, std::generic_category());
+		if( in_fd >= 0 ) { ::close(in_fd); }
+		if( out_fd >= 0 ) { ::close(out_fd); }
+		::munmap(mapping, ring_bytes);
+		throw fsys::filesystem_error("Unable to open file.", ( in_fd < 0 ) ? ifilepath : ofilepath, ec);
+	}
+
+	std::deque<uint64_t> inflight;
+	uint64_t nbytes = 0, nslots = 0;
+
+	auto checkServing = [&]() {
+		if( header->closed.load() ) {
+			throw std::runtime_error(std::format("\nThe --serve-shm service of {} stopped; {} is incomplete.\n",
+			                                     sockpath.string(), ofilepath.string()));
+		}
+	};
+
+	// the oldest ticket in flight, if enciphered (or when wait is set, once
+	//   it is): written out and its slot freed for the next lap
+	auto collect = [&](bool wait) {
+		const uint64_t ticket = inflight.front();
+		ShmSlot& slot = slots[ticket % slot_count];
+		const uint32_t done = static_cast<uint32_t>(ticket + 2);
+		uint32_t seq = 0;
+		while( (seq = slot.seq.load(std::memory_order_acquire)) != done ) {
+			if( not wait ) {
+				return(false);
+			}
+			checkServing();
+			waitShmSlot(&slot, seq, SHM_WAIT_MS);
+		}
+		writeFull(out_fd, ring + data_offset + (ticket % slot_count) * slot_bytes, std::min<size_t>(slot.length, slot_bytes), ofilepath);
+		publishShmSlot(&slot, static_cast<uint32_t>(ticket + slot_count));
+		inflight.pop_front();
+		return(true);
+	};
+
+	try {
+		bool more = true;
+		while( more or (not inflight.empty()) ) {
+			if( (not more) or (inflight.size() >= SHM_CLIENT_DEPTH) ) {
+				collect(true);
+				continue;
+			}
+
+			const uint64_t ticket = header->next_ticket.fetch_add(1);
+			ShmSlot& slot = slots[ticket % slot_count];
+			const uint32_t free_seq = static_cast<uint32_t>(ticket);
+			uint32_t seq = 0;
+			while( (seq = slot.seq.load(std::memory_order_acquire)) != free_seq ) {
+				if( inflight.empty() or (not collect(false)) ) {
+					checkServing();
+					waitShmSlot(&slot, seq, SHM_WAIT_MS);
+				}
+			}
+
+			// an empty chunk still goes round, the ticket must be used
+			char* data = ring + data_offset + (ticket % slot_count) * slot_bytes;
+			const size_t nread = readFull(in_fd, data, slot_bytes, ifilepath);
+			more = ( nread == slot_bytes );
+			slot.length = static_cast<uint32_t>(nread);
+			publishShmSlot(&slot, free_seq + 1);
+			inflight.push_back(ticket);
+			nbytes += nread;
+			++nslots;
+		}
+	}
+	catch( ... ) {
+		::close(in_fd);
+		::close(out_fd);
+		::munmap(mapping, ring_bytes);
+		throw;
+	}
+	::close(in_fd);
+	::close(out_fd);
+	::munmap(mapping, ring_bytes);
+	ciphopts->nbytes_file = nbytes;
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Enciphered {:d} bytes in {:d} slots through the ring of {}.", nbytes, nslots, sockpath.string()) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Helpers for writeAllShifts: the 26 letter rotations of a block, written
+ *   to one output buffer per rotation. The table version applies each
+ *   rotation's byte table in turn; the AVX2 version loads every 32 bytes
+ *   once and derives rotation r+1 from rotation r by adding 1 to the letters
+ *   and wrapping 'z'+1/'Z'+1 back by 26.
+ */
+void rotateBlockTables(const char* in, size_t nbytes, const std::array<std::array<char,256>,26>& tables,
+                       char* const* outs) noexcept
+{
+	for(size_t r = 0; r < 26; ++r) {
+		for(size_t n = 0; n < nbytes; ++n) {
+			outs[r][n] = tables[r][static_cast<unsigned char>(in[n])];
+		}
+	}
+
+	return;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+size_t rotateBlockAVX2(const char* in, size_t nbytes, char* const* outs) noexcept
+{
+	const __m256i fold  = _mm256_set1_epi8(0x20);
+	const __m256i base  = _mm256_set1_epi8('a');
+	const __m256i last  = _mm256_set1_epi8(25);
+	const __m256i one   = _mm256_set1_epi8(1);
+	const __m256i wrap  = _mm256_set1_epi8(26);
+	const __m256i past_lower = _mm256_set1_epi8('z' + 1);
+	const __m256i past_upper = _mm256_set1_epi8('Z' + 1);
+
+	size_t n = 0;
+	for(; n + 32 <= nbytes; n += 32) {
+		__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + n));
+		__m256i index = _mm256_sub_epi8(_mm256_or_si256(bytes, fold), base);
+		__m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(index, last), index);
+		__m256i step = _mm256_and_si256(is_letter, one);
+
+		for(size_t r = 0; r < 26; ++r) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(outs[r] + n), bytes);
+			bytes = _mm256_add_epi8(bytes, step);
+			__m256i past = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, past_lower), _mm256_cmpeq_epi8(bytes, past_upper));
+			bytes = _mm256_sub_epi8(bytes, _mm256_and_si256(_mm256_and_si256(past, is_letter), wrap));
+		}
+	}
+
+	return(n);
+}
+#endif
+
+/*
+ * Description:
+ * Writes all 26 shifted variants of IFILE in a single read pass, to
+ *   BASE.shift00 ... BASE.shift25 where BASE is OFILE if given, otherwise
+ *   IFILE. Each block is read once and turned into 26 output blocks while it
+ *   is in cache, by the incrementing vector add when only letters are
+ *   shifted, otherwise by the 26 byte tables of the cipher dictionaries for
+ *   shifts 0-25 (so --shift-nums, --shift-puncts and --decipher apply as
+ *   they do to a single shift). Every output block goes out in one write.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void writeAllShifts(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	const string basename = ciphopts->use_default_oname ? ciphopts->infilename : ciphopts->outfilename;
+
+	// byte tables of the 26 cipher dictionaries
+	std::array<std::array<char,256>,26> tables;
+	for(int shift = 0; shift < 26; ++shift) {
+		CipherOptions shiftopts = *ciphopts;
+		shiftopts.shift_amount = shift;
+		shiftopts.cipher_dict.clear();
+		generateCipherDict(&shiftopts);
+		tables[static_cast<size_t>(shift)] = cipherDictTable(shiftopts.cipher_dict);
+	}
+
+	std::ifstream ifile(ifilepath, std::ios::binary);
+	std::array<std::ofstream,26> ofiles;
+	for(size_t shift = 0; shift < 26; ++shift) {
+		ofiles[shift].open(fsys::path(std::format("{}.shift{:02d}", basename, shift)), std::ios::binary | std::ios::trunc);
+	}
+
+	// rotation r (letters moved forward by r) is shift r, or shift 26-r
+	//   when deciphering
+	std::vector<char> inbuf(ALL_SHIFTS_BLOCK_BYTES);
+	std::vector<char> outbuf(26 * ALL_SHIFTS_BLOCK_BYTES);
+	std::array<char*,26> outs;
+	for(size_t r = 0; r < 26; ++r) {
+		size_t shift = ciphopts->decipher ? (26 - r) % 26 : r;
+		outs[r] = outbuf.data() + shift * ALL_SHIFTS_BLOCK_BYTES;
+	}
+
+	// a keyword-mixed alphabet is not a rotation, so --alphabet-key goes
+	//   through the tables
+	const bool letters_only = (not ciphopts->enc_numbers) and (not ciphopts->enc_puncts) and ciphopts->alphabet_key.empty();
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	while( ifile.read(inbuf.data(), static_cast<std::streamsize>(inbuf.size())) or (ifile.gcount() > 0) ) {
+		const size_t nread = static_cast<size_t>(ifile.gcount());
+		size_t done = 0;
+#if defined(__x86_64__)
+		if( letters_only and has_avx2 ) {
+			done = rotateBlockAVX2(inbuf.data(), nread, outs.data());
+		}
+#endif
+		if( done < nread ) {
+			std::array<char*,26> tails;
+			for(size_t shift = 0; shift < 26; ++shift) {
+				tails[shift] = outbuf.data() + shift * ALL_SHIFTS_BLOCK_BYTES + done;
+			}
+			rotateBlockTables(inbuf.data() + done, nread - done, tables, tails.data());
+		}
+
+		for(size_t shift = 0; shift < 26; ++shift) {
+			ofiles[shift].write(outbuf.data() + shift * ALL_SHIFTS_BLOCK_BYTES, static_cast<std::streamsize>(nread));
+		}
+		ciphopts->nbytes_file += nread;
+	}
+
+	for(size_t shift = 0; shift < 26; ++shift) {
+		ofiles[shift].close();
+		if( not ofiles[shift] ) {
+			fsys::path opath( std::format("{}.shift{:02d}", basename, shift) );
+			std::error_code ec(errno, std::generic_category());
+			throw fsys::filesystem_error("Unable to write output file.", opath, ec);
+		}
+	}
+
+	if( not ciphopts->display_log_info ) {
+		cout << endl;
+		cout << std::format("Read {:d} characters from the input file.", ciphopts->nbytes_file) << endl;
+		cout << std::format("Wrote {}.shift00 to {}.shift25", basename, basename) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Writes an unsigned integer as a variable-length (LEB128) value: 7 bits per
+ *   byte, least-significant group first, high bit set on all but the last byte.
+ *
+ * Input:
+ * ostrm -> stream to write to
+ * value -> integer to encode
+ *
+ * Output:
+ * Number of bytes written
+ */
+size_t writeVarint(std::ostream& ostrm, uint64_t value)
+{
+	size_t nbytes = 0;
+	while( value >= 0x80 ) {
+		ostrm.put(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+		++nbytes;
+	}
+	ostrm.put(static_cast<char>(value));
+
+	return(nbytes + 1);
+}
+
+/*
+ * Description:
+ * Reads a variable-length (LEB128) value written by writeVarint and advances
+ *   the read position past it. Throws std::runtime_error if the value runs
+ *   past the end of the buffer.
+ *
+ * Input:
+ * pos -> current read position (updated)
+ * end -> one past the last readable byte
+ *
+ * Output:
+ * Decoded integer
+ */
+uint64_t readVarint(const unsigned char*& pos, const unsigned char* end)
+{
+	uint64_t value = 0;
+	for(int bit_shift = 0; pos < end and bit_shift < 64; bit_shift += 7) {
+		unsigned char byte = *pos++;
+		value |= static_cast<uint64_t>(byte & 0x7F) << bit_shift;
+		if( (byte & 0x80) == 0 ) {
+			return(value);
+		}
+	}
+
+	throw std::runtime_error("\nTruncated or malformed variable-length integer in index file.\n");
+}
+
+/*
+ * Description:
+ * Opens the index file and writes a placeholder header, completed by finish().
+ *
+ * Input:
+ * idxpath -> path of the sidecar index to create (overwritten if exists)
+ */
+LineIndexWriter::LineIndexWriter(const fsys::path& idxpath)
+	: idxfile(idxpath, std::ios::binary | std::ios::trunc)
+{
+	if( not idxfile ) {
+		string errmsg{"Unable to create line index file."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, idxpath, ec);
+	}
+
+	LineIndexHeader header{};
+	idxfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+/*
+ * Description:
+ * Records the start of the next line. The first line of each block goes into
+ *   the skip table, the others are stored as varint deltas from the previous line.
+ *
+ * Input:
+ * line_offset -> byte offset of the line in the enciphered file
+ */
+void LineIndexWriter::addLine(uint64_t line_offset)
+{
+	if( (num_lines % LINE_INDEX_BLOCK_LINES) == 0 ) {
+		skip_table.push_back(line_offset);
+		skip_table.push_back(deltas_pos);
+	}
+	else {
+		deltas_pos += writeVarint(idxfile, line_offset - prev_offset);
+	}
+
+	prev_offset = line_offset;
+	++num_lines;
+
+	return;
+}
+
+/*
+ * Description:
+ * Reads the size and modification time of an enciphered file. Throws
+ *   fsys::filesystem_error if the file cannot be examined.
+ *
+ * Input:
+ * cipherpath -> the enciphered file
+ *
+ * Output:
+ * Stamp to record in (or compare with) a sidecar header
+ */
+CipherFileStamp stampCipherFile(const fsys::path& cipherpath)
+{
+	struct stat st{};
+	if( ::stat(cipherpath.c_str(), &st) != 0 ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to read file status.", cipherpath, ec);
+	}
+
+	CipherFileStamp stamp{};
+	stamp.size     = static_cast<uint64_t>(st.st_size);
+	stamp.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+	return(stamp);
+}
+
+/*
+ * Description:
+ * Checks that a sidecar was written for the current contents of its
+ *   enciphered file.
+ *
+ * Input:
+ * stamp      -> stamp recorded in the sidecar header
+ * cipherpath -> the enciphered file
+ *
+ * Output:
+ * true if the file still has the recorded size and modification time
+ */
+bool matchesCipherFile(const CipherFileStamp& stamp, const fsys::path& cipherpath)
+{
+	const CipherFileStamp current = stampCipherFile(cipherpath);
+
+	return( (stamp.size == current.size) and (stamp.mtime_ns == current.mtime_ns) );
+}
+
+/*
+ * Description:
+ * Appends the skip table and rewrites the header with the final counts.
+ *   Throws std::runtime_error if the index could not be written completely.
+ *
+ * Input:
+ * cipherpath -> the enciphered file the index describes, complete and closed
+ */
+void LineIndexWriter::finish(const fsys::path& cipherpath)
+{
+	LineIndexHeader header{};
+	std::copy(std::begin(LINE_INDEX_MAGIC), std::end(LINE_INDEX_MAGIC), header.magic);
+	header.version        = LINE_INDEX_VERSION;
+	header.block_lines    = LINE_INDEX_BLOCK_LINES;
+	header.num_lines      = num_lines;
+	header.num_blocks     = skip_table.size() / 2;
+	header.skip_table_pos = sizeof(LineIndexHeader) + deltas_pos;
+	header.cipher_stamp   = stampCipherFile(cipherpath);
+
+	idxfile.write(reinterpret_cast<const char*>(skip_table.data()),
+	              static_cast<std::streamsize>(skip_table.size() * sizeof(uint64_t)));
+	idxfile.seekp(0);
+	idxfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	idxfile.close();
+
+	if( idxfile.fail() ) {
+		throw std::runtime_error("\nFailed to write the line index file.\n");
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Maps a line-offset index and checks its header and skip table fit in the
+ *   file. Throws std::runtime_error for a malformed index, or one written
+ *   for an earlier version of the enciphered file.
+ *
+ * Input:
+ * idxpath    -> path of the line-offset index
+ * cipherpath -> the enciphered file it indexes
+ */
+LineIndexReader::LineIndexReader(const fsys::path& idxpath, const fsys::path& cipherpath)
+	: idxfile(idxpath)
+{
+	if( idxfile.size() >= sizeof(header) ) {
+		std::memcpy(&header, idxfile.data(), sizeof(header));
+	}
+
+	if( (idxfile.size() < sizeof(header)) or 
+	    (not std::equal(std::begin(LINE_INDEX_MAGIC), std::end(LINE_INDEX_MAGIC), header.magic)) or
+	    (header.version != LINE_INDEX_VERSION) or (header.block_lines == 0) or
+	    (header.skip_table_pos < sizeof(header)) or (header.skip_table_pos > idxfile.size()) or
+	    (header.num_blocks > (idxfile.size() - header.skip_table_pos) / (2 * sizeof(uint64_t))) or
+	    (header.num_lines > header.num_blocks * header.block_lines) ) 
+	{
+		throw std::runtime_error(std::format("\nInvalid line index file ({}).\n", idxpath.string()));
+	}
+
+	if( not matchesCipherFile(header.cipher_stamp, cipherpath) ) {
+		throw std::runtime_error(std::format(
+			"\nThe line index {} is out of date ({} has changed since it was written).\n",
+			idxpath.string(), cipherpath.string()));
+	}
+}
+
+/*
+ * Description:
+ * Finds the byte offset of a line. Only one skip-table entry and at most one
+ *   block of deltas are read, so the cost does not depend on the position of
+ *   the line in the file.
+ *
+ * Input:
+ * line_number -> 0-based line to locate (must be < numLines())
+ *
+ * Output:
+ * Byte offset of the start of the line
+ */
+uint64_t LineIndexReader::lineOffset(uint64_t line_number) const
+{
+	// skip-table entry of the block holding the line
+	uint64_t entry[2] = {0, 0};
+	uint64_t block = line_number / header.block_lines;
+	std::memcpy(entry, idxfile.data() + header.skip_table_pos + block * sizeof(entry), sizeof(entry));
+
+	// deltas of the lines before it within the block
+	const unsigned char* pos = reinterpret_cast<const unsigned char*>(idxfile.data()) + sizeof(header) + entry[1];
+	const unsigned char* end = reinterpret_cast<const unsigned char*>(idxfile.data()) + header.skip_table_pos;
+	if( pos > end ) {
+		throw std::runtime_error("\nInvalid line index file (skip table entry out of range).\n");
+	}
+
+	uint64_t offset = entry[0];
+	for(uint64_t n = line_number % header.block_lines; n > 0; --n) {
+		offset += readVarint(pos, end);
+	}
+
+	return(offset);
+}
+
+/*
+ * Description:
+ * Finds the byte offset of a line in an enciphered file using its line-offset
+ *   index. Throws std::runtime_error for a malformed index and 
+ *   std::invalid_argument if the line is past the end of the file.
+ *
+ * Input:
+ * idxpath     -> path of the line-offset index
+ * cipherpath  -> the enciphered file it indexes
+ * line_number -> 0-based line to locate
+ * num_lines   -> (output) total number of lines in the indexed file
+ *
+ * Output:
+ * Byte offset of the start of the line
+ */
+uint64_t lookupLineOffset(const fsys::path& idxpath, const fsys::path& cipherpath, uint64_t line_number, uint64_t* num_lines)
+{
+	LineIndexReader reader(idxpath, cipherpath);
+
+	*num_lines = reader.numLines();
+	if( line_number >= reader.numLines() ) {
+		throw std::invalid_argument(std::format(
+			"\nLine {:d} is past the end of the input file ({:d} lines).\n",
+			line_number + 1, reader.numLines()));
+	}
+
+	return(reader.lineOffset(line_number));
+}
+
+/*
+ * Description:
+ * Deciphers lines first_line to last_line of an enciphered input file. The
+ *   start of the range is found with the IFILE.lidx line-offset index so only
+ *   the requested lines are read. Output goes to OFILE if one was given and
+ *   to the terminal otherwise.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void decipherLineRange(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	fsys::path idxpath( ciphopts->infilename + LINE_INDEX_EXT );
+
+	for(const fsys::path& reqpath : {ifilepath, idxpath}) {
+		if( not fsys::exists(reqpath) ) {
+			string errmsg{"Input file not found."};
+			std::error_code ec;
+			throw fsys::filesystem_error(errmsg, reqpath, ec);
+		}
+	}
+
+	uint64_t num_lines = 0;
+	uint64_t offset = lookupLineOffset(idxpath, ifilepath, ciphopts->first_line - 1, &num_lines);
+	uint64_t last_line = std::min(ciphopts->last_line, num_lines);
+
+	std::ifstream ifile(ifilepath, std::ios::binary);
+	ifile.seekg(static_cast<std::streamoff>(offset));
+
+	std::ofstream ofile;
+	if( not ciphopts->use_default_oname ) {
+		ofile.open(fsys::path(ciphopts->outfilename));
+	}
+	std::ostream& ostrm = ofile.is_open() ? static_cast<std::ostream&>(ofile) : cout;
+
+	string origstr, outstr;
+	for(uint64_t line = ciphopts->first_line; line <= last_line and std::getline(ifile, origstr); ++line) {
+		for(size_t n = 0; n < origstr.size(); ++n, ciphopts->nbytes_file++) {
+			if(ciphopts->cipher_dict.contains(origstr[n])) {
+				outstr.push_back(ciphopts->cipher_dict[origstr[n]]);
+			}
+			else {
+				outstr.push_back(origstr[n]);
+			}
+		}
+
+		ostrm << outstr << '\n';
+
+		outstr.clear();
+	}
+	ostrm.flush();
+
+	return;
+}
+
+/*
+ * Description:
+ * Maps a whole file read-only into memory. Empty files are not mapped and
+ *   have a null data() pointer. Throws fsys::filesystem_error if the file
+ *   cannot be opened or mapped.
+ *
+ * Input:
+ * path -> file to map
+ */
+MappedFile::MappedFile(const fsys::path& path)
+{
+	std::error_code ec;
+
+	fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if( fd < 0 ) {
+		ec.assign(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to open file for mapping.", path, ec);
+	}
+
+	struct stat st{};
+	if( ::fstat(fd, &st) != 0 ) {
+		ec.assign(errno, std::generic_category());
+		::close(fd);
+		throw fsys::filesystem_error("Unable to read file size.", path, ec);
+	}
+
+	length = static_cast<size_t>(st.st_size);
+	if( length > 0 ) {
+		addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if( addr == MAP_FAILED ) {
+			ec.assign(errno, std::generic_category());
+			addr = nullptr;
+			::close(fd);
+			throw fsys::filesystem_error("Unable to map file into memory.", path, ec);
+		}
+		::madvise(addr, length, MADV_SEQUENTIAL);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if( addr != nullptr ) { ::munmap(addr, length); }
+	if( fd >= 0 ) { ::close(fd); }
+}
+
+/*
+ * Description:
+ * Number of worker threads for the parallel modes: the -j/--threads value
+ *   if given, otherwise one per hardware thread.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * Thread count (at least 1)
+ */
+unsigned resolveThreadCount(const CipherOptions* ciphopts) noexcept
+{
+	if( ciphopts->num_threads > 0 ) {
+		return(ciphopts->num_threads);
+	}
+
+	return(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+/*
+ * Description:
+ * Helpers for findCipherPattern: lowercase an ASCII letter, check for a full
+ *   match of the pattern at a position and a plain scalar search used for
+ *   CPUs without vector support and for the tails of the vector loops.
+ */
+inline char foldCase(char chr) noexcept
+{
+	return( (chr >= 'A' and chr <= 'Z') ? static_cast<char>(chr | 0x20) : chr );
+}
+
+// letters and digits make up words (shifting never moves a character
+//   between these classes and punctuation/whitespace)
+inline bool isCipherWordChar(char chr) noexcept
+{
+	return( (chr >= 'a' and chr <= 'z') or (chr >= 'A' and chr <= 'Z') or (chr >= '0' and chr <= '9') );
+}
+
+inline bool matchesCipherPattern(const char* pos, const CipherPattern& pat) noexcept
+{
+	if( not pat.ignore_case ) {
+		return(std::memcmp(pos, pat.text.data(), pat.text.size()) == 0);
+	}
+
+	for(size_t n = 0; n < pat.text.size(); ++n) {
+		if( foldCase(pos[n]) != pat.text[n] ) {
+			return(false);
+		}
+	}
+	return(true);
+}
+
+size_t findCipherPatternScalar(const char* hay, size_t n, const CipherPattern& pat) noexcept
+{
+	const size_t m = pat.text.size();
+	for(size_t i = 0; i + m <= n; ++i) {
+		if( matchesCipherPattern(hay + i, pat) ) {
+			return(i);
+		}
+	}
+
+	return(n);
+}
+
+// with ignore_case, letters are compared after setting the lowercase bit
+//   (0x20) of the text byte, which cannot create false candidates because
+//   candidates are always verified with matchesCipherPattern
+inline char foldBit(char chr, bool ignore_case) noexcept
+{
+	return( (ignore_case and chr >= 'a' and chr <= 'z') ? 0x20 : 0x00 );
+}
+
+#if defined(__x86_64__)
+/*
+ * Description:
+ * Vectorized substring search: compares the first and last bytes of the
+ *   pattern against 32 (AVX2) or 16 (SSE2) candidate positions at once and
+ *   only verifies the full pattern where both match.
+ */
+__attribute__((target("avx2")))
+size_t findCipherPatternAVX2(const char* hay, size_t n, const CipherPattern& pat) noexcept
+{
+	const size_t m = pat.text.size();
+	const __m256i first_vec  = _mm256_set1_epi8(pat.text.front());
+	const __m256i last_vec   = _mm256_set1_epi8(pat.text.back());
+	const __m256i first_fold = _mm256_set1_epi8(foldBit(pat.text.front(), pat.ignore_case));
+	const __m256i last_fold  = _mm256_set1_epi8(foldBit(pat.text.back(), pat.ignore_case));
+
+	size_t i = 0;
+	for(; i + m + 31 <= n; i += 32) {
+		__m256i blk_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i));
+		__m256i blk_last  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i + m - 1));
+		__m256i eq_first  = _mm256_cmpeq_epi8(_mm256_or_si256(blk_first, first_fold), first_vec);
+		__m256i eq_last   = _mm256_cmpeq_epi8(_mm256_or_si256(blk_last, last_fold), last_vec);
+
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)));
+		while( mask != 0 ) {
+			unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+			if( matchesCipherPattern(hay + i + bit, pat) ) {
+				return(i + bit);
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return(i + findCipherPatternScalar(hay + i, n - i, pat));
+}
+
+size_t findCipherPatternSSE2(const char* hay, size_t n, const CipherPattern& pat) noexcept
+{
+	const size_t m = pat.text.size();
+	const __m128i first_vec  = _mm_set1_epi8(pat.text.front());
+	const __m128i last_vec   = _mm_set1_epi8(pat.text.back());
+	const __m128i first_fold = _mm_set1_epi8(foldBit(pat.text.front(), pat.ignore_case));
+	const __m128i last_fold  = _mm_set1_epi8(foldBit(pat.text.back(), pat.ignore_case));
+
+	size_t i = 0;
+	for(; i + m + 15 <= n; i += 16) {
+		__m128i blk_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+		__m128i blk_last  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+		__m128i eq_first  = _mm_cmpeq_epi8(_mm_or_si128(blk_first, first_fold), first_vec);
+		__m128i eq_last   = _mm_cmpeq_epi8(_mm_or_si128(blk_last, last_fold), last_vec);
+
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)));
+		while( mask != 0 ) {
+			unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+			if( matchesCipherPattern(hay + i + bit, pat) ) {
+				return(i + bit);
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return(i + findCipherPatternScalar(hay + i, n - i, pat));
+}
+#endif
+
+/*
+ * Description:
+ * Finds the first occurrence of an enciphered pattern in a buffer, using the
+ *   widest vector search the CPU supports.
+ *
+ * Input:
+ * hay -> buffer to search
+ * n   -> number of bytes in the buffer
+ * pat -> enciphered pattern (must not be empty)
+ *
+ * Output:
+ * Offset of the first match, or n if there is none
+ */
+size_t findCipherPattern(const char* hay, size_t n, const CipherPattern& pat) noexcept
+{
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	if( has_avx2 ) {
+		return(findCipherPatternAVX2(hay, n, pat));
+	}
+	return(findCipherPatternSSE2(hay, n, pat));
+#else
+	return(findCipherPatternScalar(hay, n, pat));
+#endif
+}
+
+/*
+ * Description:
+ * Enciphers the plaintext search pattern with the forward (enciphering)
+ *   dictionary. With ignore_case the pattern letters are lowercased first.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options (grep_pattern, shift)
+ *
+ * Output:
+ * Enciphered pattern
+ */
+CipherPattern encipherPattern(const CipherOptions* ciphopts)
+{
+	CipherOptions encopts = *ciphopts;
+	encopts.decipher = false;
+	encopts.cipher_dict.clear();
+	generateCipherDict(&encopts);
+
+	CipherPattern pattern;
+	pattern.ignore_case = ciphopts->ignore_case;
+	for(char chr : ciphopts->grep_pattern) {
+		if( pattern.ignore_case ) {
+			chr = foldCase(chr);
+		}
+		pattern.text.push_back( encopts.cipher_dict.contains(chr) ? encopts.cipher_dict[chr] : chr );
+	}
+
+	return(pattern);
+}
+
+/*
+ * Description:
+ * Collects the lines of base[begin, end) that contain the enciphered pattern
+ *   (as whole words if the pattern asks for it). begin must be the start of
+ *   a line.
+ *
+ * Input:
+ * base    -> buffer holding the ciphertext
+ * begin   -> offset of the first byte to search
+ * end     -> offset one past the last byte to search
+ * pattern -> enciphered pattern
+ * lines   -> (output) [start, end) offsets of matching lines, newline excluded
+ *
+ * Output:
+ * None
+ */
+void findMatchingLines(const char* base, size_t begin, size_t end, const CipherPattern& pattern,
+                       std::vector<std::pair<size_t,size_t>>* lines) noexcept
+{
+	size_t pos = begin;
+	while( pos < end ) {
+		size_t match = pos + findCipherPattern(base + pos, end - pos, pattern);
+		if( match >= end ) {
+			break;
+		}
+
+		if( pattern.whole_words ) {
+			size_t match_end = match + pattern.text.size();
+			if( ((match > 0) and isCipherWordChar(base[match - 1])) or
+			    ((match_end < end) and isCipherWordChar(base[match_end])) )
+			{
+				pos = match + 1;
+				continue;
+			}
+		}
+
+		size_t line_start = match;
+		while( (line_start > begin) and (base[line_start - 1] != '\n') ) {
+			--line_start;
+		}
+
+		const void* nl = std::memchr(base + match, '\n', end - match);
+		size_t line_end = ( nl == nullptr ) ? end : static_cast<size_t>(static_cast<const char*>(nl) - base);
+
+		lines->emplace_back(line_start, line_end);
+		pos = line_end + 1;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Appends the deciphered form of a span of ciphertext to a string.
+ *
+ * Input:
+ * dict   -> deciphering dictionary
+ * text   -> start of the ciphertext span
+ * nbytes -> length of the span
+ * outstr -> (output) string to append to
+ *
+ * Output:
+ * None
+ */
+void decipherSpan(const chrdict& dict, const char* text, size_t nbytes, string* outstr)
+{
+	for(size_t n = 0; n < nbytes; ++n) {
+		auto dIter = dict.find(text[n]);
+		outstr->push_back( (dIter != dict.end()) ? dIter->second : text[n] );
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Searches enciphered input files for a plaintext pattern without deciphering
+ *   them. A shift cipher maps the pattern to exactly one ciphertext string
+ *   (and letter case is preserved by the shift, so case-insensitive matching
+ *   also carries over), so the pattern is enciphered once and the ciphertext
+ *   is scanned directly. Files are memory-mapped and split into line-aligned
+ *   chunks that are searched in parallel. Matching lines are deciphered and
+ *   printed in file order, prefixed by the filename when several files are
+ *   searched. Output goes to OFILE if given, otherwise to the terminal.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void grepCipherFiles(CipherOptions* ciphopts)
+{
+	if( ciphopts->infilenames.empty() ) {
+		throw std::invalid_argument("\nNo input file given for --grep. See HELP with -h or --help option.\n");
+	}
+
+	// the pattern is enciphered and the matching lines are deciphered
+	CipherPattern pattern = encipherPattern(ciphopts);
+
+	CipherOptions decopts = *ciphopts;
+	decopts.decipher = true;
+	decopts.cipher_dict.clear();
+	generateCipherDict(&decopts);
+
+	// map every input file and split it into line-aligned chunks
+	struct GrepChunk
+	{
+		size_t file_number;
+		size_t begin;
+		size_t end;
+		std::vector<std::pair<size_t,size_t>> lines;  // [start, end) of matching lines
+	};
+
+	const unsigned nthreads = resolveThreadCount(ciphopts);
+	std::vector<std::unique_ptr<MappedFile>> mapped_files;
+	std::vector<GrepChunk> chunks;
+
+	for(const string& fname : ciphopts->infilenames) {
+		fsys::path ifilepath( fname );
+		if( not fsys::exists(ifilepath) ) {
+			string errmsg{"Input file not found."};
+			std::error_code ec;
+			throw fsys::filesystem_error(errmsg, ifilepath, ec);
+		}
+
+		mapped_files.push_back(std::make_unique<MappedFile>(ifilepath));
+		const MappedFile& mfile = *mapped_files.back();
+
+		const size_t chunk_target = std::max<size_t>(mfile.size() / (4 * nthreads), 1 << 20);
+		for(size_t begin = 0; begin < mfile.size(); ) {
+			size_t end = std::min(begin + chunk_target, mfile.size());
+			const void* nl = std::memchr(mfile.data() + end, '\n', mfile.size() - end);
+			end = ( nl == nullptr ) ? mfile.size() : static_cast<size_t>(static_cast<const char*>(nl) - mfile.data()) + 1;
+
+			chunks.push_back({mapped_files.size() - 1, begin, end, {}});
+			begin = end;
+		}
+	}
+
+	// search the chunks in parallel
+	std::atomic<size_t> next_chunk{0};
+	auto grep_worker = [&]() {
+		for(size_t c = next_chunk++; c < chunks.size(); c = next_chunk++) {
+			GrepChunk& chunk = chunks[c];
+			findMatchingLines(mapped_files[chunk.file_number]->data(), chunk.begin, chunk.end, 
+			                  pattern, &chunk.lines);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(unsigned t = 1; t < std::min<size_t>(nthreads, chunks.size()); ++t) {
+		workers.emplace_back(grep_worker);
+	}
+	grep_worker();
+	for(std::thread& worker : workers) {
+		worker.join();
+	}
+
+	// decipher and print the matching lines in file order
+	std::ofstream ofile;
+	if( not ciphopts->use_default_oname ) {
+		ofile.open(fsys::path(ciphopts->outfilename));
+	}
+	std::ostream& ostrm = ofile.is_open() ? static_cast<std::ostream&>(ofile) : cout;
+
+	const bool show_filename = ciphopts->infilenames.size() > 1;
+	string outstr;
+	for(const GrepChunk& chunk : chunks) {
+		const char* base = mapped_files[chunk.file_number]->data();
+		for(const auto& [line_start, line_end] : chunk.lines) {
+			decipherSpan(decopts.cipher_dict, base + line_start, line_end - line_start, &outstr);
+			ciphopts->nbytes_file += line_end - line_start;
+
+			if( show_filename ) {
+				ostrm << ciphopts->infilenames[chunk.file_number] << ':';
+			}
+			ostrm << outstr << '\n';
+
+			outstr.clear();
+		}
+	}
+	ostrm.flush();
+
+	return;
+}
+
+/*
+ * Description:
+ * Starts the indexing workers. The index file itself is only written by finish().
+ *
+ * Input:
+ * tgipath  -> path of the trigram index to create (overwritten if exists)
+ * nworkers -> number of worker threads extracting trigrams
+ */
+TrigramIndexBuilder::TrigramIndexBuilder(const fsys::path& tgipath, unsigned nworkers)
+	: idxpath(tgipath), worker_keys(std::max(1u, nworkers))
+{
+	batch.reserve(TRIGRAM_BATCH_LINES);
+	for(size_t w = 0; w < worker_keys.size(); ++w) {
+		workers.emplace_back(&TrigramIndexBuilder::workerLoop, this, w);
+	}
+}
+
+TrigramIndexBuilder::~TrigramIndexBuilder()
+{
+	stopWorkers();
+	removeRuns();
+}
+
+/*
+ * Description:
+ * Adds the next enciphered line to the current batch, handing the batch to
+ *   the workers when it is full.
+ */
+void TrigramIndexBuilder::addLine(const string& line)
+{
+	batch.push_back(line);
+	++num_lines;
+
+	if( batch.size() >= TRIGRAM_BATCH_LINES ) {
+		submitBatch();
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Queues the current batch. Blocks while the queue already holds two batches
+ *   per worker so a slow indexer cannot make memory use grow without bound.
+ */
+void TrigramIndexBuilder::submitBatch()
+{
+	if( batch.empty() ) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	queue_cv.wait(lock, [this]{ return(queue.size() < 2 * workers.size()); });
+	queue.emplace_back(batch_first_line, std::move(batch));
+	lock.unlock();
+	queue_cv.notify_all();
+
+	batch_first_line = num_lines;
+	batch = std::vector<string>();
+	batch.reserve(TRIGRAM_BATCH_LINES);
+
+	return;
+}
+
+void TrigramIndexBuilder::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		closing = true;
+	}
+	queue_cv.notify_all();
+
+	for(std::thread& worker : workers) {
+		if( worker.joinable() ) {
+			worker.join();
+		}
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Worker thread: takes batches off the queue and records a key for each
+ *   (case-folded) trigram of each line. A trigram repeated within a line
+ *   gives identical keys, which spillRun() drops once they are sorted
+ *   together (a line's keys always go into the same run).
+ *
+ * Input:
+ * worker_number -> index of this worker's key vector
+ */
+void TrigramIndexBuilder::workerLoop(size_t worker_number)
+{
+	std::vector<uint64_t>& keys = worker_keys[worker_number];
+	std::vector<uint64_t> scratch;
+
+	while( true ) {
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		queue_cv.wait(lock, [this]{ return(closing or not queue.empty()); });
+		if( queue.empty() ) {
+			return;
+		}
+
+		auto [first_line, lines] = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+		queue_cv.notify_all();
+
+		for(size_t n = 0; n < lines.size(); ++n) {
+			const string& line = lines[n];
+			for(size_t c = 0; c + 2 < line.size(); ++c) {
+				uint64_t trigram =
+					(static_cast<uint64_t>(static_cast<unsigned char>(foldCase(line[c])))     << 16) |
+					(static_cast<uint64_t>(static_cast<unsigned char>(foldCase(line[c + 1]))) << 8)  |
+					 static_cast<uint64_t>(static_cast<unsigned char>(foldCase(line[c + 2])));
+				keys.push_back((trigram << 40) | (first_line + n));
+			}
+
+			if( keys.size() >= TRIGRAM_RUN_KEYS ) {
+				spillRun(&keys, &scratch);
+			}
+		}
+	}
+}
+
+/*
+ * Description:
+ * Sorts a worker's keys, drops duplicates and writes them to a new run file
+ *   as varint deltas, leaving the vector empty (its capacity is kept for the
+ *   next run). A worker takes its batches in order, so its keys arrive
+ *   sorted by line and a stable radix sort of the 24 trigram bits (one
+ *   byte per pass) sorts them completely. A failed write is recorded for
+ *   finish() to report.
+ *
+ * Input:
+ * keys    -> keys collected by one worker
+ * scratch -> buffer for the radix passes, reused between runs
+ */
+void TrigramIndexBuilder::spillRun(std::vector<uint64_t>* keys, std::vector<uint64_t>* scratch)
+{
+	scratch->resize(keys->size());
+	for(int shift = 40; shift < 64; shift += 8) {
+		std::array<size_t,257> starts{};
+		for(uint64_t key : *keys) {
+			++starts[((key >> shift) & 0xFF) + 1];
+		}
+		for(size_t b = 1; b < starts.size(); ++b) {
+			starts[b] += starts[b - 1];
+		}
+		for(uint64_t key : *keys) {
+			(*scratch)[starts[(key >> shift) & 0xFF]++] = key;
+		}
+		keys->swap(*scratch);
+	}
+	keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+
+	fsys::path runpath;
+	{
+		std::lock_guard<std::mutex> lock(runs_mutex);
+		runpath = fsys::path(idxpath.string() + TRIGRAM_RUN_EXT + std::to_string(run_paths.size()));
+		run_paths.push_back(runpath);
+	}
+
+	std::ofstream runfile(runpath, std::ios::binary | std::ios::trunc);
+	uint64_t prev_key = 0;
+	for(uint64_t key : *keys) {
+		writeVarint(runfile, key - prev_key);
+		prev_key = key;
+	}
+	runfile.close();
+
+	if( runfile.fail() ) {
+		spill_failed = true;
+	}
+
+	keys->clear();
+
+	return;
+}
+
+void TrigramIndexBuilder::removeRuns() noexcept
+{
+	std::error_code ec;
+	for(const fsys::path& runpath : run_paths) {
+		fsys::remove(runpath, ec);
+	}
+	run_paths.clear();
+
+	return;
+}
+
+/*
+ * Description:
+ * Flushes the last batch, waits for the workers and spills their remaining
+ *   keys, then merges the sorted runs (a min-heap holds the next key of
+ *   each) straight into the posting lists and writes the term table. Throws
+ *   std::runtime_error if the index could not be written completely.
+ *
+ * Input:
+ * cipherpath -> the enciphered file the index describes, complete and closed
+ */
+void TrigramIndexBuilder::finish(const fsys::path& cipherpath)
+{
+	submitBatch();
+	stopWorkers();
+
+	std::vector<uint64_t> scratch;
+	for(std::vector<uint64_t>& wkeys : worker_keys) {
+		if( not wkeys.empty() ) {
+			spillRun(&wkeys, &scratch);
+		}
+		wkeys = std::vector<uint64_t>();
+	}
+
+	if( spill_failed ) {
+		removeRuns();
+		throw std::runtime_error("\nFailed to write the trigram index run files.\n");
+	}
+
+	std::ofstream idxfile(idxpath, std::ios::binary | std::ios::trunc);
+	if( not idxfile ) {
+		string errmsg{"Unable to create trigram index file."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, idxpath, ec);
+	}
+
+	TrigramIndexHeader header{};
+	idxfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	// read position, end and last key of each run
+	struct RunCursor
+	{
+		const unsigned char* pos;
+		const unsigned char* end;
+		uint64_t key;
+	};
+
+	std::vector<std::unique_ptr<MappedFile>> runs;
+	std::vector<RunCursor> cursors;
+	std::priority_queue<std::pair<uint64_t,size_t>, std::vector<std::pair<uint64_t,size_t>>, std::greater<>> heap;
+	for(const fsys::path& runpath : run_paths) {
+		runs.push_back(std::make_unique<MappedFile>(runpath));
+		const unsigned char* pos = reinterpret_cast<const unsigned char*>(runs.back()->data());
+		RunCursor cursor{pos, pos + runs.back()->size(), 0};
+		if( cursor.pos < cursor.end ) {
+			cursor.key = readVarint(cursor.pos, cursor.end);
+			heap.emplace(cursor.key, cursors.size());
+		}
+		cursors.push_back(cursor);
+	}
+
+	const uint64_t line_mask = (uint64_t{1} << 40) - 1;
+	std::vector<TrigramTerm> terms;
+	TrigramTerm term{0, 0, 0};
+	uint64_t postings_pos = 0;
+	uint64_t prev_line = 0;
+	while( not heap.empty() ) {
+		auto [key, run] = heap.top();
+		heap.pop();
+
+		if( (term.num_postings == 0) or ((key >> 40) != term.trigram) ) {
+			if( term.num_postings > 0 ) {
+				terms.push_back(term);
+			}
+			term = TrigramTerm{static_cast<uint32_t>(key >> 40), 0, postings_pos};
+			prev_line = 0;
+		}
+
+		uint64_t line = key & line_mask;
+		postings_pos += writeVarint(idxfile, line - prev_line);
+		prev_line = line;
+		++term.num_postings;
+
+		RunCursor& cursor = cursors[run];
+		if( cursor.pos < cursor.end ) {
+			cursor.key += readVarint(cursor.pos, cursor.end);
+			heap.emplace(cursor.key, run);
+		}
+	}
+	if( term.num_postings > 0 ) {
+		terms.push_back(term);
+	}
+
+	runs.clear();
+	removeRuns();
+
+	std::copy(std::begin(TRIGRAM_INDEX_MAGIC), std::end(TRIGRAM_INDEX_MAGIC), header.magic);
+	header.version        = TRIGRAM_INDEX_VERSION;
+	header.num_lines      = num_lines;
+	header.num_terms      = terms.size();
+	header.term_table_pos = sizeof(header) + postings_pos;
+	header.cipher_stamp   = stampCipherFile(cipherpath);
+
+	idxfile.write(reinterpret_cast<const char*>(terms.data()),
+	              static_cast<std::streamsize>(terms.size() * sizeof(TrigramTerm)));
+	idxfile.seekp(0);
+	idxfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	idxfile.close();
+
+	if( idxfile.fail() ) {
+		throw std::runtime_error("\nFailed to write the trigram index file.\n");
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Searches enciphered input files through their trigram indexes. For each
+ *   file the (memory-mapped) index gives the posting lists of the distinct
+ *   trigrams of the enciphered pattern; the shortest list is intersected with
+ *   the others and only the surviving candidate lines, located with the
+ *   line-offset index, are checked against the full pattern. Patterns shorter
+ *   than three characters fall back to scanning the file. Matching lines are
+ *   printed deciphered as with --grep.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND or a malformed index)
+ */
+void queryTrigramIndex(CipherOptions* ciphopts)
+{
+	if( ciphopts->infilenames.empty() ) {
+		throw std::invalid_argument("\nNo input file given for --index-query. See HELP with -h or --help option.\n");
+	}
+
+	CipherPattern pattern = encipherPattern(ciphopts);
+
+	CipherOptions decopts = *ciphopts;
+	decopts.decipher = true;
+	decopts.cipher_dict.clear();
+	generateCipherDict(&decopts);
+
+	// distinct case-folded trigrams of the enciphered pattern
+	std::vector<uint32_t> pattern_trigrams;
+	for(size_t c = 0; c + 2 < pattern.text.size(); ++c) {
+		pattern_trigrams.push_back(
+			(static_cast<uint32_t>(static_cast<unsigned char>(foldCase(pattern.text[c])))     << 16) |
+			(static_cast<uint32_t>(static_cast<unsigned char>(foldCase(pattern.text[c + 1]))) << 8)  |
+			 static_cast<uint32_t>(static_cast<unsigned char>(foldCase(pattern.text[c + 2]))));
+	}
+	std::sort(pattern_trigrams.begin(), pattern_trigrams.end());
+	pattern_trigrams.erase(std::unique(pattern_trigrams.begin(), pattern_trigrams.end()), pattern_trigrams.end());
+
+	std::ofstream ofile;
+	if( not ciphopts->use_default_oname ) {
+		ofile.open(fsys::path(ciphopts->outfilename));
+	}
+	std::ostream& ostrm = ofile.is_open() ? static_cast<std::ostream&>(ofile) : cout;
+
+	const bool show_filename = ciphopts->infilenames.size() > 1;
+	std::vector<std::pair<size_t,size_t>> lines;
+	std::vector<uint64_t> candidates, postings, merged;
+	string outstr;
+
+	for(const string& fname : ciphopts->infilenames) {
+		fsys::path ifilepath( fname );
+		fsys::path tgipath( fname + TRIGRAM_INDEX_EXT );
+		fsys::path lidxpath( fname + LINE_INDEX_EXT );
+
+		for(const fsys::path& reqpath : {ifilepath, tgipath, lidxpath}) {
+			if( not fsys::exists(reqpath) ) {
+				string errmsg{"Input file not found."};
+				std::error_code ec;
+				throw fsys::filesystem_error(errmsg, reqpath, ec);
+			}
+		}
+
+		MappedFile cfile(ifilepath);
+		lines.clear();
+
+		if( pattern_trigrams.empty() ) {
+			findMatchingLines(cfile.data(), 0, cfile.size(), pattern, &lines);
+		}
+		else {
+			MappedFile tgifile(tgipath);
+			LineIndexReader line_index(lidxpath, ifilepath);
+
+			TrigramIndexHeader header{};
+			if( tgifile.size() >= sizeof(header) ) {
+				std::memcpy(&header, tgifile.data(), sizeof(header));
+			}
+			if( (tgifile.size() < sizeof(header)) or
+			    (not std::equal(std::begin(TRIGRAM_INDEX_MAGIC), std::end(TRIGRAM_INDEX_MAGIC), header.magic)) or
+			    (header.version != TRIGRAM_INDEX_VERSION) or
+			    (header.term_table_pos < sizeof(header)) or (header.term_table_pos > tgifile.size()) or
+			    (header.num_terms > (tgifile.size() - header.term_table_pos) / sizeof(TrigramTerm)) or
+			    (header.num_lines != line_index.numLines()) or
+			    (not matchesCipherFile(header.cipher_stamp, ifilepath)) )
+			{
+				throw std::runtime_error(std::format("\nInvalid or stale trigram index file ({}).\n", tgipath.string()));
+			}
+
+			// term table entries of the pattern trigrams (binary search over the
+			//   mapped table, which need not be aligned), shortest posting list first
+			auto read_term = [&](uint64_t term_number) {
+				TrigramTerm term{};
+				std::memcpy(&term, tgifile.data() + header.term_table_pos + term_number * sizeof(TrigramTerm), sizeof(term));
+				return(term);
+			};
+
+			std::vector<TrigramTerm> query_terms;
+			for(uint32_t trigram : pattern_trigrams) {
+				uint64_t low = 0, high = header.num_terms;
+				while( low < high ) {
+					uint64_t mid = low + (high - low) / 2;
+					if( read_term(mid).trigram < trigram ) { low = mid + 1; }
+					else { high = mid; }
+				}
+
+				if( (low == header.num_terms) or (read_term(low).trigram != trigram) ) {
+					query_terms.clear();
+					break;
+				}
+				query_terms.push_back(read_term(low));
+			}
+			std::sort(query_terms.begin(), query_terms.end(),
+				[](const TrigramTerm& a, const TrigramTerm& b){ return(a.num_postings < b.num_postings); });
+
+			// decode and intersect the posting lists
+			auto decode_postings = [&](const TrigramTerm& term, std::vector<uint64_t>* values) {
+				const unsigned char* pos = reinterpret_cast<const unsigned char*>(tgifile.data()) + sizeof(header) + term.postings_pos;
+				const unsigned char* end = reinterpret_cast<const unsigned char*>(tgifile.data()) + header.term_table_pos;
+				uint64_t line = 0;
+				values->clear();
+				for(uint32_t n = 0; n < term.num_postings; ++n) {
+					line += readVarint(pos, end);
+					values->push_back(line);
+				}
+			};
+
+			candidates.clear();
+			for(size_t t = 0; t < query_terms.size(); ++t) {
+				if( t == 0 ) {
+					decode_postings(query_terms[t], &candidates);
+					continue;
+				}
+
+				decode_postings(query_terms[t], &postings);
+				merged.clear();
+				std::set_intersection(candidates.begin(), candidates.end(), 
+				                      postings.begin(), postings.end(), std::back_inserter(merged));
+				candidates.swap(merged);
+				if( candidates.empty() ) {
+					break;
+				}
+			}
+
+			// verify the candidate lines against the whole pattern
+			for(uint64_t line : candidates) {
+				if( line >= line_index.numLines() ) {
+					throw std::runtime_error(std::format("\nInvalid or stale trigram index file ({}).\n", tgipath.string()));
+				}
+
+				size_t line_start = std::min<size_t>(line_index.lineOffset(line), cfile.size());
+				size_t line_end = ( line + 1 < line_index.numLines() ) 
+					? std::min<size_t>(line_index.lineOffset(line + 1), cfile.size()) : cfile.size();
+				if( (line_end > line_start) and (cfile.data()[line_end - 1] == '\n') ) {
+					--line_end;
+				}
+
+				if( findCipherPattern(cfile.data() + line_start, line_end - line_start, pattern) < line_end - line_start ) {
+					lines.emplace_back(line_start, line_end);
+				}
+			}
+		}
+
+		for(const auto& [line_start, line_end] : lines) {
+			decipherSpan(decopts.cipher_dict, cfile.data() + line_start, line_end - line_start, &outstr);
+			ciphopts->nbytes_file += line_end - line_start;
+
+			if( show_filename ) {
+				ostrm << fname << ':';
+			}
+			ostrm << outstr << '\n';
+
+			outstr.clear();
+		}
+	}
+	ostrm.flush();
+
+	return;
+}
+
+/*
+ * Description:
+ * Shared body of hashCipherWord and hashCipherWords. The last chunk of a
+ *   word holds its final 1 to 8 bytes (a full last chunk hashes the same
+ *   either way), so words of up to 8 bytes skip the loop. When padded is set
+ *   that chunk is read as a full 8 bytes and the bytes past the word masked
+ *   off, instead of copied byte by byte (little-endian only, elsewhere the
+ *   copy is kept).
+ */
+inline uint64_t hashCipherWordChunks(const char* word, size_t nbytes, bool padded) noexcept
+{
+	const uint64_t fold = 0x2020202020202020ULL;
+	const uint64_t mult = 0x9E3779B97F4A7C15ULL;
+
+	uint64_t hash = nbytes * mult;
+	size_t n = 0;
+	for(; n + 8 < nbytes; n += 8) {
+		uint64_t chunk = 0;
+		std::memcpy(&chunk, word + n, 8);
+		hash = (hash ^ (chunk | fold)) * mult;
+		hash ^= hash >> 32;
+	}
+
+	if( n < nbytes ) {
+		const size_t tail = nbytes - n;
+		uint64_t chunk = 0;
+		if( padded and (std::endian::native == std::endian::little) ) {
+			std::memcpy(&chunk, word + n, 8);
+			chunk &= ~uint64_t{0} >> (8 * (8 - tail));
+		}
+		else {
+			std::memcpy(&chunk, word + n, tail);
+		}
+		hash = (hash ^ (chunk | (fold >> (8 * (8 - tail))))) * mult;
+		hash ^= hash >> 32;
+	}
+
+	// final avalanche so that all bits of the probes depend on every byte
+	hash ^= hash >> 29;
+	hash *= 0xBF58476D1CE4E5B9ULL;
+	hash ^= hash >> 32;
+
+	return(hash);
+}
+
+/*
+ * Description:
+ * Hashes one enciphered word (a run of letters and digits) eight bytes at a
+ *   time. Setting bit 0x20 of every byte lowercases the letters and leaves
+ *   the digits unchanged, so the hash is case-insensitive without a per-byte
+ *   branch.
+ *
+ * Input:
+ * word   -> first byte of the word
+ * nbytes -> length of the word
+ *
+ * Output:
+ * 64-bit hash
+ */
+uint64_t hashCipherWord(const char* word, size_t nbytes) noexcept
+{
+	return(hashCipherWordChunks(word, nbytes, false));
+}
+
+/*
+ * Description:
+ * Hashes the words of a buffer in one pass, giving the same values as
+ *   hashCipherWord. The buffer must stay readable for 8 bytes past the end
+ *   of its last word.
+ *
+ * Input:
+ * text   -> buffer holding the words
+ * words  -> (offset, length) of each word, as from tokenizeCipherWords
+ * hashes -> (output) one hash per word
+ *
+ * Output:
+ * None
+ */
+void hashCipherWords(const char* text, const std::vector<std::pair<uint32_t,uint32_t>>& words, uint64_t* hashes) noexcept
+{
+	for(size_t w = 0; w < words.size(); ++w) {
+		hashes[w] = hashCipherWordChunks(text + words[w].first, words[w].second, true);
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Sets (or tests) the BLOOM_NUM_HASHES bits of a hash in a filter whose size
+ *   is a power of 2, deriving the probes from the two halves of the hash.
+ */
+void addToBloomFilter(std::vector<unsigned char>* bits, uint64_t hash) noexcept
+{
+	const uint64_t mask = bits->size() * 8 - 1;
+	const uint64_t step = ((hash >> 32) | (hash << 32)) | 1;
+	for(uint32_t k = 0; k < BLOOM_NUM_HASHES; ++k, hash += step) {
+		(*bits)[(hash & mask) >> 3] |= static_cast<unsigned char>(1u << (hash & 7));
+	}
+
+	return;
+}
+
+bool bloomFilterMayContain(const unsigned char* bits, uint64_t nbits, uint64_t hash) noexcept
+{
+	const uint64_t mask = nbits - 1;
+	const uint64_t step = ((hash >> 32) | (hash << 32)) | 1;
+	for(uint32_t k = 0; k < BLOOM_NUM_HASHES; ++k, hash += step) {
+		if( (bits[(hash & mask) >> 3] & (1u << (hash & 7))) == 0 ) {
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+/*
+ * Description:
+ * Opens the sidecar, writes a placeholder header (completed by finish())
+ *   and starts the filtering workers.
+ *
+ * Input:
+ * bloompath -> path of the Bloom filter sidecar (overwritten if exists)
+ * nworkers  -> number of worker threads filtering blocks (0 filters each
+ *              block in place as it is closed)
+ */
+BloomIndexWriter::BloomIndexWriter(const fsys::path& bloompath, unsigned nworkers)
+	: bloomfile(bloompath, std::ios::binary | std::ios::trunc), scratches(std::max(1u, nworkers))
+{
+	if( not bloomfile ) {
+		string errmsg{"Unable to create Bloom filter file."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, bloompath, ec);
+	}
+
+	BloomIndexHeader header{};
+	bloomfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	block_text.reserve(BLOOM_BLOCK_BYTES + 8);
+	for(size_t w = 0; w < nworkers; ++w) {
+		workers.emplace_back(&BloomIndexWriter::workerLoop, this, w);
+	}
+}
+
+BloomIndexWriter::~BloomIndexWriter()
+{
+	stopWorkers();
+}
+
+/*
+ * Description:
+ * Appends an enciphered line to the current block and hands the block on
+ *   once it covers BLOOM_BLOCK_BYTES of the enciphered file.
+ */
+void BloomIndexWriter::addLine(const string& line, uint64_t line_offset)
+{
+	block_text.append(line);
+	block_text.push_back('\n');
+
+	block_end = line_offset + line.size() + 1;
+	if( block_end - block_begin >= BLOOM_BLOCK_BYTES ) {
+		submitBlock();
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Queues the current block. Blocks while the queue already holds two blocks
+ *   per worker so a slow filter cannot make memory use grow without bound.
+ *   Without workers the block is filtered straight away.
+ */
+void BloomIndexWriter::submitBlock()
+{
+	if( block_end == block_begin ) {
+		return;
+	}
+
+	ClosedBlock block{std::move(block_text), num_blocks++, block_begin, block_end};
+	block_begin = block_end;
+
+	if( workers.empty() ) {
+		closeBlock(&block, &scratches[0]);
+		block_text = std::move(block.text);
+		block_text.clear();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	queue_cv.wait(lock, [this]{ return(queue.size() < 2 * workers.size()); });
+	queue.push_back(std::move(block));
+	lock.unlock();
+	queue_cv.notify_all();
+
+	block_text = string();
+	block_text.reserve(BLOOM_BLOCK_BYTES + 8);
+
+	return;
+}
+
+void BloomIndexWriter::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		closing = true;
+	}
+	queue_cv.notify_all();
+
+	for(std::thread& worker : workers) {
+		if( worker.joinable() ) {
+			worker.join();
+		}
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Worker thread: takes closed blocks off the queue and filters them.
+ *
+ * Input:
+ * worker_number -> index of this worker's scratch space
+ */
+void BloomIndexWriter::workerLoop(size_t worker_number)
+{
+	while( true ) {
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		queue_cv.wait(lock, [this]{ return(closing or not queue.empty()); });
+		if( queue.empty() ) {
+			return;
+		}
+
+		ClosedBlock block = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+		queue_cv.notify_all();
+
+		closeBlock(&block, &scratches[worker_number]);
+	}
+}
+
+/*
+ * Description:
+ * Adds hashes to an open-addressing set, appending those not already in it
+ *   to distinct and doubling the table at half load. The slot of the hash
+ *   BLOOM_PREFETCH_AHEAD places ahead is prefetched, so the cache misses of
+ *   a large vocabulary overlap instead of stalling one word at a time.
+ */
+void BloomIndexWriter::insertDistinct(std::vector<uint64_t>* table, std::vector<uint64_t>* distinct,
+                                      const std::vector<uint64_t>& hashes)
+{
+	size_t mask = table->size() - 1;
+	for(size_t h = 0; h < hashes.size(); ++h) {
+		if( h + BLOOM_PREFETCH_AHEAD < hashes.size() ) {
+			__builtin_prefetch(table->data() + (hashes[h + BLOOM_PREFETCH_AHEAD] & mask));
+		}
+
+		const uint64_t hash = hashes[h];
+		size_t slot = static_cast<size_t>(hash) & mask;
+		while( ((*table)[slot] != 0) and ((*table)[slot] != hash) ) {
+			slot = (slot + 1) & mask;
+		}
+		if( (*table)[slot] == hash ) {
+			continue;
+		}
+
+		(*table)[slot] = hash;
+		distinct->push_back(hash);
+		if( distinct->size() * 2 > table->size() ) {
+			table->assign(table->size() * 2, 0);
+			mask = table->size() - 1;
+			for(uint64_t value : *distinct) {
+				slot = static_cast<size_t>(value) & mask;
+				while( (*table)[slot] != 0 ) {
+					slot = (slot + 1) & mask;
+				}
+				(*table)[slot] = value;
+			}
+		}
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Builds a filter sized at BLOOM_BITS_PER_WORD bits per distinct hash
+ *   (rounded up to a power of 2).
+ */
+std::vector<unsigned char> BloomIndexWriter::buildFilter(const std::vector<uint64_t>& distinct)
+{
+	uint64_t nbits = 64;
+	while( nbits < distinct.size() * BLOOM_BITS_PER_WORD ) {
+		nbits *= 2;
+	}
+
+	std::vector<unsigned char> bits(nbits / 8, 0);
+	for(uint64_t hash : distinct) {
+		addToBloomFilter(&bits, hash);
+	}
+
+	return(bits);
+}
+
+/*
+ * Description:
+ * Finds and hashes the words of a closed block and builds its filter, then
+ *   waits for the blocks before it to be committed before writing the
+ *   filter, recording it in the block table and adding the block's words to
+ *   those of the whole file.
+ *
+ * Input:
+ * block   -> the closed block (its text is padded here)
+ * scratch -> space for the words and hashes of the block
+ */
+void BloomIndexWriter::closeBlock(ClosedBlock* block, BlockScratch* scratch)
+{
+	// the text is padded for the 8-byte reads of hashCipherWords
+	const size_t text_bytes = block->text.size();
+	block->text.append(8, '\0');
+
+	scratch->words.clear();
+	tokenizeCipherWords(block->text.data(), text_bytes, &scratch->words);
+
+	scratch->hashes.resize(scratch->words.size());
+	hashCipherWords(block->text.data(), scratch->words, scratch->hashes.data());
+	for(uint64_t& hash : scratch->hashes) {
+		hash = ( hash == 0 ) ? 1 : hash;  // 0 marks a free slot
+	}
+
+	insertDistinct(&scratch->table, &scratch->distinct, scratch->hashes);
+	std::vector<unsigned char> bits = buildFilter(scratch->distinct);
+
+	{
+		std::unique_lock<std::mutex> lock(commit_mutex);
+		commit_cv.wait(lock, [&]{ return(next_commit == block->number); });
+
+		bloomfile.write(reinterpret_cast<const char*>(bits.data()), static_cast<std::streamsize>(bits.size()));
+		block_table.insert(block_table.end(), {block->begin, block->end, filters_pos, bits.size() * 8});
+		filters_pos += bits.size();
+
+		insertDistinct(&file_hashes, &file_distinct, scratch->distinct);
+		++next_commit;
+	}
+	commit_cv.notify_all();
+
+	std::fill(scratch->table.begin(), scratch->table.end(), 0);
+	scratch->distinct.clear();
+
+	return;
+}
+
+/*
+ * Description:
+ * Hands over the last block and waits for the workers, then writes the
+ *   whole-file filter and the block table and completes the header. Throws
+ *   std::runtime_error if the sidecar could not be written completely.
+ *
+ * Input:
+ * cipherpath -> the enciphered file the filters describe, complete and closed
+ */
+void BloomIndexWriter::finish(const fsys::path& cipherpath)
+{
+	submitBlock();
+	stopWorkers();
+
+	std::vector<unsigned char> bits = buildFilter(file_distinct);
+	bloomfile.write(reinterpret_cast<const char*>(bits.data()), static_cast<std::streamsize>(bits.size()));
+
+	BloomIndexHeader header{};
+	std::copy(std::begin(BLOOM_INDEX_MAGIC), std::end(BLOOM_INDEX_MAGIC), header.magic);
+	header.version          = BLOOM_INDEX_VERSION;
+	header.num_hashes       = BLOOM_NUM_HASHES;
+	header.num_blocks       = block_table.size() / 4;
+	header.file_filter_pos  = filters_pos;
+	header.file_filter_bits = bits.size() * 8;
+	header.block_table_pos  = sizeof(header) + filters_pos + bits.size();
+	header.cipher_stamp     = stampCipherFile(cipherpath);
+
+	bloomfile.write(reinterpret_cast<const char*>(block_table.data()),
+	                static_cast<std::streamsize>(block_table.size() * sizeof(uint64_t)));
+	bloomfile.seekp(0);
+	bloomfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	bloomfile.close();
+
+	if( bloomfile.fail() ) {
+		throw std::runtime_error("\nFailed to write the Bloom filter file.\n");
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Searches enciphered input files for plaintext words. The words are
+ *   enciphered and hashed once; a file whose IFILE.bloom file filter lacks
+ *   one of them is skipped without reading its ciphertext, otherwise only
+ *   the blocks whose filters may hold every word are scanned. Matches must
+ *   be whole words. Files without a sidecar are scanned completely. Files
+ *   are searched in parallel and matching lines printed deciphered in order.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND or a malformed sidecar)
+ */
+void searchBloomFiles(CipherOptions* ciphopts)
+{
+	if( ciphopts->infilenames.empty() ) {
+		throw std::invalid_argument("\nNo input file given for --bloom-search. See HELP with -h or --help option.\n");
+	}
+
+	for(const string& fname : ciphopts->infilenames) {
+		if( not fsys::exists(fsys::path(fname)) ) {
+			string errmsg{"Input file not found."};
+			std::error_code ec;
+			throw fsys::filesystem_error(errmsg, fsys::path(fname), ec);
+		}
+	}
+
+	CipherPattern pattern = encipherPattern(ciphopts);
+	pattern.whole_words = true;
+
+	CipherOptions decopts = *ciphopts;
+	decopts.decipher = true;
+	decopts.cipher_dict.clear();
+	generateCipherDict(&decopts);
+
+	// hashes of the enciphered words of the pattern
+	std::vector<uint64_t> word_hashes;
+	for(size_t n = 0; n < pattern.text.size(); ) {
+		size_t word_start = n;
+		while( (n < pattern.text.size()) and isCipherWordChar(pattern.text[n]) ) {
+			++n;
+		}
+
+		if( n > word_start ) {
+			uint64_t hash = hashCipherWord(pattern.text.data() + word_start, n - word_start);
+			word_hashes.push_back( (hash == 0) ? 1 : hash );  // as stored by BloomIndexWriter
+		}
+		else {
+			++n;
+		}
+	}
+
+	// per-file results filled in by the workers
+	struct BloomFileResult
+	{
+		std::unique_ptr<MappedFile> cfile;
+		std::vector<std::pair<size_t,size_t>> lines;
+		uint64_t blocks_total   = 0;
+		uint64_t blocks_scanned = 0;
+		std::exception_ptr error;
+	};
+	std::vector<BloomFileResult> results(ciphopts->infilenames.size());
+
+	auto search_file = [&](size_t file_number) {
+		const string& fname = ciphopts->infilenames[file_number];
+		BloomFileResult& result = results[file_number];
+		fsys::path bloompath( fname + BLOOM_INDEX_EXT );
+
+		if( not fsys::exists(bloompath) ) {
+			result.cfile = std::make_unique<MappedFile>(fsys::path(fname));
+			findMatchingLines(result.cfile->data(), 0, result.cfile->size(), pattern, &result.lines);
+			return;
+		}
+
+		MappedFile bloomfile(bloompath);
+		BloomIndexHeader header{};
+		if( bloomfile.size() >= sizeof(header) ) {
+			std::memcpy(&header, bloomfile.data(), sizeof(header));
+		}
+
+		auto valid_filter = [&](uint64_t pos, uint64_t nbits) {
+			return( (nbits >= 64) and ((nbits & (nbits - 1)) == 0) and
+			        (sizeof(header) + pos + nbits / 8 <= header.block_table_pos) );
+		};
+		if( (bloomfile.size() < sizeof(header)) or
+		    (not std::equal(std::begin(BLOOM_INDEX_MAGIC), std::end(BLOOM_INDEX_MAGIC), header.magic)) or
+		    (header.version != BLOOM_INDEX_VERSION) or (header.num_hashes != BLOOM_NUM_HASHES) or
+		    (header.block_table_pos > bloomfile.size()) or
+		    (header.num_blocks > (bloomfile.size() - header.block_table_pos) / (4 * sizeof(uint64_t))) or
+		    (not valid_filter(header.file_filter_pos, header.file_filter_bits)) )
+		{
+			throw std::runtime_error(std::format("\nInvalid Bloom filter file ({}).\n", bloompath.string()));
+		}
+		if( not matchesCipherFile(header.cipher_stamp, fsys::path(fname)) ) {
+			throw std::runtime_error(std::format(
+				"\nThe Bloom filter file {} is out of date ({} has changed since it was written).\n",
+				bloompath.string(), fname));
+		}
+
+		const unsigned char* filters = reinterpret_cast<const unsigned char*>(bloomfile.data()) + sizeof(header);
+		auto may_contain_words = [&](uint64_t pos, uint64_t nbits) {
+			for(uint64_t hash : word_hashes) {
+				if( not bloomFilterMayContain(filters + pos, nbits, hash) ) {
+					return(false);
+				}
+			}
+			return(true);
+		};
+
+		result.blocks_total = header.num_blocks;
+		if( not may_contain_words(header.file_filter_pos, header.file_filter_bits) ) {
+			return;
+		}
+
+		result.cfile = std::make_unique<MappedFile>(fsys::path(fname));
+		for(uint64_t b = 0; b < header.num_blocks; ++b) {
+			uint64_t entry[4] = {0, 0, 0, 0};
+			std::memcpy(entry, bloomfile.data() + header.block_table_pos + b * sizeof(entry), sizeof(entry));
+			if( (not valid_filter(entry[2], entry[3])) or (entry[0] > entry[1]) or (entry[1] > result.cfile->size()) ) {
+				throw std::runtime_error(std::format("\nInvalid or stale Bloom filter file ({}).\n", bloompath.string()));
+			}
+
+			if( may_contain_words(entry[2], entry[3]) ) {
+				++result.blocks_scanned;
+				findMatchingLines(result.cfile->data(), entry[0], entry[1], pattern, &result.lines);
+			}
+		}
+	};
+
+	// search the files in parallel
+	std::atomic<size_t> next_file{0};
+	auto bloom_worker = [&]() {
+		for(size_t f = next_file++; f < results.size(); f = next_file++) {
+			try {
+				search_file(f);
+			}
+			catch( ... ) {
+				results[f].error = std::current_exception();
+			}
+		}
+	};
+
+	const unsigned nthreads = resolveThreadCount(ciphopts);
+	std::vector<std::thread> workers;
+	for(unsigned t = 1; t < std::min<size_t>(nthreads, results.size()); ++t) {
+		workers.emplace_back(bloom_worker);
+	}
+	bloom_worker();
+	for(std::thread& worker : workers) {
+		worker.join();
+	}
+
+	// decipher and print the matching lines in file order
+	std::ofstream ofile;
+	if( not ciphopts->use_default_oname ) {
+		ofile.open(fsys::path(ciphopts->outfilename));
+	}
+	std::ostream& ostrm = ofile.is_open() ? static_cast<std::ostream&>(ofile) : cout;
+
+	const bool show_filename = ciphopts->infilenames.size() > 1;
+	uint64_t blocks_total = 0, blocks_scanned = 0;
+	string outstr;
+	for(size_t f = 0; f < results.size(); ++f) {
+		if( results[f].error ) {
+			std::rethrow_exception(results[f].error);
+		}
+
+		blocks_total   += results[f].blocks_total;
+		blocks_scanned += results[f].blocks_scanned;
+		for(const auto& [line_start, line_end] : results[f].lines) {
+			decipherSpan(decopts.cipher_dict, results[f].cfile->data() + line_start, line_end - line_start, &outstr);
+			ciphopts->nbytes_file += line_end - line_start;
+
+			if( show_filename ) {
+				ostrm << ciphopts->infilenames[f] << ':';
+			}
+			ostrm << outstr << '\n';
+
+			outstr.clear();
+		}
+	}
+	ostrm.flush();
+
+	if( ciphopts->display_log_info ) {
+		cout << std::format("\nBloom filters: scanned {:d} of {:d} indexed blocks.", blocks_scanned, blocks_total) << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Helpers for compactLetters. A byte is a letter exactly when (byte | 0x20)
+ *   - 'a' is below 26, which also gives its case-folded alphabet index. The
+ *   vector versions classify a whole register at once and left-pack the
+ *   indices of the letters (AVX-512 VBMI2 compress, or SSSE3 pshufb with a
+ *   table of byte positions for each 8-bit mask); the scalar version is
+ *   branch-free and handles the tails.
+ */
+size_t compactLettersScalar(const char* text, size_t nbytes, uint8_t* out) noexcept
+{
+	size_t count = 0;
+	for(size_t n = 0; n < nbytes; ++n) {
+		uint8_t index = static_cast<uint8_t>((static_cast<uint8_t>(text[n]) | 0x20) - 'a');
+		out[count] = index;
+		count += ( index < 26 ) ? 1 : 0;
+	}
+
+	return(count);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx512f,avx512bw,avx512vbmi2")))
+size_t compactLettersAVX512(const char* text, size_t nbytes, uint8_t* out) noexcept
+{
+	const __m512i fold   = _mm512_set1_epi8(0x20);
+	const __m512i base   = _mm512_set1_epi8('a');
+	const __m512i limit  = _mm512_set1_epi8(26);
+
+	size_t count = 0, n = 0;
+	for(; n + 64 <= nbytes; n += 64) {
+		__m512i bytes = _mm512_loadu_si512(text + n);
+		__m512i index = _mm512_sub_epi8(_mm512_or_si512(bytes, fold), base);
+		__mmask64 is_letter = _mm512_cmplt_epu8_mask(index, limit);
+
+		_mm512_storeu_si512(out + count, _mm512_maskz_compress_epi8(is_letter, index));
+		count += static_cast<size_t>(std::popcount(static_cast<uint64_t>(is_letter)));
+	}
+
+	return(count + compactLettersScalar(text + n, nbytes - n, out + count));
+}
+
+__attribute__((target("ssse3,popcnt")))
+size_t compactLettersSSSE3(const char* text, size_t nbytes, uint8_t* out) noexcept
+{
+	// positions of the set bits of every 8-bit mask, as pshufb indices
+	static const auto pack_table = []() {
+		std::array<std::array<uint8_t,8>,256> table{};
+		for(unsigned mask = 0; mask < 256; ++mask) {
+			unsigned count = 0;
+			for(unsigned bit = 0; bit < 8; ++bit) {
+				if( mask & (1u << bit) ) {
+					table[mask][count++] = static_cast<uint8_t>(bit);
+				}
+			}
+		}
+		return(table);
+	}();
+
+	const __m128i fold  = _mm_set1_epi8(0x20);
+	const __m128i base  = _mm_set1_epi8('a');
+	const __m128i last  = _mm_set1_epi8(25);
+	const __m128i upper = _mm_set1_epi8(8);
+
+	size_t count = 0, n = 0;
+	for(; n + 16 <= nbytes; n += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + n));
+		__m128i index = _mm_sub_epi8(_mm_or_si128(bytes, fold), base);
+		__m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(index, last), index);
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(is_letter));
+
+		__m128i shuf_lo = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pack_table[mask & 0xFF].data()));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + count), _mm_shuffle_epi8(index, shuf_lo));
+		count += static_cast<size_t>(std::popcount(mask & 0xFF));
+
+		__m128i shuf_hi = _mm_add_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pack_table[mask >> 8].data())), upper);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + count), _mm_shuffle_epi8(index, shuf_hi));
+		count += static_cast<size_t>(std::popcount(mask >> 8));
+	}
+
+	return(count + compactLettersScalar(text + n, nbytes - n, out + count));
+}
+#endif
+
+/*
+ * Description:
+ * Strips text down to its letters in a single vectorized pass, appending
+ *   their case-folded alphabet indices (A/a = 0 ... Z/z = 25).
+ *
+ * Input:
+ * text    -> text to compact
+ * nbytes  -> number of bytes of text
+ * letters -> (output) vector the indices are appended to
+ *
+ * Output:
+ * None
+ */
+void compactLetters(const char* text, size_t nbytes, std::vector<uint8_t>* letters)
+{
+	// the vector versions store whole registers, so leave room past the end
+	const size_t prev_size = letters->size();
+	letters->resize(prev_size + nbytes + 64);
+	uint8_t* out = letters->data() + prev_size;
+
+	size_t count = 0;
+#if defined(__x86_64__)
+	static const bool has_avx512 = __builtin_cpu_supports("avx512vbmi2") and __builtin_cpu_supports("avx512bw");
+	static const bool has_ssse3  = __builtin_cpu_supports("ssse3");
+	if( has_avx512 ) {
+		count = compactLettersAVX512(text, nbytes, out);
+	}
+	else if( has_ssse3 ) {
+		count = compactLettersSSSE3(text, nbytes, out);
+	}
+	else {
+		count = compactLettersScalar(text, nbytes, out);
+	}
+#else
+	count = compactLettersScalar(text, nbytes, out);
+#endif
+
+	letters->resize(prev_size + count);
+	return;
+}
+
+/*
+ * Description:
+ * Chi-squared distance between the letter distribution of a text deciphered
+ *   with a shift and English letter frequencies (smaller is more English).
+ *
+ * Input:
+ * counts -> letter counts of the ciphertext (A/a = 0 ... Z/z = 25)
+ * shift  -> shift the ciphertext was enciphered with (0-25)
+ *
+ * Output:
+ * Chi-squared statistic
+ */
+double chiSquaredEnglish(const std::array<uint64_t,26>& counts, int shift) noexcept
+{
+	uint64_t total = 0;
+	for(uint64_t count : counts) {
+		total += count;
+	}
+	if( total == 0 ) {
+		return(0.0);
+	}
+
+	double chi_squared = 0.0;
+	for(int n = 0; n < 26; ++n) {
+		double expected = static_cast<double>(total) * ENGLISH_LETTER_FREQS[static_cast<size_t>(n)];
+		double diff = static_cast<double>(counts[static_cast<size_t>((n + shift) % 26)]) - expected;
+		chi_squared += diff * diff / expected;
+	}
+
+	return(chi_squared);
+}
+
+/*
+ * Description:
+ * Adds the letter counts of a text to a histogram. Bytes are counted into
+ *   four interleaved 256-entry tables so that runs of the same byte do not
+ *   serialise on one counter, then the letters of both cases are folded.
+ *
+ * Input:
+ * text   -> text to count
+ * nbytes -> number of bytes of text
+ * counts -> (output) letter counts to add to
+ *
+ * Output:
+ * None
+ */
+void countLetters(const char* text, size_t nbytes, std::array<uint64_t,26>* counts) noexcept
+{
+	std::array<std::array<uint32_t,256>,4> tables{};
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+
+	while( nbytes > 0 ) {
+		// 32-bit counters cannot overflow within one round
+		size_t round = std::min<size_t>(nbytes, size_t{1} << 30);
+		size_t n = 0;
+		for(; n + 4 <= round; n += 4) {
+			++tables[0][bytes[n]];
+			++tables[1][bytes[n + 1]];
+			++tables[2][bytes[n + 2]];
+			++tables[3][bytes[n + 3]];
+		}
+		for(; n < round; ++n) {
+			++tables[0][bytes[n]];
+		}
+
+		for(size_t letter = 0; letter < 26; ++letter) {
+			for(const std::array<uint32_t,256>& table : tables) {
+				(*counts)[letter] += table['A' + letter] + table['a' + letter];
+			}
+		}
+
+		for(std::array<uint32_t,256>& table : tables) {
+			table.fill(0);
+		}
+		bytes  += round;
+		nbytes -= round;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Log-likelihood of ciphertext letter counts, deciphered with a shift, as
+ *   letters drawn independently with English frequencies.
+ *
+ * Input:
+ * counts -> letter counts of the ciphertext (A/a = 0 ... Z/z = 25)
+ * shift  -> shift the ciphertext was enciphered with (0-25)
+ *
+ * Output:
+ * Natural-log likelihood (larger is more English)
+ */
+double logLikelihoodEnglish(const std::array<uint64_t,26>& counts, int shift) noexcept
+{
+	static const auto log_freqs = []() {
+		std::array<double,26> values{};
+		for(size_t n = 0; n < 26; ++n) {
+			values[n] = std::log(ENGLISH_LETTER_FREQS[n]);
+		}
+		return(values);
+	}();
+
+	double log_likelihood = 0.0;
+	for(size_t n = 0; n < 26; ++n) {
+		log_likelihood += static_cast<double>(counts[(n + static_cast<size_t>(shift)) % 26]) * log_freqs[n];
+	}
+
+	return(log_likelihood);
+}
+
+/*
+ * Description:
+ * Scores all 26 shifts of a set of ciphertext letter counts and keeps the
+ *   best and second best. The raw chi-squared margin grows without bound
+ *   (rare letters have tiny expected counts), so the confidence is taken
+ *   from the letter counts' likelihood under each shift instead: the
+ *   posterior probability of the best shift with all shifts equally likely.
+ *
+ * Input:
+ * counts -> ciphertext letter counts
+ *
+ * Output:
+ * Best and runner-up shifts, their scores and the confidence
+ */
+ShiftEstimate estimateShift(const std::array<uint64_t,26>& counts) noexcept
+{
+	ShiftEstimate estimate;
+	estimate.best_score      = chiSquaredEnglish(counts, 0);
+	estimate.runner_up_shift = 1;
+	estimate.runner_up_score = chiSquaredEnglish(counts, 1);
+	if( estimate.runner_up_score < estimate.best_score ) {
+		std::swap(estimate.best_shift, estimate.runner_up_shift);
+		std::swap(estimate.best_score, estimate.runner_up_score);
+	}
+
+	for(int shift = 2; shift < 26; ++shift) {
+		double score = chiSquaredEnglish(counts, shift);
+		if( score < estimate.best_score ) {
+			estimate.runner_up_shift = estimate.best_shift;
+			estimate.runner_up_score = estimate.best_score;
+			estimate.best_shift = shift;
+			estimate.best_score = score;
+		}
+		else if( score < estimate.runner_up_score ) {
+			estimate.runner_up_shift = shift;
+			estimate.runner_up_score = score;
+		}
+	}
+
+	std::array<double,26> log_likelihood{};
+	for(int shift = 0; shift < 26; ++shift) {
+		log_likelihood[static_cast<size_t>(shift)] = logLikelihoodEnglish(counts, shift);
+	}
+
+	double posterior_sum = 0.0;
+	for(double value : log_likelihood) {
+		posterior_sum += std::exp(value - log_likelihood[static_cast<size_t>(estimate.best_shift)]);
+	}
+	estimate.confidence = 1.0 / posterior_sum;
+
+	return(estimate);
+}
+
+/*
+ * Description:
+ * Opens a quadgram model written by buildQuadgramModel. The file is mapped
+ *   read-only, so the table costs no parsing and is shared between
+ *   processes; the header is checked before the table is used.
+ *
+ * Input:
+ * modelpath -> quadgram model file
+ */
+QuadgramModel::QuadgramModel(const fsys::path& modelpath) :
+	modelfile(modelpath)
+{
+	if( modelfile.size() >= sizeof(header) ) {
+		std::memcpy(&header, modelfile.data(), sizeof(header));
+	}
+
+	if( (modelfile.size() != sizeof(header) + QUADGRAM_COUNT * sizeof(int16_t) + 2) or
+	    (not std::equal(std::begin(QUADGRAM_MODEL_MAGIC), std::end(QUADGRAM_MODEL_MAGIC), header.magic)) or
+	    (header.version != QUADGRAM_MODEL_VERSION) or (header.num_entries != QUADGRAM_COUNT) or
+	    (header.scale <= 0) )
+	{
+		throw std::runtime_error(std::format("\nInvalid quadgram model file ({}).\n", modelpath.string()));
+	}
+
+	// the header keeps the table 8-byte aligned within the page-aligned mapping
+	scores = reinterpret_cast<const int16_t*>(modelfile.data() + sizeof(header));
+}
+
+/*
+ * Description:
+ * Builds a quadgram language model from an English corpus (IFILE). The
+ *   corpus is compacted to its letters (quadgrams run across spaces and
+ *   punctuation) and every quadgram counted; each of the 26^4 entries then
+ *   holds its log10 probability in fixed point, with quadgrams the corpus
+ *   lacks scored as if seen 0.01 times. The model goes to OFILE, or
+ *   IFILE.qgm by default.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void buildQuadgramModel(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	if( ciphopts->use_default_oname ) {
+		ciphopts->outfilename = ciphopts->infilename + QUADGRAM_MODEL_EXT;
+	}
+
+	MappedFile corpus(ifilepath);
+	std::vector<uint64_t> counts(QUADGRAM_COUNT, 0);
+	std::vector<uint8_t> letters;
+	uint64_t total = 0;
+
+	// the last three letters of a chunk start quadgrams ending in the next
+	for(size_t pos = 0; pos < corpus.size(); pos += CRACK_CHUNK_BYTES) {
+		if( letters.size() > 3 ) {
+			letters.erase(letters.begin(), letters.end() - 3);
+		}
+		compactLetters(corpus.data() + pos, std::min(CRACK_CHUNK_BYTES, corpus.size() - pos), &letters);
+
+		for(size_t n = 0; n + 3 < letters.size(); ++n) {
+			++counts[((letters[n] * 26u + letters[n + 1]) * 26u + letters[n + 2]) * 26u + letters[n + 3]];
+		}
+		total += ( letters.size() > 3 ) ? letters.size() - 3 : 0;
+	}
+
+	if( total == 0 ) {
+		throw std::invalid_argument("\nToo few letters in the input file to build a quadgram model.\n");
+	}
+
+	QuadgramModelHeader header{};
+	std::copy(std::begin(QUADGRAM_MODEL_MAGIC), std::end(QUADGRAM_MODEL_MAGIC), header.magic);
+	header.version       = QUADGRAM_MODEL_VERSION;
+	header.num_entries   = QUADGRAM_COUNT;
+	header.scale         = QUADGRAM_SCALE;
+	header.num_quadgrams = total;
+
+	auto to_score = [total](double count) {
+		double score = std::round(QUADGRAM_SCALE * std::log10(count / static_cast<double>(total)));
+		return( static_cast<int16_t>(std::max(score, -32768.0)) );
+	};
+	header.floor_score = to_score(0.01);
+
+	std::vector<int16_t> scores(QUADGRAM_COUNT + 1, 0);
+	uint64_t distinct = 0;
+	for(size_t n = 0; n < QUADGRAM_COUNT; ++n) {
+		scores[n] = ( counts[n] > 0 ) ? to_score(static_cast<double>(counts[n])) : header.floor_score;
+		distinct += ( counts[n] > 0 ) ? 1 : 0;
+	}
+
+	fsys::path ofilepath( ciphopts->outfilename );
+	std::ofstream ofile(ofilepath, std::ios::binary | std::ios::trunc);
+	ofile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	ofile.write(reinterpret_cast<const char*>(scores.data()), static_cast<std::streamsize>(scores.size() * sizeof(int16_t)));
+	ofile.close();
+	if( not ofile ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to write quadgram model.", ofilepath, ec);
+	}
+	ciphopts->nbytes_file = corpus.size();
+
+	cout << endl;
+	cout << std::format("Quadgram model of {}", ciphopts->infilename) << endl;
+	cout << std::format("Quadgrams counted:  {:d}", total) << endl;
+	cout << std::format("Distinct quadgrams: {:d} of {:d}", distinct, QUADGRAM_COUNT) << endl;
+	cout << std::format("Unseen score:       {:.3f} (log10)", static_cast<double>(header.floor_score) / QUADGRAM_SCALE) << endl;
+	cout << std::format("Model written to:   {}", ciphopts->outfilename) << endl;
+	cout << endl;
+
+	return;
+}
+
+/*
+ * Description:
+ * Helpers for scoreQuadgramShifts: tables of the plaintext letter of every
+ *   ciphertext letter under shifts 0-31 (shifts past 25 fill out the vector
+ *   lanes and are ignored), already multiplied by the letter's place value
+ *   in a quadgram index, and a plain scalar scorer for CPUs without AVX2.
+ */
+struct QuadgramPlaceTables
+{
+	alignas(32) int32_t place[4][26][32];
+};
+
+const QuadgramPlaceTables& quadgramPlaceTables() noexcept
+{
+	static const QuadgramPlaceTables tables = []() {
+		QuadgramPlaceTables values{};
+		const int32_t weights[4] = {26 * 26 * 26, 26 * 26, 26, 1};
+		for(size_t p = 0; p < 4; ++p) {
+			for(int32_t letter = 0; letter < 26; ++letter) {
+				for(int32_t shift = 0; shift < 32; ++shift) {
+					values.place[p][letter][shift] = ((letter - shift + 52) % 26) * weights[p];
+				}
+			}
+		}
+		return(values);
+	}();
+
+	return(tables);
+}
+
+void scoreQuadgramShiftsScalar(const int16_t* table, const uint8_t* letters, size_t nletters,
+                               std::array<int64_t,26>* scores) noexcept
+{
+	const QuadgramPlaceTables& tables = quadgramPlaceTables();
+	for(size_t shift = 0; shift < 26; ++shift) {
+		int64_t sum = 0;
+		for(size_t n = 0; n + 3 < nletters; ++n) {
+			sum += table[tables.place[0][letters[n]][shift] + tables.place[1][letters[n + 1]][shift] +
+			             tables.place[2][letters[n + 2]][shift] + tables.place[3][letters[n + 3]][shift]];
+		}
+		(*scores)[shift] += sum;
+	}
+
+	return;
+}
+
+#if defined(__x86_64__)
+// all 26 shifts at once: each quadgram's 32 indices are built from the
+//   place tables in four 8-lane vectors and their scores gathered from the
+//   int16 table as 32-bit words (hence the padding after it) and sign
+//   extended; 32-bit sums are flushed to the 64-bit totals before they can
+//   overflow
+__attribute__((target("avx2")))
+void scoreQuadgramShiftsAVX2(const int16_t* table, const uint8_t* letters, size_t nletters,
+                             std::array<int64_t,26>* scores) noexcept
+{
+	const QuadgramPlaceTables& tables = quadgramPlaceTables();
+	const int* base = reinterpret_cast<const int*>(table);
+	const size_t flush_every = 32768;
+
+	size_t n = 0;
+	while( n + 3 < nletters ) {
+		__m256i sums[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+		const size_t stop = std::min(nletters - 3, n + flush_every);
+		for(; n < stop; ++n) {
+			const int32_t* place0 = tables.place[0][letters[n]];
+			const int32_t* place1 = tables.place[1][letters[n + 1]];
+			const int32_t* place2 = tables.place[2][letters[n + 2]];
+			const int32_t* place3 = tables.place[3][letters[n + 3]];
+			for(size_t v = 0; v < 4; ++v) {
+				__m256i index = _mm256_add_epi32(
+					_mm256_add_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(place0 + 8 * v)),
+					                 _mm256_load_si256(reinterpret_cast<const __m256i*>(place1 + 8 * v))),
+					_mm256_add_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(place2 + 8 * v)),
+					                 _mm256_load_si256(reinterpret_cast<const __m256i*>(place3 + 8 * v))));
+				__m256i words = _mm256_i32gather_epi32(base, index, 2);
+				sums[v] = _mm256_add_epi32(sums[v], _mm256_srai_epi32(_mm256_slli_epi32(words, 16), 16));
+			}
+		}
+
+		alignas(32) int32_t lanes[32];
+		for(size_t v = 0; v < 4; ++v) {
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 8 * v), sums[v]);
+		}
+		for(size_t shift = 0; shift < 26; ++shift) {
+			(*scores)[shift] += lanes[shift];
+		}
+	}
+
+	return;
+}
+#endif
+
+/*
+ * Description:
+ * Scores letters against a quadgram model as deciphered with each of the
+ *   26 shifts, in one pass over the letters for all shifts together.
+ *
+ * Input:
+ * model    -> quadgram language model
+ * letters  -> ciphertext letters (A/a = 0 ... Z/z = 25)
+ * nletters -> number of letters
+ * scores   -> (output) per-shift scores (table units) to add to
+ *
+ * Output:
+ * None
+ */
+void scoreQuadgramShifts(const QuadgramModel& model, const uint8_t* letters, size_t nletters,
+                         std::array<int64_t,26>* scores) noexcept
+{
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	if( has_avx2 ) {
+		scoreQuadgramShiftsAVX2(model.table(), letters, nletters, scores);
+		return;
+	}
+#endif
+	scoreQuadgramShiftsScalar(model.table(), letters, nletters, scores);
+
+	return;
+}
+
+/*
+ * Description:
+ * Scores plaintext letters against a quadgram model.
+ *
+ * Input:
+ * model    -> quadgram language model
+ * letters  -> plaintext letters (A/a = 0 ... Z/z = 25)
+ * nletters -> number of letters
+ *
+ * Output:
+ * Sum of the quadgram scores in table units (larger is more English)
+ */
+int64_t scoreQuadgrams(const QuadgramModel& model, const uint8_t* letters, size_t nletters) noexcept
+{
+	const int16_t* table = model.table();
+	int64_t sum = 0;
+	for(size_t n = 0; n + 3 < nletters; ++n) {
+		sum += table[((letters[n] * 26u + letters[n + 1]) * 26u + letters[n + 2]) * 26u + letters[n + 3]];
+	}
+
+	return(sum);
+}
+
+/*
+ * Description:
+ * Best and runner-up shifts from their quadgram scores. The scores are
+ *   log10 likelihoods, so the confidence is again the posterior
+ *   probability of the best shift with all shifts equally likely.
+ *
+ * Input:
+ * scores -> per-shift quadgram scores in table units
+ * scale  -> table units per log10
+ *
+ * Output:
+ * Best and runner-up shifts, their scores (log10) and the confidence
+ */
+ShiftEstimate estimateShiftQuadgrams(const std::array<int64_t,26>& scores, int32_t scale) noexcept
+{
+	ShiftEstimate estimate;
+	estimate.runner_up_shift = 1;
+	if( scores[1] > scores[0] ) {
+		std::swap(estimate.best_shift, estimate.runner_up_shift);
+	}
+
+	for(int shift = 2; shift < 26; ++shift) {
+		if( scores[static_cast<size_t>(shift)] > scores[static_cast<size_t>(estimate.best_shift)] ) {
+			estimate.runner_up_shift = estimate.best_shift;
+			estimate.best_shift = shift;
+		}
+		else if( scores[static_cast<size_t>(shift)] > scores[static_cast<size_t>(estimate.runner_up_shift)] ) {
+			estimate.runner_up_shift = shift;
+		}
+	}
+
+	const double units = static_cast<double>(scale);
+	estimate.best_score      = static_cast<double>(scores[static_cast<size_t>(estimate.best_shift)]) / units;
+	estimate.runner_up_score = static_cast<double>(scores[static_cast<size_t>(estimate.runner_up_shift)]) / units;
+
+	const double ln10 = std::log(10.0);
+	double posterior_sum = 0.0;
+	for(int64_t score : scores) {
+		posterior_sum += std::exp((static_cast<double>(score) / units - estimate.best_score) * ln10);
+	}
+	estimate.confidence = 1.0 / posterior_sum;
+
+	return(estimate);
+}
+
+/*
+ * Description:
+ * Helpers for tokenizeWords: a 64-bit mask of the letters among up to 64
+ *   bytes of text (bit n set for a letter at byte n), and the conversion of
+ *   consecutive masks into words. A word starts at a 0->1 change of the mask
+ *   and ends at the next 1->0 change, so only the changes are visited. With
+ *   digits set the masks also hold the digits, giving the words of
+ *   tokenizeCipherWords.
+ */
+inline uint64_t letterMaskScalar(const char* text, size_t nbytes) noexcept
+{
+	uint64_t mask = 0;
+	for(size_t n = 0; n < nbytes; ++n) {
+		uint8_t index = static_cast<uint8_t>((static_cast<uint8_t>(text[n]) | 0x20) - 'a');
+		mask |= static_cast<uint64_t>( index < 26 ) << n;
+	}
+
+	return(mask);
+}
+
+inline uint64_t digitMaskScalar(const char* text, size_t nbytes) noexcept
+{
+	uint64_t mask = 0;
+	for(size_t n = 0; n < nbytes; ++n) {
+		uint8_t index = static_cast<uint8_t>(static_cast<uint8_t>(text[n]) - '0');
+		mask |= static_cast<uint64_t>( index < 10 ) << n;
+	}
+
+	return(mask);
+}
+
+inline uint64_t wordMaskScalar(const char* text, size_t nbytes, bool digits) noexcept
+{
+	return( letterMaskScalar(text, nbytes) | ( digits ? digitMaskScalar(text, nbytes) : 0 ) );
+}
+
+inline void appendWordEdges(uint64_t mask, size_t base, bool* in_word, size_t* word_start,
+                            std::vector<std::pair<uint32_t,uint32_t>>* tokens)
+{
+	uint64_t edges = mask ^ ((mask << 1) | ( *in_word ? 1 : 0 ));
+	while( edges != 0 ) {
+		size_t pos = base + static_cast<size_t>(std::countr_zero(edges));
+		if( *in_word ) {
+			tokens->emplace_back(static_cast<uint32_t>(*word_start), static_cast<uint32_t>(pos - *word_start));
+		}
+		else {
+			*word_start = pos;
+		}
+		*in_word = not *in_word;
+		edges &= edges - 1;
+	}
+
+	return;
+}
+
+void tokenizeWordsScalar(const char* text, size_t nbytes, bool digits, std::vector<std::pair<uint32_t,uint32_t>>* tokens)
+{
+	bool in_word = false;
+	size_t word_start = 0;
+	for(size_t n = 0; n < nbytes; n += 64) {
+		appendWordEdges(wordMaskScalar(text + n, std::min<size_t>(64, nbytes - n), digits), n, &in_word, &word_start, tokens);
+	}
+	if( in_word ) {
+		tokens->emplace_back(static_cast<uint32_t>(word_start), static_cast<uint32_t>(nbytes - word_start));
+	}
+
+	return;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline uint32_t letterMaskAVX2(const char* text) noexcept
+{
+	const __m256i fold = _mm256_set1_epi8(0x20);
+	const __m256i base = _mm256_set1_epi8('a');
+	const __m256i last = _mm256_set1_epi8(25);
+	__m256i index = _mm256_sub_epi8(_mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text)), fold), base);
+
+	return( static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(index, last), index))) );
+}
+
+__attribute__((target("avx2")))
+inline uint32_t wordMaskAVX2(const char* text, bool digits) noexcept
+{
+	uint32_t mask = letterMaskAVX2(text);
+	if( digits ) {
+		const __m256i last = _mm256_set1_epi8(9);
+		__m256i index = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text)), _mm256_set1_epi8('0'));
+		mask |= static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(index, last), index)));
+	}
+
+	return(mask);
+}
+
+__attribute__((target("avx2")))
+void tokenizeWordsAVX2(const char* text, size_t nbytes, bool digits, std::vector<std::pair<uint32_t,uint32_t>>* tokens)
+{
+	bool in_word = false;
+	size_t word_start = 0;
+	size_t n = 0;
+	for(; n + 64 <= nbytes; n += 64) {
+		uint64_t mask = wordMaskAVX2(text + n, digits) | (static_cast<uint64_t>(wordMaskAVX2(text + n + 32, digits)) << 32);
+		appendWordEdges(mask, n, &in_word, &word_start, tokens);
+	}
+	if( n < nbytes ) {
+		appendWordEdges(wordMaskScalar(text + n, nbytes - n, digits), n, &in_word, &word_start, tokens);
+	}
+	if( in_word ) {
+		tokens->emplace_back(static_cast<uint32_t>(word_start), static_cast<uint32_t>(nbytes - word_start));
+	}
+
+	return;
+}
+#endif
+
+/*
+ * Description:
+ * Splits text into words (runs of letters) in a single vectorized pass over
+ *   64-byte letter masks. A shift maps letters to letters, so the words of a
+ *   ciphertext are those of every candidate decipherment.
+ *
+ * Input:
+ * text   -> text to split (at most 4 GiB)
+ * nbytes -> number of bytes of text
+ * tokens -> (output) vector the (offset, length) pairs are appended to
+ *
+ * Output:
+ * None
+ */
+void tokenizeWords(const char* text, size_t nbytes, std::vector<std::pair<uint32_t,uint32_t>>* tokens)
+{
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	if( has_avx2 ) {
+		tokenizeWordsAVX2(text, nbytes, false, tokens);
+		return;
+	}
+#endif
+	tokenizeWordsScalar(text, nbytes, false, tokens);
+
+	return;
+}
+
+/*
+ * Description:
+ * Splits enciphered text into the words hashed by the Bloom filters: runs
+ *   of letters and digits, found with the same 64-byte masks as tokenizeWords.
+ *
+ * Input:
+ * text   -> text to split (at most 4 GiB)
+ * nbytes -> number of bytes of text
+ * tokens -> (output) vector the (offset, length) pairs are appended to
+ *
+ * Output:
+ * None
+ */
+void tokenizeCipherWords(const char* text, size_t nbytes, std::vector<std::pair<uint32_t,uint32_t>>* tokens)
+{
+#if defined(__x86_64__)
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	if( has_avx2 ) {
+		tokenizeWordsAVX2(text, nbytes, true, tokens);
+		return;
+	}
+#endif
+	tokenizeWordsScalar(text, nbytes, true, tokens);
+
+	return;
+}
+
+/*
+ * Description:
+ * Slot of a word (by its hashCipherWord hash) in a word set for a bucket's
+ *   displacement seed.
+ */
+inline uint32_t wordSetSlot(uint64_t hash, uint32_t seed, uint32_t num_words) noexcept
+{
+	uint64_t mixed = hash ^ (static_cast<uint64_t>(seed) * 0x9E3779B97F4A7C15ULL);
+	mixed ^= mixed >> 31;
+	mixed *= 0xBF58476D1CE4E5B9ULL;
+	mixed ^= mixed >> 29;
+
+	return( static_cast<uint32_t>(mixed % num_words) );
+}
+
+/*
+ * Description:
+ * Opens a word set written by buildWordSet. The file is mapped read-only
+ *   and its header and slot offsets are checked once, so lookups need no
+ *   further bounds checks.
+ *
+ * Input:
+ * setpath -> word set file
+ */
+WordSet::WordSet(const fsys::path& setpath) :
+	setfile(setpath)
+{
+	if( setfile.size() >= sizeof(header) ) {
+		std::memcpy(&header, setfile.data(), sizeof(header));
+	}
+
+	const uint64_t tables_bytes = (static_cast<uint64_t>(header.num_buckets) + header.num_words) * sizeof(uint32_t);
+	bool valid = (setfile.size() >= sizeof(header)) and
+	             std::equal(std::begin(WORDSET_MAGIC), std::end(WORDSET_MAGIC), header.magic) and
+	             (header.version == WORDSET_VERSION) and (header.num_words > 0) and (header.num_buckets > 0) and
+	             (setfile.size() == sizeof(header) + tables_bytes + header.strings_bytes);
+
+	if( valid ) {
+		seeds   = reinterpret_cast<const uint32_t*>(setfile.data() + sizeof(header));
+		slots   = seeds + header.num_buckets;
+		strings = reinterpret_cast<const unsigned char*>(slots + header.num_words);
+		for(uint32_t n = 0; valid and (n < header.num_words); ++n) {
+			valid = (slots[n] < header.strings_bytes) and
+			        (slots[n] + 1 + static_cast<uint64_t>(strings[slots[n]]) <= header.strings_bytes);
+		}
+	}
+
+	if( not valid ) {
+		throw std::runtime_error(std::format("\nInvalid word set file ({}).\n", setpath.string()));
+	}
+}
+
+bool WordSet::contains(const char* word, size_t nbytes) const noexcept
+{
+	if( nbytes > header.max_length ) {
+		return(false);
+	}
+
+	uint64_t hash = hashCipherWord(word, nbytes);
+	uint32_t seed = seeds[(hash >> 32) % header.num_buckets];
+	const unsigned char* entry = strings + slots[wordSetSlot(hash, seed, header.num_words)];
+
+	return( (entry[0] == nbytes) and (std::memcmp(entry + 1, word, nbytes) == 0) );
+}
+
+/*
+ * Description:
+ * Builds a word set from a word list (IFILE; every run of letters is a
+ *   word, lowercased, words over 255 letters are dropped). The words are
+ *   stored with a minimal perfect hash (hash and displace): they are hashed
+ *   into buckets of about four, and the buckets, largest first, each get the
+ *   smallest seed that sends all their words to free slots. A lookup is then
+ *   one hash, one seed and one string comparison. The set goes to OFILE, or
+ *   IFILE.wset by default.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void buildWordSet(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	if( ciphopts->use_default_oname ) {
+		ciphopts->outfilename = ciphopts->infilename + WORDSET_EXT;
+	}
+
+	// distinct lowercase words, tokenized 1 GiB at a time (offsets are 32-bit)
+	MappedFile wordlist(ifilepath);
+	vecstr words;
+	std::vector<std::pair<uint32_t,uint32_t>> tokens;
+	for(size_t pos = 0; pos < wordlist.size(); ) {
+		size_t nbytes = std::min<size_t>(wordlist.size() - pos, size_t{1} << 30);
+		while( (pos + nbytes < wordlist.size()) and (nbytes > 0) and
+		       (letterMaskScalar(wordlist.data() + pos + nbytes - 1, 1) != 0) )
+		{
+			--nbytes;  // do not split a word
+		}
+		nbytes = ( nbytes == 0 ) ? std::min<size_t>(wordlist.size() - pos, size_t{1} << 30) : nbytes;
+
+		tokens.clear();
+		tokenizeWords(wordlist.data() + pos, nbytes, &tokens);
+		for(const std::pair<uint32_t,uint32_t>& token : tokens) {
+			if( token.second <= 255 ) {
+				string word(wordlist.data() + pos + token.first, token.second);
+				std::transform(word.begin(), word.end(), word.begin(), [](char chr) { return( static_cast<char>(chr | 0x20) ); });
+				words.push_back(std::move(word));
+			}
+		}
+		pos += nbytes;
+	}
+	std::sort(words.begin(), words.end());
+	words.erase(std::unique(words.begin(), words.end()), words.end());
+
+	if( words.empty() ) {
+		throw std::invalid_argument("\nNo words in the input file to build a word set.\n");
+	}
+
+	const uint32_t num_words = static_cast<uint32_t>(words.size());
+	const uint32_t num_buckets = (num_words + WORDSET_BUCKET_WORDS - 1) / WORDSET_BUCKET_WORDS;
+	std::vector<uint64_t> hashes(num_words);
+	std::vector<std::vector<uint32_t>> buckets(num_buckets);
+	for(uint32_t n = 0; n < num_words; ++n) {
+		hashes[n] = hashCipherWord(words[n].data(), words[n].size());
+		buckets[(hashes[n] >> 32) % num_buckets].push_back(n);
+	}
+
+	std::vector<uint32_t> order(num_buckets);
+	for(uint32_t b = 0; b < num_buckets; ++b) {
+		order[b] = b;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return( buckets[a].size() > buckets[b].size() );
+	});
+
+	// the last buckets may need about num_words tries to hit the last free slots
+	const uint64_t max_tries = 64 * static_cast<uint64_t>(num_words) + 1024;
+	const uint32_t empty_slot = UINT32_MAX;
+	std::vector<uint32_t> seeds(num_buckets, 0);
+	std::vector<uint32_t> slot_words(num_words, empty_slot);
+	std::vector<uint32_t> trial;
+	for(uint32_t bucket : order) {
+		if( buckets[bucket].empty() ) {
+			break;
+		}
+
+		bool placed = false;
+		for(uint64_t seed = 0; (not placed) and (seed < max_tries); ++seed) {
+			trial.clear();
+			placed = true;
+			for(uint32_t word : buckets[bucket]) {
+				uint32_t slot = wordSetSlot(hashes[word], static_cast<uint32_t>(seed), num_words);
+				if( (slot_words[slot] != empty_slot) or (std::find(trial.begin(), trial.end(), slot) != trial.end()) ) {
+					placed = false;
+					break;
+				}
+				trial.push_back(slot);
+			}
+
+			if( placed ) {
+				seeds[bucket] = static_cast<uint32_t>(seed);
+				for(size_t n = 0; n < trial.size(); ++n) {
+					slot_words[trial[n]] = buckets[bucket][n];
+				}
+			}
+		}
+
+		if( not placed ) {
+			throw std::runtime_error("\nUnable to find a perfect hash for the word list.\n");
+		}
+	}
+
+	// strings in slot order
+	string strings;
+	std::vector<uint32_t> slot_offsets(num_words);
+	WordSetHeader header{};
+	for(uint32_t slot = 0; slot < num_words; ++slot) {
+		const string& word = words[slot_words[slot]];
+		slot_offsets[slot] = static_cast<uint32_t>(strings.size());
+		strings.push_back(static_cast<char>(word.size()));
+		strings.append(word);
+		header.max_length = std::max<uint32_t>(header.max_length, static_cast<uint32_t>(word.size()));
+	}
+
+	std::copy(std::begin(WORDSET_MAGIC), std::end(WORDSET_MAGIC), header.magic);
+	header.version       = WORDSET_VERSION;
+	header.num_words     = num_words;
+	header.num_buckets   = num_buckets;
+	header.strings_bytes = strings.size();
+
+	fsys::path ofilepath( ciphopts->outfilename );
+	std::ofstream ofile(ofilepath, std::ios::binary | std::ios::trunc);
+	ofile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	ofile.write(reinterpret_cast<const char*>(seeds.data()), static_cast<std::streamsize>(seeds.size() * sizeof(uint32_t)));
+	ofile.write(reinterpret_cast<const char*>(slot_offsets.data()), static_cast<std::streamsize>(slot_offsets.size() * sizeof(uint32_t)));
+	ofile.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+	ofile.close();
+	if( not ofile ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to write word set.", ofilepath, ec);
+	}
+	ciphopts->nbytes_file = wordlist.size();
+
+	cout << endl;
+	cout << std::format("Word set of {}", ciphopts->infilename) << endl;
+	cout << std::format("Distinct words:     {:d}", num_words) << endl;
+	cout << std::format("Hash buckets:       {:d}", num_buckets) << endl;
+	cout << std::format("Set written to:     {} ({:d} bytes)", ciphopts->outfilename,
+	                    sizeof(header) + 4 * (static_cast<uint64_t>(num_buckets) + num_words) + strings.size()) << endl;
+	cout << endl;
+
+	return;
+}
+
+/*
+ * Description:
+ * Deciphers the words of a ciphertext with a shift and looks them up in a
+ *   word set.
+ *
+ * Input:
+ * words  -> word set
+ * text   -> ciphertext
+ * tokens -> its words, from tokenizeWords
+ * shift  -> shift the ciphertext was enciphered with (0-25)
+ *
+ * Output:
+ * Fraction of the words found in the set (0 without words)
+ */
+double recognisedWordFraction(const WordSet& words, const char* text,
+                              const std::vector<std::pair<uint32_t,uint32_t>>& tokens, int shift) noexcept
+{
+	if( tokens.empty() ) {
+		return(0.0);
+	}
+
+	char plain[256];
+	size_t recognised = 0;
+	for(const std::pair<uint32_t,uint32_t>& token : tokens) {
+		if( token.second > 255 ) {
+			continue;
+		}
+
+		for(uint32_t n = 0; n < token.second; ++n) {
+			int index = ((text[token.first + n] | 0x20) - 'a' + 26 - shift) % 26;
+			plain[n] = static_cast<char>('a' + index);
+		}
+		recognised += words.contains(plain, token.second) ? 1 : 0;
+	}
+
+	return( static_cast<double>(recognised) / static_cast<double>(tokens.size()) );
+}
+
+/*
+ * Description:
+ * Estimates the shift one file was enciphered with (the statistics behind
+ *   --crack and --crack-dir). By default every byte is read, a chunk at a
+ *   time. With sample_blocks > 0 the file is divided into that many equal
+ *   strata and one block at a random position in each is read, visiting the
+ *   strata in random order, until the estimate reaches the requested
+ *   confidence. With a quadgram model the text is compacted to letters and
+ *   all shifts are scored by quadgram log probability instead of letter
+ *   counts. All buffers come from the caller's scratch storage, so a worker
+ *   going through many files allocates nothing per file.
+ *
+ * Input:
+ * ifilepath -> ciphertext file
+ * ciphopts  -> object storing program controls/options
+ * model     -> quadgram model (nullptr: chi-squared on letter counts)
+ * scratch   -> (output) working storage; holds the final letter counts or
+ *              quadgram scores afterwards
+ *
+ * Output:
+ * Estimate and the amount of the file read (throws exception for read errors)
+ */
+CrackResult crackFileShift(const fsys::path& ifilepath, const CipherOptions* ciphopts,
+                           const QuadgramModel* model, CrackScratch* scratch)
+{
+	int fd = ::open(ifilepath.c_str(), O_RDONLY | O_CLOEXEC);
+	if( fd < 0 ) {
+		std::error_code ec(errno, std::generic_category());
+		throw fsys::filesystem_error("Unable to open input file.", ifilepath, ec);
+	}
+
+	struct stat st{};
+	if( ::fstat(fd, &st) != 0 ) {
+		std::error_code ec(errno, std::generic_category());
+		::close(fd);
+		throw fsys::filesystem_error("Unable to read file size.", ifilepath, ec);
+	}
+
+	CrackResult result;
+	result.file_size = static_cast<uint64_t>(st.st_size);
+	const uint64_t block_size = ciphopts->sample_block_size;
+	const bool sampled = (ciphopts->sample_blocks > 0) and (ciphopts->sample_blocks * block_size < result.file_size);
+	const size_t read_size = sampled ? static_cast<size_t>(block_size) : CRACK_CHUNK_BYTES;
+	if( scratch->buffer.size() < read_size ) {
+		scratch->buffer.resize(read_size);
+	}
+	scratch->counts.fill(0);
+	scratch->quadgram_scores.fill(0);
+	scratch->letters.clear();
+
+	// adds text to the statistics; with continued set its first quadgrams
+	//   start in the previously added text
+	auto add_text = [&](const char* text, size_t nbytes, bool continued) {
+		if( model == nullptr ) {
+			countLetters(text, nbytes, &scratch->counts);
+			result.nletters = 0;
+			for(uint64_t count : scratch->counts) {
+				result.nletters += count;
+			}
+			return;
+		}
+
+		if( not continued ) {
+			scratch->letters.clear();
+		}
+		else if( scratch->letters.size() > 3 ) {
+			scratch->letters.erase(scratch->letters.begin(), scratch->letters.end() - 3);
+		}
+		const size_t carried = scratch->letters.size();
+		compactLetters(text, nbytes, &scratch->letters);
+		result.nletters += scratch->letters.size() - carried;
+		scoreQuadgramShifts(*model, scratch->letters.data(), scratch->letters.size(), &scratch->quadgram_scores);
+		return;
+	};
+	auto current_estimate = [&]() {
+		return( (model != nullptr) ? estimateShiftQuadgrams(scratch->quadgram_scores, model->scale())
+		                           : estimateShift(scratch->counts) );
+	};
+	auto read_at = [&](uint64_t offset) {
+		ssize_t nread = ::pread(fd, scratch->buffer.data(), read_size, static_cast<off_t>(offset));
+		if( nread < 0 ) {
+			std::error_code ec(errno, std::generic_category());
+			::close(fd);
+			throw fsys::filesystem_error("Unable to read input file.", ifilepath, ec);
+		}
+		result.bytes_read += static_cast<uint64_t>(nread);
+		return( static_cast<size_t>(nread) );
+	};
+
+	if( not sampled ) {
+		for(uint64_t offset = 0; offset < result.file_size; offset += read_size) {
+			size_t nread = read_at(offset);
+			if( nread == 0 ) {
+				break;
+			}
+			add_text(scratch->buffer.data(), nread, true);
+		}
+		result.estimate = current_estimate();
+	}
+	else {
+		// one random block per stratum, strata visited in random order
+		std::mt19937_64 rng(SAMPLE_SEED ^ result.file_size);
+		const uint64_t stratum = result.file_size / ciphopts->sample_blocks;
+		scratch->offsets.clear();
+		for(uint64_t b = 0; b < ciphopts->sample_blocks; ++b) {
+			uint64_t slack = ( stratum > block_size ) ? stratum - block_size : 0;
+			scratch->offsets.push_back(b * stratum + ( (slack > 0) ? rng() % (slack + 1) : 0 ));
+		}
+		std::shuffle(scratch->offsets.begin(), scratch->offsets.end(), rng);
+
+		for(uint64_t offset : scratch->offsets) {
+			add_text(scratch->buffer.data(), read_at(offset), false);
+			++result.blocks_read;
+
+			// a few dozen letters can look confident by chance
+			result.estimate = current_estimate();
+			if( (result.nletters >= MIN_CRACK_LETTERS) and (result.estimate.confidence >= ciphopts->crack_confidence) ) {
+				break;
+			}
+		}
+	}
+	::close(fd);
+
+	return(result);
+}
+
+/*
+ * Description:
+ * Estimates the shift a file was enciphered with (see crackFileShift). With
+ *   a word set the top_k shifts are then confirmed by the fraction of the
+ *   words of the file's first 64 KiB that they decipher to real words (ties
+ *   keep the statistical order). The report (shift, runner-up, confidence
+ *   and the amount of the file read) goes to the terminal.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void crackShift(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	std::unique_ptr<QuadgramModel> model;
+	if( not ciphopts->quadgram_model.empty() ) {
+		model = std::make_unique<QuadgramModel>(fsys::path(ciphopts->quadgram_model));
+	}
+	std::unique_ptr<WordSet> wordset;
+	if( not ciphopts->wordset.empty() ) {
+		wordset = std::make_unique<WordSet>(fsys::path(ciphopts->wordset));
+	}
+
+	CrackScratch scratch;
+	const CrackResult result = crackFileShift(ifilepath, ciphopts, model.get(), &scratch);
+	const ShiftEstimate& estimate = result.estimate;
+	ciphopts->nbytes_file = result.bytes_read;
+	const string score_name = model ? "quadgram log10" : "chi-squared";
+
+	// the top_k shifts in statistical order, re-ranked by recognised words
+	std::vector<std::pair<int,double>> confirmed;
+	size_t nwords = 0;
+	if( wordset ) {
+		std::array<double,26> ranking{};
+		for(int shift = 0; shift < 26; ++shift) {
+			ranking[static_cast<size_t>(shift)] = model ? -static_cast<double>(scratch.quadgram_scores[static_cast<size_t>(shift)])
+			                                            : chiSquaredEnglish(scratch.counts, shift);
+		}
+		std::vector<int> shifts(26);
+		for(int shift = 0; shift < 26; ++shift) {
+			shifts[static_cast<size_t>(shift)] = shift;
+		}
+		std::stable_sort(shifts.begin(), shifts.end(), [&](int a, int b) {
+			return( ranking[static_cast<size_t>(a)] < ranking[static_cast<size_t>(b)] );
+		});
+
+		MappedFile cfile(ifilepath);
+		const size_t sample_size = std::min(cfile.size(), WORDSET_SAMPLE_BYTES);
+		std::vector<std::pair<uint32_t,uint32_t>> tokens;
+		tokenizeWords(cfile.data(), sample_size, &tokens);
+		if( (sample_size < cfile.size()) and (not tokens.empty()) and
+		    (tokens.back().first + tokens.back().second == sample_size) )
+		{
+			tokens.pop_back();  // may continue past the sample
+		}
+		nwords = tokens.size();
+
+		for(int k = 0; k < ciphopts->top_k; ++k) {
+			int shift = shifts[static_cast<size_t>(k)];
+			confirmed.emplace_back(shift, recognisedWordFraction(*wordset, cfile.data(), tokens, shift));
+		}
+		std::stable_sort(confirmed.begin(), confirmed.end(), [](const auto& a, const auto& b) {
+			return( a.second > b.second );
+		});
+	}
+
+	cout << endl;
+	cout << std::format("Shift analysis of {}", ciphopts->infilename) << endl;
+	if( result.blocks_read > 0 ) {
+		cout << std::format("Bytes examined:   {:d} of {:d} ({:d} of {:d} sampled blocks)",
+		                    result.bytes_read, result.file_size, result.blocks_read, ciphopts->sample_blocks) << endl;
+	}
+	else {
+		cout << std::format("Bytes examined:   {:d} of {:d}", result.bytes_read, result.file_size) << endl;
+	}
+	cout << std::format("Letters counted:  {:d}", result.nletters) << endl;
+	if( model ) {
+		cout << std::format("Quadgram model:   {}", ciphopts->quadgram_model) << endl;
+	}
+	cout << std::format("Best shift:       {:d}  ({} {:.2f})", estimate.best_shift, score_name, estimate.best_score) << endl;
+	cout << std::format("Runner-up shift:  {:d}  ({} {:.2f})", estimate.runner_up_shift, score_name, estimate.runner_up_score) << endl;
+	cout << std::format("Confidence:       {:.9f}", estimate.confidence) << endl;
+	if( wordset ) {
+		cout << std::format("Word set:         {} ({:d} words)", ciphopts->wordset, wordset->size()) << endl;
+		cout << std::format("Words checked:    {:d}", nwords) << endl;
+		cout << endl;
+		cout << "Shift   Recognised" << endl;
+		for(const std::pair<int,double>& candidate : confirmed) {
+			cout << std::format("{:>5d}   {:>9.2f}%{}", candidate.first, 100.0 * candidate.second,
+			                    (candidate.first == confirmed.front().first) ? "   <--" : "") << endl;
+		}
+		cout << endl;
+		cout << std::format("Confirmed shift:  {:d}", confirmed.front().first) << endl;
+	}
+	cout << endl;
+
+	return;
+}
+
+/*
+ * Description:
+ * Table deciphering the letters of text enciphered with a shift (other
+ *   bytes map to themselves).
+ *
+ * Input:
+ * shift -> shift the text was enciphered with (0-25)
+ *
+ * Output:
+ * 256-entry byte table
+ */
+std::array<char,256> letterShiftTable(int shift) noexcept
+{
+	std::array<char,256> table{};
+	for(size_t n = 0; n < 256; ++n) {
+		table[n] = static_cast<char>(n);
+	}
+	for(int n = 0; n < 26; ++n) {
+		table[static_cast<size_t>('A' + n)] = static_cast<char>('A' + (n + 26 - shift) % 26);
+		table[static_cast<size_t>('a' + n)] = static_cast<char>('a' + (n + 26 - shift) % 26);
+	}
+
+	return(table);
+}
+
+/*
+ * Description:
+ * Runs the shift detection on every regular file of a directory (sidecar
+ *   index files excluded) and writes one report line per file: name, best
+ *   shift, confidence, runner-up shift and letters counted, as CSV or JSON,
+ *   to OFILE or the terminal. Files are dealt round-robin, largest first, to
+ *   per-worker queues; a worker whose queue runs dry steals from the back
+ *   of the others' (work stealing), so a few huge files do not leave the
+ *   other workers idle. Each worker reuses one scratch area and buffer for
+ *   all its files. With decipher_dir set, every file is also written there,
+ *   under its own name, deciphered with its detected shift.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for DIRECTORY NOT FOUND; files that fail are
+ *   reported to std::cerr and left out of the report)
+ */
+void crackDirectory(CipherOptions* ciphopts)
+{
+	fsys::path dirpath( ciphopts->crack_dir );
+	if( not fsys::is_directory(dirpath) ) {
+		string errmsg{"Input directory not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, dirpath, ec);
+	}
+
+	fsys::path outdir( ciphopts->decipher_dir );
+	if( not ciphopts->decipher_dir.empty() ) {
+		fsys::create_directories(outdir);
+		if( fsys::equivalent(outdir, dirpath) ) {
+			throw std::invalid_argument("\nThe --decipher-to directory must differ from the --crack-dir directory.\n");
+		}
+	}
+
+	std::unique_ptr<QuadgramModel> model;
+	if( not ciphopts->quadgram_model.empty() ) {
+		model = std::make_unique<QuadgramModel>(fsys::path(ciphopts->quadgram_model));
+	}
+
+	// regular files in name order (the report order)
+	std::vector<fsys::path> files;
+	for(const fsys::directory_entry& entry : fsys::directory_iterator(dirpath)) {
+		const string ext = entry.path().extension().string();
+		if( entry.is_regular_file() and (ext != LINE_INDEX_EXT) and (ext != TRIGRAM_INDEX_EXT) and (ext != BLOOM_INDEX_EXT) ) {
+			files.push_back(entry.path());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	std::vector<CrackResult> results(files.size());
+	std::vector<std::exception_ptr> errors(files.size());
+
+	// per-worker queues, dealt largest file first
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::deque<size_t> files;
+	};
+	const unsigned nworkers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(resolveThreadCount(ciphopts), files.size())));
+	std::vector<WorkQueue> queues(nworkers);
+	{
+		std::vector<std::pair<uintmax_t,size_t>> by_size;
+		for(size_t f = 0; f < files.size(); ++f) {
+			std::error_code ec;
+			uintmax_t size = fsys::file_size(files[f], ec);
+			by_size.emplace_back(ec ? 0 : size, f);
+		}
+		std::stable_sort(by_size.begin(), by_size.end(), [](const auto& a, const auto& b) { return( a.first > b.first ); });
+		for(size_t n = 0; n < by_size.size(); ++n) {
+			queues[n % nworkers].files.push_back(by_size[n].second);
+		}
+	}
+
+	auto next_file = [&](unsigned worker, size_t* file_number) {
+		for(unsigned n = 0; n < nworkers; ++n) {
+			WorkQueue& queue = queues[(worker + n) % nworkers];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if( not queue.files.empty() ) {
+				if( n == 0 ) {
+					*file_number = queue.files.front();
+					queue.files.pop_front();
+				}
+				else {
+					*file_number = queue.files.back();
+					queue.files.pop_back();
+				}
+				return(true);
+			}
+		}
+		return(false);
+	};
+
+	auto crack_worker = [&](unsigned worker) {
+		CrackScratch scratch;
+		size_t f = 0;
+		while( next_file(worker, &f) ) {
+			try {
+				results[f] = crackFileShift(files[f], ciphopts, model.get(), &scratch);
+				if( ciphopts->decipher_dir.empty() ) {
+					continue;
+				}
+
+				// decipher through the same buffer, a chunk at a time
+				const std::array<char,256> table = letterShiftTable(results[f].estimate.best_shift);
+				fsys::path opath = outdir / files[f].filename();
+				int ifd = ::open(files[f].c_str(), O_RDONLY | O_CLOEXEC);
+				int ofd = ::open(opath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+				if( (ifd < 0) or (ofd < 0) ) {
+					std::error_code ec(errno, std::generic_category());
+					if( ifd >= 0 ) { ::close(ifd); }
+					if( ofd >= 0 ) { ::close(ofd); }
+					throw fsys::filesystem_error("Unable to open file for deciphering.", ( ifd < 0 ) ? files[f] : opath, ec);
+				}
+				if( scratch.buffer.size() < CRACK_CHUNK_BYTES ) {
+					scratch.buffer.resize(CRACK_CHUNK_BYTES);
+				}
+
+				ssize_t nread = 0;
+				bool written = true;
+				while( written and ((nread = ::read(ifd, scratch.buffer.data(), scratch.buffer.size())) > 0) ) {
+					for(ssize_t n = 0; n < nread; ++n) {
+						scratch.buffer[static_cast<size_t>(n)] = table[static_cast<unsigned char>(scratch.buffer[static_cast<size_t>(n)])];
+					}
+					written = ::write(ofd, scratch.buffer.data(), static_cast<size_t>(nread)) == nread;
+				}
+				std::error_code ec(errno, std::generic_category());
+				::close(ifd);
+				if( (::close(ofd) != 0) or (nread < 0) or (not written) ) {
+					throw fsys::filesystem_error("Unable to decipher file.", opath, ec);
+				}
+			}
+			catch( ... ) {
+				errors[f] = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(unsigned w = 1; w < nworkers; ++w) {
+		workers.emplace_back(crack_worker, w);
+	}
+	crack_worker(0);
+	for(std::thread& thrd : workers) {
+		thrd.join();
+	}
+
+	// a file that could not be read or deciphered is reported on its own and
+	//   left out of the ranking, which still covers all the others
+	std::vector<size_t> cracked;
+	for(size_t f = 0; f < files.size(); ++f) {
+		if( not errors[f] ) {
+			cracked.push_back(f);
+			continue;
+		}
+		try {
+			std::rethrow_exception(errors[f]);
+		}
+		catch( const std::exception& error ) {
+			std::cerr << std::format("Unable to crack {}: {}", files[f].string(), error.what()) << endl;
+		}
+	}
+	const size_t nfailed = files.size() - cracked.size();
+
+	// report
+	std::ofstream ofile;
+	if( not ciphopts->use_default_oname ) {
+		ofile.open(fsys::path(ciphopts->outfilename));
+	}
+	std::ostream& ostrm = ofile.is_open() ? static_cast<std::ostream&>(ofile) : cout;
+
+	auto csv_field = [](const string& text) {
+		if( text.find_first_of(",\"\n") == string::npos ) {
+			return(text);
+		}
+		string quoted{"\""};
+		for(char chr : text) {
+			quoted.append( (chr == '"') ? "\"\"" : string(1, chr) );
+		}
+		return(quoted + "\"");
+	};
+	auto json_string = [](const string& text) {
+		string quoted{"\""};
+		for(char chr : text) {
+			if( (chr == '"') or (chr == '\\') ) {
+				quoted.push_back('\\');
+				quoted.push_back(chr);
+			}
+			else if( static_cast<unsigned char>(chr) < 0x20 ) {
+				quoted.append(std::format("\\u{:04x}", static_cast<unsigned>(chr)));
+			}
+			else {
+				quoted.push_back(chr);
+			}
+		}
+		return(quoted + "\"");
+	};
+
+	if( ciphopts->report_json ) {
+		ostrm << "[" << '\n';
+	}
+	else {
+		ostrm << "file,best_shift,confidence,runner_up_shift,letters" << '\n';
+	}
+	for(size_t n = 0; n < cracked.size(); ++n) {
+		const size_t f = cracked[n];
+		const ShiftEstimate& estimate = results[f].estimate;
+		ciphopts->nbytes_file += results[f].bytes_read;
+		if( ciphopts->report_json ) {
+			ostrm << std::format("  {{\"file\": {}, \"best_shift\": {:d}, \"confidence\": {:.9f}, \"runner_up_shift\": {:d}, \"letters\": {:d}}}{}",
+			                     json_string(files[f].filename().string()), estimate.best_shift, estimate.confidence,
+			                     estimate.runner_up_shift, results[f].nletters, (n + 1 < cracked.size()) ? "," : "") << '\n';
+		}
+		else {
+			ostrm << std::format("{},{:d},{:.9f},{:d},{:d}", csv_field(files[f].filename().string()), estimate.best_shift,
+			                     estimate.confidence, estimate.runner_up_shift, results[f].nletters) << '\n';
+		}
+	}
+	if( ciphopts->report_json ) {
+		ostrm << "]" << '\n';
+	}
+	ostrm.flush();
+
+	if( ofile.is_open() ) {
+		cout << endl;
+		cout << std::format("Cracked {:d} files of {} with {:d} threads, {:d} failed", cracked.size(), ciphopts->crack_dir, nworkers, nfailed) << endl;
+		cout << std::format("Report written to {}", ciphopts->outfilename) << endl;
+		cout << endl;
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Finds where the shift changes in a concatenation of records enciphered
+ *   with different shifts. Lines are read as a stream into a look-ahead
+ *   window of at least W letters whose letter histogram is kept up to date
+ *   incrementally (the counts of entering lines are added and those of
+ *   leaving lines removed), so the whole pass is linear. When the window
+ *   starting at a line favours a different shift than the current segment,
+ *   the line's own letters decide between the two shifts (likelihood), so a
+ *   window straddling a boundary does not move it. Boundaries are reported
+ *   on the terminal; with an OFILE each segment is written deciphered with
+ *   its detected shift.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void detectSegmentShifts(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	std::ifstream ifile(ifilepath, std::ios::binary);
+
+	std::ofstream ofile;
+	if( not ciphopts->use_default_oname ) {
+		ofile.open(fsys::path(ciphopts->outfilename), std::ios::binary);
+	}
+
+	// look-ahead window of lines and its letter histogram
+	struct SegmentLine
+	{
+		string text;
+		std::array<uint64_t,26> counts{};
+		uint64_t nletters = 0;
+		uint64_t offset   = 0;
+	};
+	std::deque<SegmentLine> window;
+	std::array<uint64_t,26> window_counts{};
+	uint64_t window_letters = 0;
+	uint64_t next_offset = 0;
+	bool more_input = true;
+
+	auto fill_window = [&]() {
+		while( more_input and (window.empty() or (window_letters < ciphopts->segment_window)) ) {
+			SegmentLine line;
+			if( not std::getline(ifile, line.text) ) {
+				more_input = false;
+				break;
+			}
+
+			countLetters(line.text.data(), line.text.size(), &line.counts);
+			for(size_t n = 0; n < 26; ++n) {
+				line.nletters    += line.counts[n];
+				window_counts[n] += line.counts[n];
+			}
+			window_letters += line.nletters;
+
+			line.offset = next_offset;
+			next_offset += line.text.size() + 1;
+			window.push_back(std::move(line));
+		}
+	};
+
+	cout << endl;
+	cout << std::format("Segment shifts of {}", ciphopts->infilename) << endl;
+	cout << "Line         Offset         Shift" << endl;
+
+	int current_shift = -1;
+	std::array<char,256> table = letterShiftTable(0);
+	uint64_t line_number = 0, nsegments = 0;
+	string outstr;
+
+	while( true ) {
+		fill_window();
+		if( window.empty() ) {
+			break;
+		}
+
+		SegmentLine& line = window.front();
+		++line_number;
+
+		if( window_letters > 0 ) {
+			int window_shift = estimateShift(window_counts).best_shift;
+			bool new_segment = ( current_shift < 0 );
+			if( (not new_segment) and (window_shift != current_shift) and (line.nletters > 0) ) {
+				new_segment = logLikelihoodEnglish(line.counts, window_shift) > logLikelihoodEnglish(line.counts, current_shift);
+			}
+
+			if( new_segment ) {
+				current_shift = window_shift;
+				table = letterShiftTable(current_shift);
+				++nsegments;
+				cout << std::format("{:<12d} {:<14d} {:d}", line_number, line.offset, current_shift) << endl;
+			}
+		}
+
+		if( ofile.is_open() ) {
+			outstr.resize(line.text.size());
+			for(size_t n = 0; n < line.text.size(); ++n) {
+				outstr[n] = table[static_cast<unsigned char>(line.text[n])];
+			}
+			outstr.push_back('\n');
+			ofile.write(outstr.data(), static_cast<std::streamsize>(outstr.size()));
+		}
+		ciphopts->nbytes_file += line.text.size();
+
+		// slide the window past this line
+		for(size_t n = 0; n < 26; ++n) {
+			window_counts[n] -= line.counts[n];
+		}
+		window_letters -= line.nletters;
+		window.pop_front();
+	}
+
+	cout << std::format("\nSegments found: {:d} in {:d} lines", nsegments, line_number) << endl;
+	cout << endl;
+
+	return;
+}
+
+/*
+ * Description:
+ * In-place iterative radix-2 fast Fourier transform. The size of data must
+ *   be a power of 2. The inverse transform is not scaled by 1/N.
+ *
+ * Input:
+ * data    -> values to transform (overwritten by the result)
+ * inverse -> compute the inverse transform
+ *
+ * Output:
+ * None
+ */
+void fourierTransform(std::vector<std::complex<double>>* data, bool inverse)
+{
+	std::vector<std::complex<double>>& values = *data;
+	const size_t size = values.size();
+
+	for(size_t i = 1, j = 0; i < size; ++i) {
+		size_t bit = size >> 1;
+		for(; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if( i < j ) {
+			std::swap(values[i], values[j]);
+		}
+	}
+
+	const double pi = std::acos(-1.0);
+	std::vector<std::complex<double>> roots;
+	for(size_t len = 2; len <= size; len <<= 1) {
+		double angle = 2.0 * pi / static_cast<double>(len) * (inverse ? 1.0 : -1.0);
+		roots.resize(len / 2);
+		for(size_t k = 0; k < len / 2; ++k) {
+			roots[k] = std::polar(1.0, angle * static_cast<double>(k));
+		}
+
+		for(size_t start = 0; start < size; start += len) {
+			for(size_t k = 0; k < len / 2; ++k) {
+				std::complex<double> even = values[start + k];
+				std::complex<double> odd  = values[start + k + len / 2] * roots[k];
+				values[start + k]           = even + odd;
+				values[start + k + len / 2] = even - odd;
+			}
+		}
+	}
+
+	return;
+}
+
+/*
+ * Description:
+ * Estimates the key of Vigenere ciphertext. The text is compacted to its
+ *   letters, then for every candidate key length (period) 1 to K, computed
+ *   in parallel:
+ *     - the index of coincidence averaged over the period's columns
+ *     - the autocorrelation (fraction of letters equal to the letter one
+ *       period later), counted directly or, when K is large enough that it
+ *       is cheaper, through FFTs of the letters as 26th roots of unity
+ *   K is capped so every column holds VIGENERE_MIN_COLUMN_LETTERS letters.
+ *   The key length is the smallest period whose index of coincidence comes
+ *   close to the best one (multiples of the true period score as well), and
+ *   each key letter is the shift that makes its column's letter counts most
+ *   English (chi-squared). With a quadgram model the key is then refined on
+ *   the first letters of the text: one key letter at a time is set to the
+ *   shift giving the best quadgram score, until no change improves it. The
+ *   report goes to the terminal, the deciphered text to OFILE if one was
+ *   given.
+ *
+ * Input:
+ * ciphopts -> object storing program controls/options
+ *
+ * Output:
+ * None (throws exception for FILE NOT FOUND)
+ */
+void analyzeVigenere(CipherOptions* ciphopts)
+{
+	fsys::path ifilepath( ciphopts->infilename );
+	if( not fsys::exists(ifilepath) ) {
+		string errmsg{"Input file not found."};
+		std::error_code ec;
+		throw fsys::filesystem_error(errmsg, ifilepath, ec);
+	}
+
+	std::unique_ptr<QuadgramModel> model;
+	if( not ciphopts->quadgram_model.empty() ) {
+		model = std::make_unique<QuadgramModel>(fsys::path(ciphopts->quadgram_model));
+	}
+
+	MappedFile cfile(ifilepath);
+	std::vector<uint8_t> letters;
+	letters.reserve(cfile.size() + 64);
+	compactLetters(cfile.data(), cfile.size(), &letters);
+
+	const size_t nletters = letters.size();
+	if( nletters < 4 ) {
+		throw std::invalid_argument("\nToo few letters in the input file for a Vigenere analysis.\n");
+	}
+
+	const size_t max_period = std::min<size_t>(static_cast<size_t>(ciphopts->max_period),
+	                                           std::max<size_t>(1, nletters / VIGENERE_MIN_COLUMN_LETTERS));
+	const unsigned nthreads = resolveThreadCount(ciphopts);
+
+	auto run_parallel = [nthreads](size_t ntasks, const auto& task) {
+		std::atomic<size_t> next_task{0};
+		auto worker = [&]() {
+			for(size_t t = next_task++; t < ntasks; t = next_task++) {
+				task(t);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for(unsigned w = 1; w < std::min<size_t>(nthreads, ntasks); ++w) {
+			workers.emplace_back(worker);
+		}
+		worker();
+		for(std::thread& thrd : workers) {
+			thrd.join();
+		}
+	};
+
+	// average index of coincidence of the columns of each period
+	std::vector<double> period_ioc(max_period + 1, 0.0);
+	run_parallel(max_period, [&](size_t task) {
+		const size_t period = task + 1;
+		double ioc_sum = 0.0;
+		for(size_t col = 0; col < period; ++col) {
+			std::array<uint64_t,26> counts{};
+			uint64_t total = 0;
+			for(size_t n = col; n < nletters; n += period, ++total) {
+				++counts[letters[n]];
+			}
+
+			uint64_t pairs = 0;
+			for(uint64_t count : counts) {
+				pairs += count * (count - (count > 0 ? 1 : 0));
+			}
+			if( total > 1 ) {
+				ioc_sum += static_cast<double>(pairs) / static_cast<double>(total * (total - 1));
+			}
+		}
+		period_ioc[period] = ioc_sum / static_cast<double>(period);
+	});
+
+	// autocorrelation: coincidences between letters one period apart.
+	//   A direct count costs N*K byte comparisons (vectorized by the compiler),
+	//   the FFT route 13 forward/inverse transforms of M >= N + K points.
+	std::vector<double> autocorr(max_period + 1, 0.0);
+	size_t fft_size = 1;
+	while( fft_size < nletters + max_period ) {
+		fft_size <<= 1;
+	}
+	const double direct_cost = static_cast<double>(nletters) * static_cast<double>(max_period);
+	const double fft_cost    = 13.0 * 2.0 * 8.0 * static_cast<double>(fft_size) * std::log2(static_cast<double>(fft_size));
+	const bool use_fft = fft_cost < direct_cost;
+
+	if( use_fft ) {
+		// with w = exp(2*pi*i/26) and z_n = w^(j*c_n):
+		//   coincidences(k) = ((N-k) + sum_{j=1..25} Re sum_n z_n conj(z_{n+k})) / 26
+		//   and harmonics j and 26-j contribute equally
+		std::vector<std::vector<double>> harmonic_sums(13, std::vector<double>(max_period + 1, 0.0));
+		const double pi = std::acos(-1.0);
+
+		// each transform holds fft_size complex values, keep at most ~1 GiB in flight
+		const size_t fft_bytes = fft_size * sizeof(std::complex<double>);
+		const unsigned fft_threads = static_cast<unsigned>(std::max<size_t>(1, 
+			std::min<size_t>(nthreads, (size_t{1} << 30) / fft_bytes)));
+		std::atomic<size_t> next_harmonic{0};
+		auto fft_worker = [&]() {
+			std::vector<std::complex<double>> values;
+			for(size_t j = next_harmonic++ + 1; j <= 13; j = next_harmonic++ + 1) {
+				values.assign(fft_size, std::complex<double>(0.0, 0.0));
+				for(size_t n = 0; n < nletters; ++n) {
+					values[n] = std::polar(1.0, 2.0 * pi * static_cast<double>((j * letters[n]) % 26) / 26.0);
+				}
+
+				fourierTransform(&values, false);
+				for(std::complex<double>& value : values) {
+					value = std::norm(value);
+				}
+				fourierTransform(&values, true);
+
+				for(size_t k = 1; k <= max_period; ++k) {
+					harmonic_sums[j - 1][k] = values[k].real() / static_cast<double>(fft_size);
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for(unsigned w = 1; w < std::min<unsigned>(fft_threads, 13); ++w) {
+			workers.emplace_back(fft_worker);
+		}
+		fft_worker();
+		for(std::thread& thrd : workers) {
+			thrd.join();
+		}
+
+		for(size_t k = 1; k <= max_period; ++k) {
+			double sum = static_cast<double>(nletters - k) + harmonic_sums[12][k];
+			for(size_t j = 0; j < 12; ++j) {
+				sum += 2.0 * harmonic_sums[j][k];
+			}
+			autocorr[k] = (sum / 26.0) / static_cast<double>(nletters - k);
+		}
+	}
+	else {
+		run_parallel(max_period, [&](size_t task) {
+			const size_t lag = task + 1;
+			const uint8_t* first  = letters.data();
+			const uint8_t* second = letters.data() + lag;
+			uint64_t coincidences = 0;
+			for(size_t n = 0; n < nletters - lag; ++n) {
+				coincidences += ( first[n] == second[n] ) ? 1 : 0;
+			}
+			autocorr[lag] = static_cast<double>(coincidences) / static_cast<double>(nletters - lag);
+		});
+	}
+
+	// smallest period getting most of the way from random text to the best
+	const double random_ioc = 1.0 / 26.0;
+	double best_ioc = random_ioc;
+	for(size_t period = 1; period <= max_period; ++period) {
+		best_ioc = std::max(best_ioc, period_ioc[period]);
+	}
+
+	size_t key_length = 1;
+	for(size_t period = 1; period <= max_period; ++period) {
+		if( period_ioc[period] >= random_ioc + 0.75 * (best_ioc - random_ioc) ) {
+			key_length = period;
+			break;
+		}
+	}
+
+	// each key letter from its column's letter counts
+	string key;
+	std::vector<int> key_shifts(key_length, 0);
+	for(size_t col = 0; col < key_length; ++col) {
+		std::array<uint64_t,26> counts{};
+		for(size_t n = col; n < nletters; n += key_length) {
+			++counts[letters[n]];
+		}
+
+		double best_score = chiSquaredEnglish(counts, 0);
+		for(int shift = 1; shift < 26; ++shift) {
+			double score = chiSquaredEnglish(counts, shift);
+			if( score < best_score ) {
+				best_score = score;
+				key_shifts[col] = shift;
+			}
+		}
+		key.push_back(static_cast<char>('A' + key_shifts[col]));
+	}
+
+	// coordinate ascent on the quadgram score of a sample of the text
+	const string freq_key = key;
+	if( model ) {
+		const size_t nsample = std::min(nletters, QUADGRAM_REFINE_LETTERS);
+		std::vector<uint8_t> plain(nsample);
+		for(size_t n = 0; n < nsample; ++n) {
+			plain[n] = static_cast<uint8_t>((letters[n] + 26 - key_shifts[n % key_length]) % 26);
+		}
+		int64_t best_total = scoreQuadgrams(*model, plain.data(), nsample);
+
+		auto set_column = [&](size_t col, int shift) {
+			for(size_t n = col; n < nsample; n += key_length) {
+				plain[n] = static_cast<uint8_t>((letters[n] + 26 - shift) % 26);
+			}
+		};
+
+		// every accepted change raises the score, so this ends
+		bool improved = true;
+		while( improved ) {
+			improved = false;
+			for(size_t col = 0; col < key_length; ++col) {
+				for(int shift = 0; shift < 26; ++shift) {
+					if( shift == key_shifts[col] ) {
+						continue;
+					}
+
+					set_column(col, shift);
+					int64_t total = scoreQuadgrams(*model, plain.data(), nsample);
+					if( total > best_total ) {
+						best_total = total;
+						key_shifts[col] = shift;
+						improved = true;
+					}
+				}
+				set_column(col, key_shifts[col]);
+				key[col] = static_cast<char>('A' + key_shifts[col]);
+			}
+		}
+	}
+
+	// report
+	cout << endl;
+	cout << std::format("Vigenere analysis of {}", ciphopts->infilename) << endl;
+	cout << std::format("Letters analysed:  {:d}", nletters) << endl;
+	if( max_period < static_cast<size_t>(ciphopts->max_period) ) {
+		cout << std::format("Periods tried:     1-{:d} (columns need {:d} letters)", max_period, VIGENERE_MIN_COLUMN_LETTERS) << endl;
+	}
+	cout << std::format("Autocorrelation:   {}", use_fft ? "FFT" : "direct count") << endl;
+	cout << std::format("Reference IoC:     English {:.4f}, random {:.4f}", ENGLISH_IOC, random_ioc) << endl;
+	cout << endl;
+	cout << "Period   IoC      Autocorrelation" << endl;
+	for(size_t period = 1; period <= max_period; ++period) {
+		cout << std::format("{:>6d}   {:.4f}   {:.4f}{}", period, period_ioc[period], autocorr[period],
+		                    (period == key_length) ? "   <--" : "") << endl;
+	}
+	cout << endl;
+	cout << std::format("Most likely key length: {:d}", key_length) << endl;
+	cout << std::format("Recovered key:          {}", key) << endl;
+	if( model ) {
+		cout << std::format("Key before quadgram refinement: {}", freq_key) << endl;
+	}
+	cout << endl;
+
+	// decipher with the recovered key if an output file was given
+	if( not ciphopts->use_default_oname ) {
+		std::ofstream ofile(fsys::path(ciphopts->outfilename), std::ios::binary);
+		string outbuf;
+		outbuf.reserve(1 << 16);
+
+		size_t letter_number = 0;
+		for(size_t n = 0; n < cfile.size(); ++n) {
+			char chr = cfile.data()[n];
+			uint8_t index = static_cast<uint8_t>((static_cast<uint8_t>(chr) | 0x20) - 'a');
+			if( index < 26 ) {
+				char base = ( chr & 0x20 ) ? 'a' : 'A';
+				chr = static_cast<char>(base + (index + 26 - key_shifts[letter_number++ % key_length]) % 26);
+			}
+
+			outbuf.push_back(chr);
+			if( outbuf.size() == outbuf.capacity() ) {
+				ofile.write(outbuf.data(), static_cast<std::streamsize>(outbuf.size()));
+				outbuf.clear();
+			}
+		}
+		ofile.write(outbuf.data(), static_cast<std::streamsize>(outbuf.size()));
+		ciphopts->nbytes_file = cfile.size();
+	}
+
+	return;
+}
+
 
 /*
  * Description:
@@ -608,6 +9737,7 @@ void printLogInfo(CipherOptions* ciphopts) noexcept
 	cout << "OFILE:               " << ciphopts->outfilename << endl;
 	cout << "Default output name: " << (ciphopts->use_default_oname ? "true" : "false") << endl;
 	cout << "Shift amount:        " << ciphopts->shift_amount << endl;
+	cout << "Decipher:            " << (ciphopts->decipher ? "true" : "false") << endl;
 	cout << "[Effective] Shift:   " << ciphopts->effective_shift << endl;
 	cout << "Shift numbers:       " << (ciphopts->enc_numbers ? "true" : "false") << endl;
 	cout << "Number shift amount: " << ciphopts->numbers_shift << endl;